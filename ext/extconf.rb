@@ -90,6 +90,8 @@ have_func 'PQping'
 have_func 'PQsetSingleRowMode'
 have_func 'PQconninfo'
 have_func 'PQsslAttribute'
+have_func 'PQresultMemorySize'
+have_func 'PQsetChunkedRowsMode'
 
 have_func 'rb_encdb_alias'
 have_func 'rb_enc_alias'
@@ -99,9 +101,15 @@ have_func 'rb_thread_fd_select'
 have_func 'rb_w32_wrap_io_handle'
 have_func 'rb_str_modify_expand'
 have_func 'rb_hash_dup'
+have_func 'rb_hash_bulk_insert'
+have_func 'rb_hash_new_capa'
+have_func 'rb_enc_interned_str'
+have_func 'rb_gc_adjust_memory_usage'
+have_func 'rb_class_new_instance_kw'
 
 have_const 'PGRES_COPY_BOTH', 'libpq-fe.h'
 have_const 'PGRES_SINGLE_TUPLE', 'libpq-fe.h'
+have_const 'PGRES_TUPLES_CHUNK', 'libpq-fe.h'
 have_const 'PG_DIAG_TABLE_NAME', 'libpq-fe.h'
 
 $defs.push( "-DHAVE_ST_NOTIFY_EXTRA" ) if
@@ -110,6 +118,9 @@ $defs.push( "-DHAVE_ST_NOTIFY_EXTRA" ) if
 # unistd.h confilicts with ruby/win32.h when cross compiling for win32 and ruby 1.9.1
 have_header 'unistd.h'
 have_header 'inttypes.h'
+have_header 'pthread.h'
+have_header 'sys/mman.h'
+have_header 'ruby/memory_view.h'
 have_header 'ruby/st.h' or have_header 'st.h' or abort "pg currently requires the ruby/st.h header"
 
 checking_for "C99 variable length arrays" do
@@ -531,6 +531,10 @@ Init_pg_ext()
 #ifdef HAVE_CONST_PGRES_SINGLE_TUPLE
 	rb_define_const(rb_mPGconstants, "PGRES_SINGLE_TUPLE", INT2FIX(PGRES_SINGLE_TUPLE));
 #endif
+	/* #result_status constant: Chunk of tuples from larger resultset. */
+#ifdef HAVE_CONST_PGRES_TUPLES_CHUNK
+	rb_define_const(rb_mPGconstants, "PGRES_TUPLES_CHUNK", INT2FIX(PGRES_TUPLES_CHUNK));
+#endif
 
 	/******     Result CONSTANTS: result error field codes      ******/
 
@@ -649,6 +653,15 @@ Init_pg_ext()
 	/* Initialize the main extension classes */
 	init_pg_connection();
 	init_pg_result();
+	init_pg_tuple();
+	init_pg_arrow();
+	init_pg_result_writer();
+	init_pg_result_index();
+	init_pg_spooled_result();
+	init_pg_column_pack();
+	init_pg_result_view();
+	init_pg_result_aggregate();
+	init_pg_result_dump();
 	init_pg_errors();
 	init_pg_type_map();
 	init_pg_type_map_all_strings();
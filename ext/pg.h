@@ -145,6 +145,34 @@ typedef long suseconds_t;
 	#define PG_MAX_COLUMNS 4000
 #endif
 
+/* Callback of pg_result_stream_any(), which is called for each received PGresult
+ * with the arguments: result, number of tuples, number of fields and user data. */
+typedef void (*t_pg_result_yielder)(VALUE, int, int, void *);
+
+/* Kinds of columns, which can be decoded in parallel by pg_predecode_columns() */
+#define PG_PREDECODE_NONE 0
+#define PG_PREDECODE_TEXT_INT 1
+#define PG_PREDECODE_TEXT_FLOAT 2
+#define PG_PREDECODE_TEXT_BOOL 3
+#define PG_PREDECODE_BIN_INT 4
+#define PG_PREDECODE_BIN_FLOAT 5
+#define PG_PREDECODE_BIN_BOOL 6
+
+typedef union {
+	int64_t i;
+	double d;
+} t_pg_predecoded_value;
+
+typedef struct {
+	int kind;
+	int field;
+	t_pg_predecoded_value *values;
+	/* State of each value: NULL, decoded or to be decoded per decoder function */
+	char *states;
+} t_pg_predecoded_column;
+
+struct pg_predecode;
+
 /* The data behind each PG::Connection object */
 typedef struct {
 	PGconn *pgconn;
@@ -168,8 +196,27 @@ typedef struct {
 	/* Kind of PG::Coder object for casting COPY rows to ruby values */
 	VALUE decoder_for_get_copy_data;
 
+	/* PG_RESULT_FIELD_NAMES_* flags inherited by new PG::Result objects */
+	int flags;
+
+	/* Limits of the number of rows and value bytes of received results. 0 means unlimited. */
+	int64_t max_result_rows;
+	int64_t max_result_bytes;
+
 } t_pg_connection;
 
+/* Limits of a result to be received and the amount received so far */
+typedef struct {
+	int64_t max_rows;
+	int64_t max_bytes;
+	int64_t rows;
+	int64_t bytes;
+} t_pg_result_limits;
+
+#define PG_RESULT_FIELD_NAMES_MASK 0x03
+#define PG_RESULT_FIELD_NAMES_SYMBOL 0x01
+#define PG_RESULT_FIELD_NAMES_STATIC_SYMBOL 0x02
+
 typedef struct pg_coder t_pg_coder;
 typedef struct pg_typemap t_typemap;
 
@@ -193,6 +240,17 @@ typedef struct {
 	 */
 	int autoclear;
 
+	/* Size of PGresult as published to ruby memory management. */
+	size_t result_size;
+
+	/* Number of running parallel decodings, which read the PGresult without
+	 * holding the GVL. The PGresult must not be cleared meanwhile.
+	 */
+	int busy;
+
+	/* Bitmap of PG_RESULT_FIELD_NAMES_* flags */
+	int flags;
+
 	/* Number of fields in fnames[] .
 	 * Set to -1 if fnames[] is not yet initialized.
 	 */
@@ -201,7 +259,15 @@ typedef struct {
 	/* Prefilled tuple Hash with fnames[] as keys. */
 	VALUE tuple_hash;
 
-	/* List of field names as frozen String objects.
+	/* Hash with fnames[] to field number mapping. */
+	VALUE field_map;
+
+	/* Command status of a result, which is joined from received chunks.
+	 * PQcmdStatus() of such a PGresult is empty. Qnil otherwise.
+	 */
+	VALUE cmd_status;
+
+	/* List of field names as frozen String objects or Symbols.
 	 * Only valid if nfields != -1
 	 */
 	VALUE fnames[0];
@@ -223,8 +289,21 @@ struct pg_coder {
 	VALUE coder_obj;
 	Oid oid;
 	int format;
+	/* Table of raw value to decoded object - NULL if memoization is disabled */
+	st_table *memo;
+	/* Maximum number of entries in memo */
+	int memo_size;
+	/* Bitmap of PG_CODER_* flags */
+	int flags;
 };
 
+/* Date, time and interval values are decoded as Integer instead of Date or Time objects */
+#define PG_CODER_TIME_RAW 0x01
+/* Numeric values without fractional digits are decoded as Integer */
+#define PG_CODER_NUMERIC_AS_INTEGER 0x02
+/* Numeric values are decoded as Float (unless decoded as Integer) */
+#define PG_CODER_NUMERIC_AS_FLOAT 0x04
+
 typedef struct {
 	t_pg_coder comp;
 	t_pg_coder *elem;
@@ -267,12 +346,19 @@ extern VALUE rb_eConnectionBad;
 extern VALUE rb_eInvalidResultStatus;
 extern VALUE rb_eNoResultError;
 extern VALUE rb_eInvalidChangeOfResultFields;
+extern VALUE rb_eResultTooLarge;
 extern VALUE rb_mPGconstants;
 extern VALUE rb_cPGconn;
 extern VALUE rb_cPGresult;
+extern VALUE rb_cPG_Tuple;
+extern VALUE rb_cPG_ResultIndex;
+extern VALUE rb_cPG_SpooledResult;
+extern VALUE rb_cPG_PackedColumn;
+extern VALUE rb_cPG_ResultView;
 extern VALUE rb_hErrors;
 extern VALUE rb_cTypeMap;
 extern VALUE rb_cTypeMapAllStrings;
+extern VALUE rb_cTypeMapByColumn;
 extern VALUE rb_mDefaultTypeMappable;
 extern VALUE rb_cPG_Coder;
 extern VALUE rb_cPG_SimpleEncoder;
@@ -307,6 +393,15 @@ void Init_pg_ext                                       _(( void ));
 
 void init_pg_connection                                _(( void ));
 void init_pg_result                                    _(( void ));
+void init_pg_tuple                                     _(( void ));
+void init_pg_arrow                                     _(( void ));
+void init_pg_result_writer                             _(( void ));
+void init_pg_result_index                              _(( void ));
+void init_pg_spooled_result                            _(( void ));
+void init_pg_column_pack                               _(( void ));
+void init_pg_result_view                               _(( void ));
+void init_pg_result_aggregate                          _(( void ));
+void init_pg_result_dump                               _(( void ));
 void init_pg_errors                                    _(( void ));
 void init_pg_type_map                                  _(( void ));
 void init_pg_type_map_all_strings                      _(( void ));
@@ -324,12 +419,25 @@ void init_pg_binary_decoder                            _(( void ));
 VALUE lookup_error_class                               _(( const char * ));
 VALUE pg_bin_dec_bytea                                 _(( t_pg_coder*, char *, int, int, int, int ));
 VALUE pg_text_dec_string                               _(( t_pg_coder*, char *, int, int, int, int ));
+VALUE pg_text_dec_boolean                              _(( t_pg_coder*, char *, int, int, int, int ));
+VALUE pg_text_dec_integer                              _(( t_pg_coder*, char *, int, int, int, int ));
+VALUE pg_text_dec_float                                _(( t_pg_coder*, char *, int, int, int, int ));
+VALUE pg_date_new                                      _(( int64_t, int, int ));
+VALUE pg_time_new_local                                _(( int64_t, int, int, int, int, int, long ));
+VALUE pg_bigdecimal_new                               _(( VALUE ));
+VALUE pg_numeric_from_str                              _(( t_pg_coder*, char *, int, int, int, int, int ));
+VALUE pg_bin_dec_boolean                               _(( t_pg_coder*, char *, int, int, int, int ));
+VALUE pg_bin_dec_integer                               _(( t_pg_coder*, char *, int, int, int, int ));
+VALUE pg_bin_dec_float                                 _(( t_pg_coder*, char *, int, int, int, int ));
 int pg_coder_enc_to_s                                  _(( t_pg_coder*, VALUE, char *, VALUE *, int));
 int pg_text_enc_identifier                             _(( t_pg_coder*, VALUE, char *, VALUE *, int));
 t_pg_coder_enc_func pg_coder_enc_func                  _(( t_pg_coder* ));
 t_pg_coder_dec_func pg_coder_dec_func                  _(( t_pg_coder*, int ));
 void pg_define_coder                                   _(( const char *, void *, VALUE, VALUE ));
+VALUE pg_coder_dec_memo                                _(( t_pg_coder*, t_pg_coder_dec_func, char *, int, int, int, int ));
 VALUE pg_obj_to_i                                      _(( VALUE ));
+int pg_obj_is_date                                     _(( VALUE ));
+int64_t pg_date_to_days                                _(( VALUE ));
 VALUE pg_tmbc_allocate                                 _(( void ));
 void pg_coder_init_encoder                             _(( VALUE ));
 void pg_coder_init_decoder                             _(( VALUE ));
@@ -355,17 +463,41 @@ VALUE pg_typemap_fit_to_result                         _(( VALUE, VALUE ));
 VALUE pg_typemap_fit_to_query                          _(( VALUE, VALUE ));
 int pg_typemap_fit_to_copy_get                         _(( VALUE ));
 VALUE pg_typemap_result_value                          _(( t_typemap *, VALUE, int, int ));
+VALUE pg_tmas_result_value                             _(( t_typemap *, VALUE, int, int ));
+VALUE pg_tmbc_result_value                             _(( t_typemap *, VALUE, int, int ));
 t_pg_coder *pg_typemap_typecast_query_param            _(( t_typemap *, VALUE, int ));
 VALUE pg_typemap_typecast_copy_get                     _(( t_typemap *, VALUE, int, int, int ));
 
 PGconn *pg_get_pgconn                                  _(( VALUE ));
 t_pg_connection *pg_get_connection                     _(( VALUE ));
+int pg_result_limits_init                              _(( VALUE, t_pg_result_limits * ));
+void pg_result_limits_account                          _(( VALUE, t_pg_result_limits *, PGresult * ));
 
 VALUE pg_new_result                                    _(( PGresult *, VALUE ));
 VALUE pg_new_result_autoclear                          _(( PGresult *, VALUE ));
+void pg_result_set_cmd_status                          _(( VALUE, const char * ));
 PGresult* pgresult_get                                 _(( VALUE ));
 VALUE pg_result_check                                  _(( VALUE ));
 VALUE pg_result_clear                                  _(( VALUE ));
+VALUE pg_tuple_new                                     _(( VALUE, int ));
+int pg_result_field_name_type_flags                    _(( VALUE ));
+VALUE pg_result_field_name_type_sym                    _(( int ));
+int pg_result_field_number                             _(( VALUE, VALUE ));
+void pg_result_init_field_map                          _(( VALUE ));
+VALUE pg_result_tuple_values                           _(( VALUE, int, int ));
+VALUE pg_result_tuple_hash                             _(( VALUE, int ));
+int pg_pack_parse_int                                   _(( const char *, int64_t * ));
+int pg_pack_parse_timestamp                             _(( const char *, int64_t * ));
+int pg_pack_read_binary_int                             _(( const char *, int, int, int64_t * ));
+int pg_pack_read_binary_float                           _(( const char *, int, double * ));
+VALUE pg_result_aggregate                               _(( VALUE, const int *, long, VALUE, VALUE ));
+int pg_predecode_kind                                  _(( t_pg_coder_dec_func ));
+struct pg_predecode *pg_predecode_columns              _(( PGresult *, int, const int *, const int *, int, VALUE * ));
+t_pg_predecoded_column *pg_predecoded_column           _(( struct pg_predecode *, int ));
+VALUE pg_predecoded_value                              _(( t_pg_predecoded_column *, int ));
+#ifdef HAVE_PQSETSINGLEROWMODE
+VALUE pg_result_stream_any                             _(( VALUE, t_pg_result_yielder, void * ));
+#endif
 
 /*
  * Fetch the data pointer for the result object
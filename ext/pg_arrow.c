@@ -0,0 +1,866 @@
+/*
+ * pg_arrow.c - Apache Arrow IPC export of PG::Result
+ * $Id$
+ *
+ * This implements the Arrow IPC streaming format as described at
+ * https://arrow.apache.org/docs/format/Columnar.html#ipc-streaming-format
+ * without the need of an external library.
+ * The flatbuffers metadata is written by a minimal builder, which lays out
+ * all objects in forward direction and patches the offsets afterwards.
+ */
+
+#include "pg.h"
+#include "util.h"
+
+/* Type ids of the Type union in Schema.fbs */
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOATINGPOINT 3
+#define ARROW_TYPE_BINARY 4
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_BOOL 6
+#define ARROW_TYPE_DATE 8
+#define ARROW_TYPE_TIMESTAMP 10
+
+/* Ids of the MessageHeader union in Message.fbs */
+#define ARROW_MESSAGE_SCHEMA 1
+#define ARROW_MESSAGE_RECORD_BATCH 3
+
+#define ARROW_METADATA_VERSION_V5 4
+#define ARROW_PRECISION_SINGLE 1
+#define ARROW_PRECISION_DOUBLE 2
+#define ARROW_DATE_UNIT_DAY 0
+#define ARROW_TIME_UNIT_MICROSECOND 2
+
+/* All buffers are padded to this size */
+#define ARROW_ALIGNMENT 8
+
+/* OIDs of the PostgreSQL types with a dedicated Arrow type */
+#define PG_OID_BOOL 16
+#define PG_OID_BYTEA 17
+#define PG_OID_NAME 19
+#define PG_OID_INT8 20
+#define PG_OID_INT2 21
+#define PG_OID_INT4 23
+#define PG_OID_TEXT 25
+#define PG_OID_OID 26
+#define PG_OID_JSON 114
+#define PG_OID_XML 142
+#define PG_OID_FLOAT4 700
+#define PG_OID_FLOAT8 701
+#define PG_OID_UNKNOWN 705
+#define PG_OID_BPCHAR 1042
+#define PG_OID_VARCHAR 1043
+#define PG_OID_DATE 1082
+#define PG_OID_TIMESTAMP 1114
+#define PG_OID_TIMESTAMPTZ 1184
+
+/* Difference between the PostgreSQL epoch 2000-01-01 and the Unix epoch */
+#define PG_EPOCH_DAYS 10957
+#define PG_EPOCH_USECS INT64_C(946684800000000)
+
+/* The way a PostgreSQL value is stored into the Arrow column buffers */
+enum pg_arrow_conv {
+	CONV_VARLEN,
+	CONV_BYTEA_TEXT,
+	CONV_BOOL_TEXT,
+	CONV_BOOL_BIN,
+	CONV_INT_TEXT,
+	CONV_INT_BIN,
+	CONV_FLOAT_TEXT,
+	CONV_FLOAT_BIN,
+	CONV_DATE_BIN,
+	CONV_TIMESTAMP_BIN,
+};
+
+typedef struct {
+	char *ptr;
+	size_t len;
+	size_t capa;
+} t_arrow_buf;
+
+typedef struct {
+	int arrow_type;
+	enum pg_arrow_conv conv;
+	/* Byte width of fixed size values or 0 for variable length values */
+	int width;
+	int is_signed;
+	/* Time zone of Timestamp columns or NULL */
+	const char *timezone;
+
+	long null_count;
+	t_arrow_buf validity;
+	t_arrow_buf offsets;
+	t_arrow_buf data;
+} t_arrow_column;
+
+typedef struct {
+	/* IO to write each message to or nil to collect all messages into +out+ */
+	VALUE io;
+	VALUE out;
+	/* Flatbuffers metadata of the current message */
+	t_arrow_buf meta;
+	/* Maximum number of rows per record batch */
+	long batch_size;
+	/* Number of rows in the current record batch */
+	long num_rows;
+	int nfields;
+	t_arrow_column columns[0];
+} t_arrow_writer;
+
+static ID s_id_write;
+
+
+/*
+ * Growable byte buffers
+ */
+
+static void
+arrow_buf_reserve( t_arrow_buf *buf, size_t len )
+{
+	if( buf->len + len > buf->capa ){
+		size_t capa = buf->capa ? buf->capa : 256;
+		while( buf->len + len > capa ) capa *= 2;
+		buf->ptr = xrealloc( buf->ptr, capa );
+		buf->capa = capa;
+	}
+}
+
+static void
+arrow_buf_append( t_arrow_buf *buf, const void *ptr, size_t len )
+{
+	arrow_buf_reserve( buf, len );
+	memcpy( buf->ptr + buf->len, ptr, len );
+	buf->len += len;
+}
+
+static void
+arrow_buf_zero( t_arrow_buf *buf, size_t len )
+{
+	arrow_buf_reserve( buf, len );
+	memset( buf->ptr + buf->len, 0, len );
+	buf->len += len;
+}
+
+static void
+arrow_buf_pad( t_arrow_buf *buf, size_t align )
+{
+	if( buf->len % align )
+		arrow_buf_zero( buf, align - buf->len % align );
+}
+
+/* Store +width+ bytes of +value+ in little endian byte order. */
+static void
+arrow_store_le( char *ptr, uint64_t value, int width )
+{
+	int i;
+	for( i = 0; i < width; i++ ){
+		ptr[i] = (char)(value >> (8 * i));
+	}
+}
+
+static void
+arrow_buf_append_le( t_arrow_buf *buf, uint64_t value, int width )
+{
+	arrow_buf_reserve( buf, width );
+	arrow_store_le( buf->ptr + buf->len, value, width );
+	buf->len += width;
+}
+
+/* Set bit +idx+ in a bitmap buffer, which is extended when necessary. */
+static void
+arrow_buf_set_bit( t_arrow_buf *buf, long idx, int value )
+{
+	if( (size_t)(idx / 8) >= buf->len )
+		arrow_buf_zero( buf, 1 );
+	if( value )
+		buf->ptr[idx / 8] |= (char)(1 << (idx % 8));
+}
+
+
+/*
+ * Minimal flatbuffers builder
+ *
+ * Objects are written in forward direction: vtables precede their tables and
+ * all referenced objects follow the referring table. Offsets to referenced
+ * objects are patched by fb_patch() when the object is written.
+ */
+
+typedef struct {
+	/* 0 for absent fields, otherwise 1, 2, 4 or 8 */
+	int size;
+	uint64_t value;
+} t_fb_field;
+
+#define FB_MAX_FIELDS 8
+
+static void
+fb_patch( t_arrow_buf *b, size_t slot, size_t target )
+{
+	arrow_store_le( b->ptr + slot, target - slot, 4 );
+}
+
+/*
+ * Write a table with the given scalar fields.
+ * Offset fields are given with size 4 and must be patched per fb_patch().
+ * The positions of the fields are stored into +field_pos+ .
+ */
+static size_t
+fb_table( t_arrow_buf *b, int nfields, const t_fb_field *fields, size_t *field_pos )
+{
+	size_t vtable_pos, table_pos, off;
+	uint16_t field_off[FB_MAX_FIELDS];
+	int i, size, max_align = 4;
+
+	for( i = 0; i < nfields; i++ ){
+		if( fields[i].size > max_align ) max_align = fields[i].size;
+	}
+
+	arrow_buf_pad( b, 2 );
+	vtable_pos = b->len;
+	table_pos = vtable_pos + 4 + 2 * nfields;
+	table_pos = (table_pos + max_align - 1) / max_align * max_align;
+
+	/* Place the fields in descending size order behind the vtable offset */
+	off = 4;
+	for( size = 8; size >= 1; size /= 2 ){
+		for( i = 0; i < nfields; i++ ){
+			if( fields[i].size != size ) continue;
+			off = (table_pos + off + size - 1) / size * size - table_pos;
+			field_off[i] = (uint16_t)off;
+			off += size;
+		}
+	}
+	for( i = 0; i < nfields; i++ ){
+		if( fields[i].size == 0 ) field_off[i] = 0;
+	}
+
+	arrow_buf_append_le( b, 4 + 2 * nfields, 2 );
+	arrow_buf_append_le( b, off, 2 );
+	for( i = 0; i < nfields; i++ ){
+		arrow_buf_append_le( b, field_off[i], 2 );
+	}
+
+	arrow_buf_zero( b, table_pos - b->len + off );
+	arrow_store_le( b->ptr + table_pos, table_pos - vtable_pos, 4 );
+	for( i = 0; i < nfields; i++ ){
+		if( fields[i].size == 0 ) continue;
+		arrow_store_le( b->ptr + table_pos + field_off[i], fields[i].value, fields[i].size );
+		if( field_pos ) field_pos[i] = table_pos + field_off[i];
+	}
+
+	return table_pos;
+}
+
+/*
+ * Write a vector of +len+ elements of +elem_size+ bytes.
+ * The elements are zero initialized and start at the returned position + 4.
+ */
+static size_t
+fb_vector( t_arrow_buf *b, size_t len, size_t elem_size, size_t align )
+{
+	size_t vec_pos;
+
+	arrow_buf_pad( b, 4 );
+	while( (b->len + 4) % align )
+		arrow_buf_zero( b, 4 );
+	vec_pos = b->len;
+	arrow_buf_append_le( b, len, 4 );
+	arrow_buf_zero( b, len * elem_size );
+
+	return vec_pos;
+}
+
+static size_t
+fb_string( t_arrow_buf *b, const char *str, size_t len )
+{
+	size_t str_pos;
+
+	arrow_buf_pad( b, 4 );
+	str_pos = b->len;
+	arrow_buf_append_le( b, len, 4 );
+	arrow_buf_append( b, str, len );
+	arrow_buf_zero( b, 1 );
+
+	return str_pos;
+}
+
+/*
+ * Start a Message table and return the position of the header offset.
+ */
+static size_t
+fb_message( t_arrow_buf *b, int header_type, int64_t body_length )
+{
+	t_fb_field fields[4] = {
+		{ 2, ARROW_METADATA_VERSION_V5 },
+		{ 1, header_type },
+		{ 4, 0 },
+		{ 8, (uint64_t)body_length },
+	};
+	size_t field_pos[4];
+
+	b->len = 0;
+	/* root offset */
+	arrow_buf_zero( b, 4 );
+	fb_patch( b, 0, fb_table(b, 4, fields, field_pos) );
+
+	return field_pos[2];
+}
+
+
+/*
+ * Column buffers
+ */
+
+static void
+pg_arrow_column_init( t_arrow_column *col, Oid oid, int format )
+{
+	col->timezone = NULL;
+	col->is_signed = 1;
+	col->width = 0;
+
+	switch( oid ){
+		case PG_OID_BOOL:
+			col->arrow_type = ARROW_TYPE_BOOL;
+			col->conv = format ? CONV_BOOL_BIN : CONV_BOOL_TEXT;
+			return;
+		case PG_OID_INT2:
+			col->width = 2;
+			break;
+		case PG_OID_INT4:
+			col->width = 4;
+			break;
+		case PG_OID_OID:
+			col->width = 4;
+			col->is_signed = 0;
+			break;
+		case PG_OID_INT8:
+			col->width = 8;
+			break;
+		case PG_OID_FLOAT4:
+		case PG_OID_FLOAT8:
+			col->arrow_type = ARROW_TYPE_FLOATINGPOINT;
+			col->width = oid == PG_OID_FLOAT4 ? 4 : 8;
+			col->conv = format ? CONV_FLOAT_BIN : CONV_FLOAT_TEXT;
+			return;
+		case PG_OID_BYTEA:
+			col->arrow_type = ARROW_TYPE_BINARY;
+			col->conv = format ? CONV_VARLEN : CONV_BYTEA_TEXT;
+			return;
+		case PG_OID_DATE:
+			/* The text representation depends on DateStyle, so that only
+			 * binary values are converted. */
+			if( format ){
+				col->arrow_type = ARROW_TYPE_DATE;
+				col->width = 4;
+				col->conv = CONV_DATE_BIN;
+				return;
+			}
+			break;
+		case PG_OID_TIMESTAMP:
+		case PG_OID_TIMESTAMPTZ:
+			if( format ){
+				col->arrow_type = ARROW_TYPE_TIMESTAMP;
+				col->width = 8;
+				col->conv = CONV_TIMESTAMP_BIN;
+				col->timezone = oid == PG_OID_TIMESTAMPTZ ? "UTC" : NULL;
+				return;
+			}
+			break;
+	}
+
+	if( col->width ){
+		col->arrow_type = ARROW_TYPE_INT;
+		col->conv = format ? CONV_INT_BIN : CONV_INT_TEXT;
+		return;
+	}
+
+	col->conv = CONV_VARLEN;
+	switch( oid ){
+		case PG_OID_NAME:
+		case PG_OID_TEXT:
+		case PG_OID_JSON:
+		case PG_OID_XML:
+		case PG_OID_UNKNOWN:
+		case PG_OID_BPCHAR:
+		case PG_OID_VARCHAR:
+			col->arrow_type = ARROW_TYPE_UTF8;
+			break;
+		default:
+			/* All other types are passed in their PostgreSQL representation. */
+			col->arrow_type = format ? ARROW_TYPE_BINARY : ARROW_TYPE_UTF8;
+	}
+}
+
+static void
+pg_arrow_column_reset( t_arrow_column *col )
+{
+	col->null_count = 0;
+	col->validity.len = 0;
+	col->offsets.len = 0;
+	col->data.len = 0;
+	if( col->width == 0 && col->arrow_type != ARROW_TYPE_BOOL )
+		arrow_buf_append_le( &col->offsets, 0, 4 );
+}
+
+static void
+pg_arrow_column_append( t_arrow_column *col, long row, const char *val, int len, int isnull )
+{
+	uint64_t value = 0;
+
+	arrow_buf_set_bit( &col->validity, row, !isnull );
+	if( isnull )
+		col->null_count++;
+
+	switch( col->conv ){
+		case CONV_VARLEN:
+			if( !isnull )
+				arrow_buf_append( &col->data, val, len );
+			arrow_buf_append_le( &col->offsets, col->data.len, 4 );
+			return;
+		case CONV_BYTEA_TEXT:
+			if( !isnull ){
+				size_t to_len;
+				unsigned char *to = PQunescapeBytea( (const unsigned char *)val, &to_len );
+				if( to == NULL )
+					rb_raise( rb_eNoMemError, "PQunescapeBytea failure: probably not enough memory" );
+				arrow_buf_append( &col->data, to, to_len );
+				PQfreemem( to );
+			}
+			arrow_buf_append_le( &col->offsets, col->data.len, 4 );
+			return;
+		case CONV_BOOL_TEXT:
+			arrow_buf_set_bit( &col->data, row, !isnull && val[0] == 't' );
+			return;
+		case CONV_BOOL_BIN:
+			arrow_buf_set_bit( &col->data, row, !isnull && len > 0 && val[0] != 0 );
+			return;
+		default:
+			break;
+	}
+
+	if( !isnull ){
+		switch( col->conv ){
+			case CONV_INT_TEXT:
+				value = (uint64_t)strtoll( val, NULL, 10 );
+				break;
+			case CONV_INT_BIN:
+			case CONV_FLOAT_BIN:
+				switch( len ){
+					case 2: value = (uint64_t)read_nbo16( val ); break;
+					case 4: value = (uint32_t)read_nbo32( val ); break;
+					case 8: value = (uint64_t)read_nbo64( val ); break;
+				}
+				break;
+			case CONV_FLOAT_TEXT:
+				if( col->width == 4 ){
+					union { float f; uint32_t i; } swap4;
+					swap4.f = strtof( val, NULL );
+					value = swap4.i;
+				} else {
+					union { double f; uint64_t i; } swap8;
+					swap8.f = strtod( val, NULL );
+					value = swap8.i;
+				}
+				break;
+			case CONV_DATE_BIN:{
+				int32_t date = read_nbo32( val );
+				/* keep +-infinity at the limits of the value range */
+				if( date != INT32_MAX && date != INT32_MIN )
+					date += PG_EPOCH_DAYS;
+				value = (uint32_t)date;
+				break;
+			}
+			case CONV_TIMESTAMP_BIN:{
+				int64_t timestamp = read_nbo64( val );
+				if( timestamp != INT64_MAX && timestamp != INT64_MIN )
+					timestamp += PG_EPOCH_USECS;
+				value = (uint64_t)timestamp;
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	arrow_buf_append_le( &col->data, value, col->width );
+}
+
+
+/*
+ * IPC messages
+ */
+
+static void
+pg_arrow_write_out( t_arrow_writer *this )
+{
+	if( !NIL_P(this->io) && RSTRING_LEN(this->out) > 0 ){
+		VALUE out = this->out;
+		this->out = rb_str_new( NULL, 0 );
+		rb_funcall( this->io, s_id_write, 1, out );
+	}
+}
+
+/* Append the encapsulated message with the flatbuffers metadata of +this->meta+ . */
+static void
+pg_arrow_append_message_header( t_arrow_writer *this )
+{
+	char prefix[8];
+
+	arrow_buf_pad( &this->meta, ARROW_ALIGNMENT );
+	arrow_store_le( prefix, 0xFFFFFFFF, 4 );
+	arrow_store_le( prefix + 4, this->meta.len, 4 );
+	rb_str_cat( this->out, prefix, sizeof(prefix) );
+	rb_str_cat( this->out, this->meta.ptr, this->meta.len );
+}
+
+static void
+pg_arrow_write_schema( t_arrow_writer *this, PGresult *pgresult )
+{
+	t_arrow_buf *b = &this->meta;
+	t_fb_field schema_fields[2] = { { 2, 0 /* Little endian */ }, { 4, 0 } };
+	size_t header_pos, schema_pos[2], fields_pos;
+	int i;
+
+	header_pos = fb_message( b, ARROW_MESSAGE_SCHEMA, 0 );
+	fb_patch( b, header_pos, fb_table(b, 2, schema_fields, schema_pos) );
+	fields_pos = fb_vector( b, this->nfields, 4, 4 );
+	fb_patch( b, schema_pos[1], fields_pos );
+
+	for( i = 0; i < this->nfields; i++ ){
+		t_arrow_column *col = &this->columns[i];
+		const char *name = PQfname( pgresult, i );
+		t_fb_field field_fields[6] = {
+			{ 4, 0 },                     /* name */
+			{ 1, 1 },                     /* nullable */
+			{ 1, col->arrow_type },       /* type_type */
+			{ 4, 0 },                     /* type */
+			{ 0, 0 },                     /* dictionary */
+			{ 4, 0 },                     /* children */
+		};
+		t_fb_field type_fields[2];
+		size_t field_pos[6], type_pos[2];
+		int type_nfields = 0;
+
+		fb_patch( b, fields_pos + 4 + 4 * i, fb_table(b, 6, field_fields, field_pos) );
+		fb_patch( b, field_pos[0], fb_string(b, name, strlen(name)) );
+
+		switch( col->arrow_type ){
+			case ARROW_TYPE_INT:
+				type_fields[0].size = 4; type_fields[0].value = col->width * 8;
+				type_fields[1].size = 1; type_fields[1].value = col->is_signed;
+				type_nfields = 2;
+				break;
+			case ARROW_TYPE_FLOATINGPOINT:
+				type_fields[0].size = 2;
+				type_fields[0].value = col->width == 4 ? ARROW_PRECISION_SINGLE : ARROW_PRECISION_DOUBLE;
+				type_nfields = 1;
+				break;
+			case ARROW_TYPE_DATE:
+				type_fields[0].size = 2; type_fields[0].value = ARROW_DATE_UNIT_DAY;
+				type_nfields = 1;
+				break;
+			case ARROW_TYPE_TIMESTAMP:
+				type_fields[0].size = 2; type_fields[0].value = ARROW_TIME_UNIT_MICROSECOND;
+				type_fields[1].size = col->timezone ? 4 : 0; type_fields[1].value = 0;
+				type_nfields = 2;
+				break;
+		}
+		fb_patch( b, field_pos[3], fb_table(b, type_nfields, type_fields, type_pos) );
+		if( col->timezone )
+			fb_patch( b, type_pos[1], fb_string(b, col->timezone, strlen(col->timezone)) );
+
+		fb_patch( b, field_pos[5], fb_vector(b, 0, 4, 4) );
+	}
+
+	pg_arrow_append_message_header( this );
+}
+
+static size_t
+pg_arrow_padded( size_t len )
+{
+	return (len + ARROW_ALIGNMENT - 1) / ARROW_ALIGNMENT * ARROW_ALIGNMENT;
+}
+
+#define ARROW_MAX_BUFFERS_PER_COLUMN 3
+
+/* Collect the buffers of a column in the order of the IPC format. */
+static int
+pg_arrow_column_buffers( t_arrow_column *col, t_arrow_buf **bufs )
+{
+	int n = 0;
+	bufs[n++] = &col->validity;
+	if( col->width == 0 && col->arrow_type != ARROW_TYPE_BOOL )
+		bufs[n++] = &col->offsets;
+	bufs[n++] = &col->data;
+	return n;
+}
+
+static void
+pg_arrow_flush_batch( t_arrow_writer *this )
+{
+	t_arrow_buf *b = &this->meta;
+	t_fb_field batch_fields[3] = { { 8, (uint64_t)this->num_rows }, { 4, 0 }, { 4, 0 } };
+	size_t header_pos, batch_pos[3], nodes_pos, buffers_pos;
+	size_t body_length = 0, num_buffers = 0;
+	int i, j;
+
+	if( this->num_rows == 0 )
+		return;
+
+	for( i = 0; i < this->nfields; i++ ){
+		t_arrow_buf *bufs[ARROW_MAX_BUFFERS_PER_COLUMN];
+		int n = pg_arrow_column_buffers( &this->columns[i], bufs );
+		for( j = 0; j < n; j++ ){
+			body_length += pg_arrow_padded( bufs[j]->len );
+		}
+		num_buffers += n;
+	}
+
+	header_pos = fb_message( b, ARROW_MESSAGE_RECORD_BATCH, body_length );
+	fb_patch( b, header_pos, fb_table(b, 3, batch_fields, batch_pos) );
+
+	/* FieldNode structs: length, null_count */
+	nodes_pos = fb_vector( b, this->nfields, 16, 8 );
+	fb_patch( b, batch_pos[1], nodes_pos );
+	for( i = 0; i < this->nfields; i++ ){
+		arrow_store_le( b->ptr + nodes_pos + 4 + 16 * i, this->num_rows, 8 );
+		arrow_store_le( b->ptr + nodes_pos + 4 + 16 * i + 8, this->columns[i].null_count, 8 );
+	}
+
+	/* Buffer structs: offset, length */
+	buffers_pos = fb_vector( b, num_buffers, 16, 8 );
+	fb_patch( b, batch_pos[2], buffers_pos );
+	body_length = 0;
+	num_buffers = 0;
+	for( i = 0; i < this->nfields; i++ ){
+		t_arrow_buf *bufs[ARROW_MAX_BUFFERS_PER_COLUMN];
+		int n = pg_arrow_column_buffers( &this->columns[i], bufs );
+		for( j = 0; j < n; j++, num_buffers++ ){
+			arrow_store_le( b->ptr + buffers_pos + 4 + 16 * num_buffers, body_length, 8 );
+			arrow_store_le( b->ptr + buffers_pos + 4 + 16 * num_buffers + 8, bufs[j]->len, 8 );
+			body_length += pg_arrow_padded( bufs[j]->len );
+		}
+	}
+
+	pg_arrow_append_message_header( this );
+
+	/* message body */
+	for( i = 0; i < this->nfields; i++ ){
+		t_arrow_buf *bufs[ARROW_MAX_BUFFERS_PER_COLUMN];
+		int n = pg_arrow_column_buffers( &this->columns[i], bufs );
+		for( j = 0; j < n; j++ ){
+			arrow_buf_pad( bufs[j], ARROW_ALIGNMENT );
+			rb_str_cat( this->out, bufs[j]->ptr, bufs[j]->len );
+		}
+		pg_arrow_column_reset( &this->columns[i] );
+	}
+
+	this->num_rows = 0;
+	pg_arrow_write_out( this );
+}
+
+static void
+pg_arrow_write_eos( t_arrow_writer *this )
+{
+	char eos[8];
+
+	pg_arrow_flush_batch( this );
+	arrow_store_le( eos, 0xFFFFFFFF, 4 );
+	arrow_store_le( eos + 4, 0, 4 );
+	rb_str_cat( this->out, eos, sizeof(eos) );
+	pg_arrow_write_out( this );
+}
+
+
+/*
+ * Writer object
+ */
+
+static void
+pg_arrow_writer_mark( t_arrow_writer *this )
+{
+	rb_gc_mark( this->io );
+	rb_gc_mark( this->out );
+}
+
+static void
+pg_arrow_writer_free( t_arrow_writer *this )
+{
+	int i;
+
+	for( i = 0; i < this->nfields; i++ ){
+		xfree( this->columns[i].validity.ptr );
+		xfree( this->columns[i].offsets.ptr );
+		xfree( this->columns[i].data.ptr );
+	}
+	xfree( this->meta.ptr );
+	xfree( this );
+}
+
+/*
+ * Create a writer for the fields of +pgresult+ and write the schema message.
+ * The writer is wrapped into a hidden object, so that it's freed by the GC
+ * in case of exceptions.
+ */
+static t_arrow_writer *
+pg_arrow_writer_new( PGresult *pgresult, VALUE io, long batch_size, VALUE *p_wrapper )
+{
+	int nfields = PQnfields( pgresult );
+	t_arrow_writer *this;
+	int i;
+
+	this = xmalloc( sizeof(*this) + sizeof(*this->columns) * nfields );
+	memset( this, 0, sizeof(*this) + sizeof(*this->columns) * nfields );
+	this->io = io;
+	this->out = rb_str_new( NULL, 0 );
+	this->batch_size = batch_size;
+	this->nfields = nfields;
+	*p_wrapper = Data_Wrap_Struct( 0, pg_arrow_writer_mark, pg_arrow_writer_free, this );
+
+	for( i = 0; i < nfields; i++ ){
+		pg_arrow_column_init( &this->columns[i], PQftype(pgresult, i), PQfformat(pgresult, i) );
+		pg_arrow_column_reset( &this->columns[i] );
+	}
+
+	pg_arrow_write_schema( this, pgresult );
+	pg_arrow_write_out( this );
+
+	return this;
+}
+
+/*
+ * Append all rows of +pgresult+ to the record batch.
+ * A batch is flushed when it has +batch_size+ rows or when a variable length
+ * data buffer would exceed the range of 32 bit offsets.
+ */
+static void
+pg_arrow_append_rows( t_arrow_writer *this, PGresult *pgresult )
+{
+	int ntuples = PQntuples( pgresult );
+	int row, field;
+
+	for( row = 0; row < ntuples; row++ ){
+		for( field = 0; field < this->nfields; field++ ){
+			t_arrow_column *col = &this->columns[field];
+			if( col->width == 0 && col->data.len + PQgetlength(pgresult, row, field) > INT32_MAX ){
+				pg_arrow_flush_batch( this );
+				break;
+			}
+		}
+
+		for( field = 0; field < this->nfields; field++ ){
+			pg_arrow_column_append( &this->columns[field], this->num_rows,
+					PQgetvalue(pgresult, row, field), PQgetlength(pgresult, row, field),
+					PQgetisnull(pgresult, row, field) );
+		}
+		if( ++this->num_rows >= this->batch_size )
+			pg_arrow_flush_batch( this );
+	}
+}
+
+
+/*
+ * call-seq:
+ *    res.to_arrow_ipc -> String
+ *
+ * Returns the result as Apache Arrow IPC stream.
+ *
+ * The stream consists of the schema, one record batch with all rows and
+ * the end-of-stream marker. It can be read by any Arrow implementation,
+ * for instance per <tt>pyarrow.ipc.open_stream</tt> .
+ * The values are copied from the result without creating Ruby objects.
+ *
+ * The Arrow types are derived from the PostgreSQL column types:
+ * * +bool+ -> Bool
+ * * +int2+ , +int4+ , +int8+ -> Int16, Int32, Int64
+ * * +oid+ -> UInt32
+ * * +float4+ , +float8+ -> Float32, Float64
+ * * +bytea+ -> Binary
+ * * +date+ -> Date32 (binary format only)
+ * * +timestamp+ , +timestamptz+ -> Timestamp in microseconds (binary format only)
+ * * all other types -> Utf8 in text format and Binary in binary format
+ *
+ * Values of Utf8 columns are passed unchanged, so that the connection should
+ * use UTF8 as client_encoding.
+ * NULL values are marked per validity bitmap.
+ *
+ * See #stream_arrow_ipc for the streaming counterpart.
+ */
+static VALUE
+pgresult_to_arrow_ipc( VALUE self )
+{
+	PGresult *pgresult = pgresult_get( self );
+	VALUE wrapper;
+	t_arrow_writer *this = pg_arrow_writer_new( pgresult, Qnil, LONG_MAX, &wrapper );
+
+	pg_arrow_append_rows( this, pgresult );
+	pg_arrow_write_eos( this );
+
+	RB_GC_GUARD( wrapper );
+	return this->out;
+}
+
+#ifdef HAVE_PQSETSINGLEROWMODE
+static void
+yield_arrow_rows( VALUE self, int ntuples, int nfields, void *data )
+{
+	pg_arrow_append_rows( data, pgresult_get(self) );
+}
+
+/*
+ * call-seq:
+ *    res.stream_arrow_ipc( io, batch: 65536 ) -> self
+ *
+ * Writes all rows of a result in single row or chunked rows mode as
+ * Apache Arrow IPC stream to +io+ .
+ *
+ * The rows are coalesced to record batches of up to +batch+ rows, each
+ * written per <tt>io.write</tt> . See #to_arrow_ipc for the type mapping.
+ *
+ * Example:
+ *   conn.send_query( "SELECT * FROM large_table" )
+ *   conn.set_chunked_rows_mode( 10000 )
+ *   File.open( "large_table.arrows", "wb" ) do |fd|
+ *     conn.get_result.stream_arrow_ipc( fd )
+ *   end
+ *
+ * Available since PostgreSQL-9.2
+ */
+static VALUE
+pgresult_stream_arrow_ipc( int argc, VALUE *argv, VALUE self )
+{
+	VALUE io, opts, wrapper, batch;
+	long batch_size = 65536;
+	t_arrow_writer *this;
+
+	rb_scan_args( argc, argv, "11", &io, &opts );
+	if( !NIL_P(opts) ){
+		Check_Type( opts, T_HASH );
+		batch = rb_hash_aref( opts, ID2SYM(rb_intern("batch")) );
+		if( !NIL_P(batch) ){
+			batch_size = NUM2LONG( batch );
+			if( batch_size < 1 )
+				rb_raise( rb_eArgError, "batch size must be positive" );
+		}
+	}
+
+	this = pg_arrow_writer_new( pgresult_get(self), io, batch_size, &wrapper );
+	pg_result_stream_any( self, yield_arrow_rows, this );
+	pg_arrow_write_eos( this );
+
+	RB_GC_GUARD( wrapper );
+	return self;
+}
+#endif
+
+
+void
+init_pg_arrow()
+{
+	s_id_write = rb_intern("write");
+
+	rb_define_method(rb_cPGresult, "to_arrow_ipc", pgresult_to_arrow_ipc, 0);
+#ifdef HAVE_PQSETSINGLEROWMODE
+	rb_define_method(rb_cPGresult, "stream_arrow_ipc", pgresult_stream_arrow_ipc, -1);
+#endif
+}
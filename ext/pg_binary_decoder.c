@@ -9,8 +9,12 @@
 #ifdef HAVE_INTTYPES_H
 #include <inttypes.h>
 #endif
+#include <math.h>
 
 VALUE rb_mPG_BinaryDecoder;
+static ID s_id_months;
+static ID s_id_days;
+static ID s_id_microseconds;
 
 
 /*
@@ -20,7 +24,7 @@ VALUE rb_mPG_BinaryDecoder;
  * to Ruby true or false objects.
  *
  */
-static VALUE
+VALUE
 pg_bin_dec_boolean(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
 {
 	if (len < 1) {
@@ -36,7 +40,7 @@ pg_bin_dec_boolean(t_pg_coder *conv, char *val, int len, int tuple, int field, i
  * to Ruby Integer objects.
  *
  */
-static VALUE
+VALUE
 pg_bin_dec_integer(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
 {
 	switch( len ){
@@ -58,7 +62,7 @@ pg_bin_dec_integer(t_pg_coder *conv, char *val, int len, int tuple, int field, i
  * to Ruby Float objects.
  *
  */
-static VALUE
+VALUE
 pg_bin_dec_float(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
 {
 	union {
@@ -99,6 +103,326 @@ pg_bin_dec_bytea(t_pg_coder *conv, char *val, int len, int tuple, int field, int
 	return ret;
 }
 
+/*
+ * Document-class: PG::BinaryDecoder::Numeric < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL binary numeric type
+ * to Ruby BigDecimal objects.
+ *
+ * Other types can be selected by PG::Coder#flags like for PG::TextDecoder::Numeric .
+ *
+ */
+static VALUE
+pg_bin_dec_numeric(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	char buf[64];
+	char *str = buf;
+	int size, integral;
+	VALUE ret, str_holder = Qnil;
+
+	size = pg_numeric_bin_to_str( val, len, NULL );
+	if( size < 0 ){
+		rb_raise( rb_eTypeError, "wrong data for binary numeric converter in tuple %d field %d length %d", tuple, field, len);
+	}
+	integral = len >= 8 && read_nbo16(val + 6) == 0 && ((uint16_t)read_nbo16(val + 4) & 0x8000) == 0;
+
+	if( integral && (conv->flags & PG_CODER_NUMERIC_AS_INTEGER) ){
+		int ndigits = read_nbo16( val );
+		int weight = read_nbo16( val + 2 );
+
+		/* Up to 16 decimal digits fit into int64 without overflow check. */
+		if( weight < 4 ){
+			int64_t i = 0;
+			int d;
+
+			for( d = 0; d <= weight; d++ ){
+				i = i * 10000 + (d < ndigits ? read_nbo16(val + 8 + d * 2) : 0);
+			}
+			return LL2NUM( read_nbo16(val + 4) ? -i : i );
+		}
+	}
+
+	if( size >= (int)sizeof(buf) ){
+		str_holder = rb_str_new( NULL, size );
+		str = RSTRING_PTR( str_holder );
+	}
+	size = pg_numeric_bin_to_str( val, len, str );
+	str[size] = 0;
+	ret = pg_numeric_from_str( conv, str, size, integral, tuple, field, enc_idx );
+	RB_GC_GUARD( str_holder );
+	return ret;
+}
+
+static VALUE
+pg_bin_dec_infinity( int64_t value )
+{
+	return rb_float_new( value > 0 ? HUGE_VAL : -HUGE_VAL );
+}
+
+/* Convert microseconds since 2000-01-01 to an Integer of microseconds since 1970-01-01. */
+static VALUE
+pg_bin_dec_epoch_usec( int64_t usec )
+{
+	if( usec > INT64_MAX - POSTGRES_EPOCH_USEC ){
+		return rb_funcall( LL2NUM(usec), '+', 1, LL2NUM(POSTGRES_EPOCH_USEC) );
+	}
+	return LL2NUM( usec + POSTGRES_EPOCH_USEC );
+}
+
+/*
+ * Document-class: PG::BinaryDecoder::TimestampWithoutTimeZone < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL binary timestamp type
+ * to Ruby Time objects in local time.
+ *
+ * If PG::Coder::TIME_RAW is set in PG::Coder#flags , the value is returned as
+ * Integer microseconds of the wall clock since 1970-01-01 00:00:00, without
+ * building a Time object.
+ * The values +infinity+ and +-infinity+ are returned as Float::INFINITY
+ * and -Float::INFINITY.
+ *
+ */
+static VALUE
+pg_bin_dec_timestamp(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	int64_t usec, days, usec_of_day, year;
+	int mon, day;
+
+	if( len != 8 ){
+		rb_raise( rb_eTypeError, "wrong data for binary timestamp converter in tuple %d field %d length %d", tuple, field, len);
+	}
+	usec = read_nbo64(val);
+	if( usec == INT64_MAX || usec == INT64_MIN )
+		return pg_bin_dec_infinity( usec );
+	if( conv->flags & PG_CODER_TIME_RAW )
+		return pg_bin_dec_epoch_usec( usec );
+
+	days = usec / USEC_PER_DAY;
+	usec_of_day = usec % USEC_PER_DAY;
+	if( usec_of_day < 0 ){
+		usec_of_day += USEC_PER_DAY;
+		days--;
+	}
+	pg_civil_from_days( days + POSTGRES_EPOCH_DAYS, &year, &mon, &day );
+	return pg_time_new_local( year, mon, day,
+			(int)(usec_of_day / INT64_C(3600000000)),
+			(int)(usec_of_day / 60000000 % 60),
+			(int)(usec_of_day / 1000000 % 60),
+			(long)(usec_of_day % 1000000) * 1000 );
+}
+
+/*
+ * Document-class: PG::BinaryDecoder::TimestampWithTimeZone < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL binary timestamptz type
+ * to Ruby Time objects in local time.
+ *
+ * If PG::Coder::TIME_RAW is set in PG::Coder#flags , the value is returned as
+ * Integer microseconds since 1970-01-01 00:00:00 UTC, without building a
+ * Time object.
+ * The values +infinity+ and +-infinity+ are returned as Float::INFINITY
+ * and -Float::INFINITY.
+ *
+ */
+static VALUE
+pg_bin_dec_timestamptz(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	int64_t usec;
+	struct timespec ts;
+
+	if( len != 8 ){
+		rb_raise( rb_eTypeError, "wrong data for binary timestamptz converter in tuple %d field %d length %d", tuple, field, len);
+	}
+	usec = read_nbo64(val);
+	if( usec == INT64_MAX || usec == INT64_MIN )
+		return pg_bin_dec_infinity( usec );
+	if( conv->flags & PG_CODER_TIME_RAW )
+		return pg_bin_dec_epoch_usec( usec );
+
+	ts.tv_sec = (time_t)(usec / 1000000);
+	ts.tv_nsec = (long)(usec % 1000000) * 1000;
+	if( ts.tv_nsec < 0 ){
+		ts.tv_nsec += 1000000000;
+		ts.tv_sec--;
+	}
+	ts.tv_sec += POSTGRES_EPOCH_USEC / 1000000;
+	return rb_time_timespec_new( &ts, INT_MAX );
+}
+
+/*
+ * Document-class: PG::BinaryDecoder::Date < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL binary date type
+ * to Ruby Date objects in the proleptic Gregorian calendar.
+ *
+ * If PG::Coder::TIME_RAW is set in PG::Coder#flags , the value is returned as
+ * Integer days since 1970-01-01, without building a Date object.
+ * The values +infinity+ and +-infinity+ are returned as Float::INFINITY
+ * and -Float::INFINITY.
+ *
+ */
+static VALUE
+pg_bin_dec_date(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	int32_t days;
+	int64_t year;
+	int mon, day;
+
+	if( len != 4 ){
+		rb_raise( rb_eTypeError, "wrong data for binary date converter in tuple %d field %d length %d", tuple, field, len);
+	}
+	days = read_nbo32(val);
+	if( days == INT32_MAX || days == INT32_MIN )
+		return pg_bin_dec_infinity( days );
+	if( conv->flags & PG_CODER_TIME_RAW )
+		return LONG2NUM( (long)days + POSTGRES_EPOCH_DAYS );
+
+	pg_civil_from_days( (int64_t)days + POSTGRES_EPOCH_DAYS, &year, &mon, &day );
+	return pg_date_new( year, mon, day );
+}
+
+/*
+ * Document-class: PG::BinaryDecoder::Interval < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL binary interval type
+ * to a Hash with the Integer values of the three parts of an interval:
+ *
+ *    { months: 14, days: 3, microseconds: 4500000 }  # '1 year 2 mons 3 days 4.5 secs'
+ *
+ * If PG::Coder::TIME_RAW is set in PG::Coder#flags , the interval is returned as
+ * Integer microseconds, taking a month as 30 days and a day as 24 hours, like
+ * PostgreSQL does to compare intervals.
+ *
+ */
+static VALUE
+pg_bin_dec_interval(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	int64_t usec;
+	int32_t days, months;
+	VALUE hash;
+
+	if( len != 16 ){
+		rb_raise( rb_eTypeError, "wrong data for binary interval converter in tuple %d field %d length %d", tuple, field, len);
+	}
+	usec = read_nbo64(val);
+	days = read_nbo32(val + 8);
+	months = read_nbo32(val + 12);
+
+	if( conv->flags & PG_CODER_TIME_RAW ){
+		int64_t total_days = (int64_t)months * 30 + days;
+		int64_t day_usec;
+
+		if( total_days > INT64_MAX / USEC_PER_DAY || total_days < INT64_MIN / USEC_PER_DAY ){
+			VALUE day_num = rb_funcall( LL2NUM(total_days), '*', 1, LL2NUM(USEC_PER_DAY) );
+			return rb_funcall( day_num, '+', 1, LL2NUM(usec) );
+		}
+		day_usec = total_days * USEC_PER_DAY;
+		if( (day_usec > 0 && usec > INT64_MAX - day_usec) || (day_usec < 0 && usec < INT64_MIN - day_usec) ){
+			return rb_funcall( LL2NUM(usec), '+', 1, LL2NUM(day_usec) );
+		}
+		return LL2NUM( usec + day_usec );
+	}
+
+	hash = rb_hash_new();
+	rb_hash_aset( hash, ID2SYM(s_id_months), LONG2NUM(months) );
+	rb_hash_aset( hash, ID2SYM(s_id_days), LONG2NUM(days) );
+	rb_hash_aset( hash, ID2SYM(s_id_microseconds), LL2NUM(usec) );
+	return hash;
+}
+
+/* Maximum number of array dimensions of PostgreSQL */
+#define ARRAY_MAXDIM 6
+
+static void
+pg_bin_dec_array_raise( int tuple, int field, const char *what )
+{
+	rb_raise( rb_eTypeError, "wrong data for binary array converter in tuple %d field %d: %s", tuple, field, what );
+}
+
+static VALUE
+read_bin_array(t_pg_composite_coder *this, const char **pp, const char *end, const int *dims, int ndim, VALUE buf, int tuple, int field, int enc_idx, t_pg_coder_dec_func dec_func)
+{
+	VALUE array = rb_ary_new2( dims[0] );
+	int i;
+
+	for( i = 0; i < dims[0]; i++ ){
+		if( ndim > 1 ){
+			rb_ary_push( array, read_bin_array(this, pp, end, dims + 1, ndim - 1, buf, tuple, field, enc_idx, dec_func) );
+		}else{
+			int elem_len;
+
+			if( end - *pp < 4 ) pg_bin_dec_array_raise( tuple, field, "data too short" );
+			elem_len = read_nbo32( *pp );
+			*pp += 4;
+
+			if( elem_len == -1 ){
+				rb_ary_push( array, Qnil );
+			}else{
+				char *elem;
+
+				if( elem_len < 0 || end - *pp < elem_len ) pg_bin_dec_array_raise( tuple, field, "data too short" );
+				/* Decoders expect the value to be zero terminated. */
+				rb_str_resize( buf, elem_len );
+				elem = RSTRING_PTR( buf );
+				memcpy( elem, *pp, elem_len );
+				elem[elem_len] = 0;
+				*pp += elem_len;
+
+				rb_ary_push( array, dec_func(this->elem, elem, elem_len, tuple, field, enc_idx) );
+			}
+		}
+	}
+	return array;
+}
+
+/*
+ * Document-class: PG::BinaryDecoder::Array < PG::CompositeDecoder
+ *
+ * This is a decoder class for PostgreSQL arrays in binary format.
+ *
+ * The elements are decoded by the binary decoder of #elements_type .
+ * Multi dimensional arrays are returned as nested Ruby Arrays. The lower
+ * bounds of the dimensions are not retained, so that all arrays start at
+ * index 0 like in Ruby, which is the same behavior as PG::TextDecoder::Array .
+ *
+ */
+static VALUE
+pg_bin_dec_array(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	t_pg_composite_coder *this = (t_pg_composite_coder *)conv;
+	t_pg_coder_dec_func dec_func = pg_coder_dec_func(this->elem, 1);
+	const char *p = val, *end = val + len;
+	int dims[ARRAY_MAXDIM];
+	int ndim, i;
+	int64_t nitems = 1;
+	VALUE buf, array;
+
+	/* Header: number of dimensions, flags (has NULLs) and element type OID */
+	if( len < 12 ) pg_bin_dec_array_raise( tuple, field, "data too short" );
+	ndim = read_nbo32( p );
+	p += 12;
+	if( ndim < 0 || ndim > ARRAY_MAXDIM ) pg_bin_dec_array_raise( tuple, field, "invalid number of dimensions" );
+	if( ndim == 0 ) return rb_ary_new();
+
+	/* Size and lower bound of each dimension */
+	if( end - p < ndim * 8 ) pg_bin_dec_array_raise( tuple, field, "data too short" );
+	for( i = 0; i < ndim; i++ ){
+		dims[i] = read_nbo32( p );
+		p += 8;
+		if( dims[i] < 0 ) pg_bin_dec_array_raise( tuple, field, "invalid dimension size" );
+		nitems *= dims[i];
+		/* Every element has at least its length field */
+		if( nitems * 4 > end - p ) pg_bin_dec_array_raise( tuple, field, "data too short" );
+	}
+
+	buf = rb_str_buf_new( 32 );
+	array = read_bin_array( this, &p, end, dims, ndim, buf, tuple, field, enc_idx, dec_func );
+	if( p != end ) pg_bin_dec_array_raise( tuple, field, "trailing data" );
+
+	RB_GC_GUARD( buf );
+	return array;
+}
+
 /*
  * Document-class: PG::BinaryDecoder::ToBase64 < PG::CompositeDecoder
  *
@@ -142,6 +466,10 @@ pg_bin_dec_to_base64(t_pg_coder *conv, char *val, int len, int tuple, int field,
 void
 init_pg_binary_decoder()
 {
+	s_id_months = rb_intern("months");
+	s_id_days = rb_intern("days");
+	s_id_microseconds = rb_intern("microseconds");
+
 	/* This module encapsulates all decoder classes with binary input format */
 	rb_mPG_BinaryDecoder = rb_define_module_under( rb_mPG, "BinaryDecoder" );
 
@@ -152,10 +480,23 @@ init_pg_binary_decoder()
 	pg_define_coder( "Integer", pg_bin_dec_integer, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
 	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "Float", rb_cPG_SimpleDecoder ); */
 	pg_define_coder( "Float", pg_bin_dec_float, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "Numeric", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "Numeric", pg_bin_dec_numeric, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
 	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "String", rb_cPG_SimpleDecoder ); */
 	pg_define_coder( "String", pg_text_dec_string, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
 	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "Bytea", rb_cPG_SimpleDecoder ); */
 	pg_define_coder( "Bytea", pg_bin_dec_bytea, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "TimestampWithoutTimeZone", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "TimestampWithoutTimeZone", pg_bin_dec_timestamp, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "TimestampWithTimeZone", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "TimestampWithTimeZone", pg_bin_dec_timestamptz, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "Date", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "Date", pg_bin_dec_date, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "Interval", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "Interval", pg_bin_dec_interval, rb_cPG_SimpleDecoder, rb_mPG_BinaryDecoder );
+
+	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "Array", rb_cPG_CompositeDecoder ); */
+	pg_define_coder( "Array", pg_bin_dec_array, rb_cPG_CompositeDecoder, rb_mPG_BinaryDecoder );
 
 	/* dummy = rb_define_class_under( rb_mPG_BinaryDecoder, "ToBase64", rb_cPG_CompositeDecoder ); */
 	pg_define_coder( "ToBase64", pg_bin_dec_to_base64, rb_cPG_CompositeDecoder, rb_mPG_BinaryDecoder );
@@ -9,8 +9,13 @@
 #ifdef HAVE_INTTYPES_H
 #include <inttypes.h>
 #endif
+#include <math.h>
 
 VALUE rb_mPG_BinaryEncoder;
+static ID s_id_to_time;
+static ID s_id_months;
+static ID s_id_days;
+static ID s_id_microseconds;
 
 
 /*
@@ -92,6 +97,294 @@ pg_bin_enc_int8(t_pg_coder *conv, VALUE value, char *out, VALUE *intermediate, i
 	return 8;
 }
 
+/*
+ * Document-class: PG::BinaryEncoder::Numeric < PG::SimpleEncoder
+ *
+ * This is the encoder class for the PostgreSQL numeric type.
+ *
+ * It accepts BigDecimal, Integer and Float values as well as Strings
+ * with a decimal number. The value is converted per +to_s+ , so that
+ * NaN and Infinity are supported as well.
+ *
+ */
+static int
+pg_bin_enc_numeric(t_pg_coder *conv, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	if(out){
+		return pg_numeric_str_to_bin( RSTRING_PTR(*intermediate), (int)RSTRING_LEN(*intermediate), out );
+	}else{
+		int len;
+
+		*intermediate = rb_obj_as_string( value );
+		len = pg_numeric_str_to_bin( RSTRING_PTR(*intermediate), (int)RSTRING_LEN(*intermediate), NULL );
+		if( len < 0 ){
+			rb_raise( rb_eArgError, "invalid value for binary numeric converter: %s", StringValueCStr(*intermediate) );
+		}
+		return len;
+	}
+}
+
+/*
+ * Microseconds since 2000-01-01 of a Time object (or of +value.to_time+ ).
+ * With +wall_clock+ the time is taken in the UTC offset of the Time object.
+ */
+static int64_t
+pg_bin_enc_time_usec( VALUE value, int wall_clock )
+{
+	struct timespec ts;
+	int64_t sec;
+
+	if( !rb_obj_is_kind_of(value, rb_cTime) )
+		value = rb_funcall( value, s_id_to_time, 0 );
+	ts = rb_time_timespec( value );
+	sec = (int64_t)ts.tv_sec - POSTGRES_EPOCH_USEC / 1000000;
+	if( wall_clock )
+		sec += NUM2INT( rb_time_utc_offset(value) );
+	if( sec > INT64_MAX / 1000000 - 1 || sec < INT64_MIN / 1000000 + 1 )
+		rb_raise( rb_eRangeError, "time out of range for binary timestamp converter" );
+	/* PostgreSQL rounds to microseconds as well */
+	return sec * 1000000 + (ts.tv_nsec + 500) / 1000;
+}
+
+static int
+pg_bin_enc_timestamp_any(VALUE value, char *out, VALUE *intermediate, int wall_clock)
+{
+	if(out){
+		write_nbo64(NUM2LL(*intermediate), out);
+	}else if( TYPE(value) == T_FLOAT && isinf(RFLOAT_VALUE(value)) ){
+		*intermediate = LL2NUM( RFLOAT_VALUE(value) > 0 ? INT64_MAX : INT64_MIN );
+	}else if( rb_obj_is_kind_of(value, rb_cInteger) ){
+		/* Microseconds since 1970-01-01 */
+		*intermediate = rb_funcall( value, '-', 1, LL2NUM(POSTGRES_EPOCH_USEC) );
+		NUM2LL( *intermediate );
+	}else{
+		*intermediate = LL2NUM( pg_bin_enc_time_usec(value, wall_clock) );
+	}
+	return 8;
+}
+
+/*
+ * Document-class: PG::BinaryEncoder::TimestampWithoutTimeZone < PG::SimpleEncoder
+ *
+ * This is the encoder class for the PostgreSQL timestamp type.
+ *
+ * Time objects are encoded as wall clock time in their UTC offset. Integer
+ * values are taken as microseconds since 1970-01-01 00:00:00, like they are
+ * decoded by PG::BinaryDecoder::TimestampWithoutTimeZone with PG::Coder::TIME_RAW .
+ * Float::INFINITY and -Float::INFINITY are encoded as +infinity+ and
+ * +-infinity+ . Other objects are expected to have method +to_time+ defined.
+ *
+ */
+static int
+pg_bin_enc_timestamp(t_pg_coder *conv, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	return pg_bin_enc_timestamp_any(value, out, intermediate, 1);
+}
+
+/*
+ * Document-class: PG::BinaryEncoder::TimestampWithTimeZone < PG::SimpleEncoder
+ *
+ * This is the encoder class for the PostgreSQL timestamptz type.
+ *
+ * Time objects are encoded as the point in time they represent. Integer
+ * values are taken as microseconds since 1970-01-01 00:00:00 UTC, like they are
+ * decoded by PG::BinaryDecoder::TimestampWithTimeZone with PG::Coder::TIME_RAW .
+ * Float::INFINITY and -Float::INFINITY are encoded as +infinity+ and
+ * +-infinity+ . Other objects are expected to have method +to_time+ defined.
+ *
+ */
+static int
+pg_bin_enc_timestamptz(t_pg_coder *conv, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	return pg_bin_enc_timestamp_any(value, out, intermediate, 0);
+}
+
+/*
+ * Document-class: PG::BinaryEncoder::Date < PG::SimpleEncoder
+ *
+ * This is the encoder class for the PostgreSQL date type.
+ *
+ * Date objects are encoded with their year, month and day, like
+ * PG::TextEncoder::Date does. Time objects
+ * are encoded as the date in their UTC offset. Integer values are taken as
+ * days since 1970-01-01, like they are decoded by PG::BinaryDecoder::Date with
+ * PG::Coder::TIME_RAW . Float::INFINITY and -Float::INFINITY are encoded as
+ * +infinity+ and +-infinity+ .
+ *
+ */
+static int
+pg_bin_enc_date(t_pg_coder *conv, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	if(out){
+		write_nbo32(NUM2INT(*intermediate), out);
+	}else if( TYPE(value) == T_FLOAT && isinf(RFLOAT_VALUE(value)) ){
+		*intermediate = INT2NUM( RFLOAT_VALUE(value) > 0 ? INT32_MAX : INT32_MIN );
+	}else if( rb_obj_is_kind_of(value, rb_cInteger) ){
+		/* Days since 1970-01-01 */
+		*intermediate = rb_funcall( value, '-', 1, INT2FIX(POSTGRES_EPOCH_DAYS) );
+		NUM2INT( *intermediate );
+	}else if( rb_obj_is_kind_of(value, rb_cTime) ){
+		int64_t usec = pg_bin_enc_time_usec(value, 1);
+		int64_t days = usec / USEC_PER_DAY;
+		if( usec % USEC_PER_DAY < 0 ) days--;
+		*intermediate = LL2NUM( days );
+	}else if( pg_obj_is_date(value) ){
+		/* Days since 2000-01-01 */
+		*intermediate = LL2NUM( pg_date_to_days(value) - POSTGRES_EPOCH_DAYS );
+		NUM2INT( *intermediate );
+	}else{
+		rb_raise( rb_eTypeError, "wrong data for binary date converter: %s", rb_obj_classname(value) );
+	}
+	return 4;
+}
+
+/*
+ * Document-class: PG::BinaryEncoder::Interval < PG::SimpleEncoder
+ *
+ * This is the encoder class for the PostgreSQL interval type.
+ *
+ * It accepts a Hash with the Integer parts of the interval, like
+ * PG::BinaryDecoder::Interval returns it. Missing parts are taken as 0:
+ *
+ *    { months: 14, days: 3, microseconds: 4500000 }  # '1 year 2 mons 3 days 4.5 secs'
+ *
+ * Integer values are taken as microseconds.
+ *
+ */
+static int
+pg_bin_enc_interval(t_pg_coder *conv, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	int64_t usec;
+	int days, months;
+
+	if( TYPE(value) == T_HASH ){
+		usec = NUM2LL( rb_hash_lookup2(value, ID2SYM(s_id_microseconds), INT2FIX(0)) );
+		days = NUM2INT( rb_hash_lookup2(value, ID2SYM(s_id_days), INT2FIX(0)) );
+		months = NUM2INT( rb_hash_lookup2(value, ID2SYM(s_id_months), INT2FIX(0)) );
+	}else if( rb_obj_is_kind_of(value, rb_cInteger) ){
+		usec = NUM2LL( value );
+		days = months = 0;
+	}else{
+		rb_raise( rb_eTypeError, "wrong data for binary interval converter: %s", rb_obj_classname(value) );
+	}
+
+	if(out){
+		write_nbo64(usec, out);
+		write_nbo32(days, out + 8);
+		write_nbo32(months, out + 12);
+	}
+	return 16;
+}
+
+/* Maximum number of array dimensions of PostgreSQL */
+#define ARRAY_MAXDIM 6
+
+static char *
+write_bin_array(t_pg_composite_coder *this, VALUE value, const int *dims, int ndim, VALUE string, char *out, char **p_end, int *p_has_null, int enc_idx, t_pg_coder_enc_func enc_func)
+{
+	int i;
+
+	if( TYPE(value) != T_ARRAY || RARRAY_LEN(value) != dims[0] ){
+		rb_raise( rb_eArgError, "wrong array dimensions: all sub-arrays must have the same size" );
+	}
+
+	for( i = 0; i < dims[0]; i++ ){
+		VALUE entry = rb_ary_entry(value, i);
+
+		if( ndim > 1 ){
+			out = write_bin_array(this, entry, dims + 1, ndim - 1, string, out, p_end, p_has_null, enc_idx, enc_func);
+		}else if( NIL_P(entry) ){
+			PG_RB_STR_ENSURE_CAPA( string, 4, out, *p_end );
+			write_nbo32(-1, out);
+			out += 4;
+			*p_has_null = 1;
+		}else if( TYPE(entry) == T_ARRAY ){
+			rb_raise( rb_eArgError, "wrong array dimensions: all sub-arrays must have the same depth" );
+		}else{
+			VALUE subint;
+			int strlen = enc_func(this->elem, entry, NULL, &subint, enc_idx);
+
+			if( strlen == -1 ){
+				/* we can directly use String value in subint */
+				strlen = (int)RSTRING_LEN(subint);
+				PG_RB_STR_ENSURE_CAPA( string, 4 + strlen, out, *p_end );
+				memcpy( out + 4, RSTRING_PTR(subint), strlen );
+			}else{
+				PG_RB_STR_ENSURE_CAPA( string, 4 + strlen, out, *p_end );
+				strlen = enc_func(this->elem, entry, out + 4, &subint, enc_idx);
+			}
+			write_nbo32(strlen, out);
+			out += 4 + strlen;
+		}
+	}
+	return out;
+}
+
+/*
+ * Document-class: PG::BinaryEncoder::Array < PG::CompositeEncoder
+ *
+ * This is the encoder class for PostgreSQL arrays in binary format.
+ *
+ * The elements are encoded by the binary encoder of #elements_type , whose
+ * PG::Coder#oid is sent as element type. It must therefore match the
+ * element type of the array. Nested Arrays are encoded as multi
+ * dimensional array with all lower bounds set to 1. All sub-arrays of a
+ * dimension must have the same size. +nil+ elements are sent as +NULL+ .
+ *
+ * Values, which are no Arrays, are sent per +to_s+ .
+ *
+ */
+static int
+pg_bin_enc_array(t_pg_coder *conv, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	t_pg_composite_coder *this = (t_pg_composite_coder *)conv;
+
+	if( TYPE(value) == T_ARRAY ){
+		int dims[ARRAY_MAXDIM];
+		int ndim = 0, has_null = 0, i;
+		VALUE entry = value;
+		VALUE out_str;
+		char *current_out, *end_ptr;
+
+		/* The dimensions are given by the first element of each level. */
+		while( TYPE(entry) == T_ARRAY ){
+			if( ndim == ARRAY_MAXDIM ){
+				rb_raise( rb_eArgError, "number of array dimensions exceeds the maximum allowed (%d)", ARRAY_MAXDIM );
+			}
+			dims[ndim++] = (int)RARRAY_LEN(entry);
+			if( RARRAY_LEN(entry) == 0 ){
+				/* Arrays without elements have no dimensions in PostgreSQL. */
+				ndim = 0;
+				break;
+			}
+			entry = rb_ary_entry(entry, 0);
+		}
+
+		PG_RB_STR_NEW( out_str, current_out, end_ptr );
+		PG_RB_STR_ENSURE_CAPA( out_str, 12 + ndim * 8, current_out, end_ptr );
+		write_nbo32(ndim, current_out);
+		write_nbo32(this->elem ? this->elem->oid : 0, current_out + 8);
+		current_out += 12;
+		for( i = 0; i < ndim; i++ ){
+			write_nbo32(dims[i], current_out);
+			write_nbo32(1, current_out + 4);
+			current_out += 8;
+		}
+
+		if( ndim > 0 ){
+			current_out = write_bin_array(this, value, dims, ndim, out_str, current_out, &end_ptr, &has_null, enc_idx, pg_coder_enc_func(this->elem));
+		}
+		/* Set the has-NULLs flag of the header */
+		write_nbo32(has_null, RSTRING_PTR(out_str) + 4);
+
+		rb_str_set_len( out_str, current_out - RSTRING_PTR(out_str) );
+		*intermediate = out_str;
+		return -1;
+	} else {
+		return pg_coder_enc_to_s( conv, value, out, intermediate, enc_idx );
+	}
+}
+
 /*
  * Document-class: PG::BinaryEncoder::FromBase64 < PG::CompositeEncoder
  *
@@ -140,6 +433,11 @@ pg_bin_enc_from_base64(t_pg_coder *conv, VALUE value, char *out, VALUE *intermed
 void
 init_pg_binary_encoder()
 {
+	s_id_to_time = rb_intern("to_time");
+	s_id_months = rb_intern("months");
+	s_id_days = rb_intern("days");
+	s_id_microseconds = rb_intern("microseconds");
+
 	/* This module encapsulates all encoder classes with binary output format */
 	rb_mPG_BinaryEncoder = rb_define_module_under( rb_mPG, "BinaryEncoder" );
 
@@ -152,10 +450,23 @@ init_pg_binary_encoder()
 	pg_define_coder( "Int4", pg_bin_enc_int4, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
 	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "Int8", rb_cPG_SimpleEncoder ); */
 	pg_define_coder( "Int8", pg_bin_enc_int8, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "Numeric", rb_cPG_SimpleEncoder ); */
+	pg_define_coder( "Numeric", pg_bin_enc_numeric, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
 	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "String", rb_cPG_SimpleEncoder ); */
 	pg_define_coder( "String", pg_coder_enc_to_s, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
 	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "Bytea", rb_cPG_SimpleEncoder ); */
 	pg_define_coder( "Bytea", pg_coder_enc_to_s, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "TimestampWithoutTimeZone", rb_cPG_SimpleEncoder ); */
+	pg_define_coder( "TimestampWithoutTimeZone", pg_bin_enc_timestamp, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "TimestampWithTimeZone", rb_cPG_SimpleEncoder ); */
+	pg_define_coder( "TimestampWithTimeZone", pg_bin_enc_timestamptz, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "Date", rb_cPG_SimpleEncoder ); */
+	pg_define_coder( "Date", pg_bin_enc_date, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
+	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "Interval", rb_cPG_SimpleEncoder ); */
+	pg_define_coder( "Interval", pg_bin_enc_interval, rb_cPG_SimpleEncoder, rb_mPG_BinaryEncoder );
+
+	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "Array", rb_cPG_CompositeEncoder ); */
+	pg_define_coder( "Array", pg_bin_enc_array, rb_cPG_CompositeEncoder, rb_mPG_BinaryEncoder );
 
 	/* dummy = rb_define_class_under( rb_mPG_BinaryEncoder, "FromBase64", rb_cPG_CompositeEncoder ); */
 	pg_define_coder( "FromBase64", pg_bin_enc_from_base64, rb_cPG_CompositeEncoder, rb_mPG_BinaryEncoder );
@@ -38,6 +38,9 @@ pg_coder_init_encoder( VALUE self )
 	this->coder_obj = self;
 	this->oid = 0;
 	this->format = 0;
+	this->memo = NULL;
+	this->memo_size = 0;
+	this->flags = 0;
 	rb_iv_set( self, "@name", Qnil );
 }
 
@@ -56,9 +59,117 @@ pg_coder_init_decoder( VALUE self )
 	this->coder_obj = self;
 	this->oid = 0;
 	this->format = 0;
+	this->memo = NULL;
+	this->memo_size = 0;
+	this->flags = 0;
 	rb_iv_set( self, "@name", Qnil );
 }
 
+/*
+ * Key of the memo table: the raw value bytes and the encoding of the output.
+ */
+typedef struct {
+	int enc_idx;
+	long len;
+	const char *ptr;
+} t_pg_coder_memo_key;
+
+static int
+pg_coder_memo_cmp( st_data_t a, st_data_t b )
+{
+	t_pg_coder_memo_key *ka = (t_pg_coder_memo_key *)a;
+	t_pg_coder_memo_key *kb = (t_pg_coder_memo_key *)b;
+
+	return ka->len != kb->len || ka->enc_idx != kb->enc_idx || memcmp(ka->ptr, kb->ptr, ka->len);
+}
+
+static st_index_t
+pg_coder_memo_hash( st_data_t a )
+{
+	t_pg_coder_memo_key *ka = (t_pg_coder_memo_key *)a;
+
+	return rb_memhash(ka->ptr, ka->len) ^ ka->enc_idx;
+}
+
+static const struct st_hash_type pg_coder_memo_type = {
+	pg_coder_memo_cmp,
+	pg_coder_memo_hash,
+};
+
+static int
+pg_coder_memo_mark_i( st_data_t key, st_data_t value, st_data_t arg )
+{
+	rb_gc_mark( (VALUE)value );
+	return ST_CONTINUE;
+}
+
+static int
+pg_coder_memo_free_i( st_data_t key, st_data_t value, st_data_t arg )
+{
+	xfree( (void *)key );
+	return ST_CONTINUE;
+}
+
+static void
+pg_coder_memo_clear( t_pg_coder *this )
+{
+	if( this->memo ){
+		st_foreach( this->memo, pg_coder_memo_free_i, 0 );
+		st_free_table( this->memo );
+		this->memo = NULL;
+	}
+}
+
+static void
+pg_decoder_mark( t_pg_coder *this )
+{
+	if( this->memo )
+		st_foreach( this->memo, pg_coder_memo_mark_i, 0 );
+}
+
+static void
+pg_decoder_free( t_pg_coder *this )
+{
+	pg_coder_memo_clear( this );
+	xfree( this );
+}
+
+/*
+ * Decode a value by the given decoder function and memoize the result.
+ *
+ * Values with equal raw bytes are decoded only once and share the
+ * resulting frozen object. New values are no longer added when the
+ * table reached #memo_size entries.
+ */
+VALUE
+pg_coder_dec_memo( t_pg_coder *this, t_pg_coder_dec_func dec_func, char *val, int len, int tuple, int field, int enc_idx )
+{
+	t_pg_coder_memo_key key;
+	st_data_t cached;
+	VALUE value;
+
+	key.enc_idx = enc_idx;
+	key.len = len;
+	key.ptr = val;
+	if( st_lookup(this->memo, (st_data_t)&key, &cached) )
+		return (VALUE)cached;
+
+	value = dec_func( this, val, len, tuple, field, enc_idx );
+	rb_obj_freeze( value );
+
+	/* The decoder could have disabled memoization in the meantime. */
+	if( this->memo && this->memo->num_entries < (st_index_t)this->memo_size ){
+		t_pg_coder_memo_key *p_key = xmalloc( sizeof(*p_key) + len );
+		memcpy( p_key + 1, val, len );
+		p_key->enc_idx = enc_idx;
+		p_key->len = len;
+		p_key->ptr = (char *)(p_key + 1);
+		st_insert( this->memo, (st_data_t)p_key, (st_data_t)value );
+	}
+
+	return value;
+}
+
 static VALUE
 pg_simple_encoder_allocate( VALUE klass )
 {
@@ -85,7 +196,7 @@ static VALUE
 pg_simple_decoder_allocate( VALUE klass )
 {
 	t_pg_coder *this;
-	VALUE self = Data_Make_Struct( klass, t_pg_coder, NULL, -1, this );
+	VALUE self = Data_Make_Struct( klass, t_pg_coder, pg_decoder_mark, pg_decoder_free, this );
 	pg_coder_init_decoder( self );
 	return self;
 }
@@ -94,7 +205,7 @@ static VALUE
 pg_composite_decoder_allocate( VALUE klass )
 {
 	t_pg_composite_coder *this;
-	VALUE self = Data_Make_Struct( klass, t_pg_composite_coder, NULL, -1, this );
+	VALUE self = Data_Make_Struct( klass, t_pg_composite_coder, pg_decoder_mark, pg_decoder_free, this );
 	pg_coder_init_decoder( self );
 	this->elem = NULL;
 	this->needs_quotation = 1;
@@ -265,6 +376,94 @@ pg_coder_format_get(VALUE self)
 	return INT2NUM(this->format);
 }
 
+/*
+ * call-seq:
+ *    coder.flags = Integer
+ *
+ * Set coder specific bitwise OR-ed flags.
+ *
+ * Supported flags are:
+ * * PG::Coder::TIME_RAW - the binary date, timestamp and interval decoders
+ *   return plain Integer values instead of Date or Time objects.
+ * * PG::Coder::NUMERIC_AS_INTEGER - the numeric decoders return values
+ *   without fractional digits as Integer instead of BigDecimal.
+ * * PG::Coder::NUMERIC_AS_FLOAT - the numeric decoders return Float instead
+ *   of BigDecimal.
+ *
+ * The default is +0+. Assigning flags flushes all memoized values.
+ */
+static VALUE
+pg_coder_flags_set(VALUE self, VALUE flags)
+{
+	t_pg_coder *this = DATA_PTR(self);
+	pg_coder_memo_clear( this );
+	if( this->memo_size > 0 )
+		this->memo = st_init_table( &pg_coder_memo_type );
+	this->flags = NUM2INT(flags);
+	return flags;
+}
+
+/*
+ * call-seq:
+ *    coder.flags -> Integer
+ *
+ * Get current bitwise OR-ed coder flags.
+ */
+static VALUE
+pg_coder_flags_get(VALUE self)
+{
+	t_pg_coder *this = DATA_PTR(self);
+	return INT2NUM(this->flags);
+}
+
+/*
+ * call-seq:
+ *    decoder.memo_size = Integer
+ *
+ * Enables memoization of decoded values for up to +memo_size+ distinct values.
+ *
+ * When enabled, equal raw values received from the server are decoded only once.
+ * All further occurrences share the same frozen Ruby object. This saves
+ * allocations and decode time on columns with a small number of distinct
+ * values, like status or country codes.
+ *
+ * Memoization is applied to result values retrieved through PG::TypeMapByColumn
+ * and PG::TypeMapByOid. The table is kept across results, so a decoder
+ * shouldn't be memoized if its output depends on anything else than the raw value.
+ *
+ * The default is +0+, which disables memoization. Assigning a new size
+ * flushes all memoized values.
+ */
+static VALUE
+pg_coder_memo_size_set(VALUE self, VALUE memo_size)
+{
+	t_pg_coder *this = DATA_PTR(self);
+	int size = NUM2INT(memo_size);
+
+	if( size < 0 )
+		rb_raise( rb_eArgError, "memo_size must be positive or 0");
+
+	pg_coder_memo_clear( this );
+	this->memo_size = size;
+	if( size > 0 )
+		this->memo = st_init_table( &pg_coder_memo_type );
+
+	return memo_size;
+}
+
+/*
+ * call-seq:
+ *    decoder.memo_size -> Integer
+ *
+ * The maximum number of memoized values. +0+ if memoization is disabled.
+ */
+static VALUE
+pg_coder_memo_size_get(VALUE self)
+{
+	t_pg_coder *this = DATA_PTR(self);
+	return INT2NUM(this->memo_size);
+}
+
 /*
  * call-seq:
  *    coder.needs_quotation = Boolean
@@ -457,6 +656,14 @@ init_pg_coder()
 	rb_define_method( rb_cPG_Coder, "oid", pg_coder_oid_get, 0 );
 	rb_define_method( rb_cPG_Coder, "format=", pg_coder_format_set, 1 );
 	rb_define_method( rb_cPG_Coder, "format", pg_coder_format_get, 0 );
+	rb_define_method( rb_cPG_Coder, "flags=", pg_coder_flags_set, 1 );
+	rb_define_method( rb_cPG_Coder, "flags", pg_coder_flags_get, 0 );
+	/* Decode date, timestamp and interval values as Integer, see PG::Coder#flags= */
+	rb_define_const( rb_cPG_Coder, "TIME_RAW", INT2NUM(PG_CODER_TIME_RAW) );
+	/* Decode numeric values without fractional digits as Integer, see PG::Coder#flags= */
+	rb_define_const( rb_cPG_Coder, "NUMERIC_AS_INTEGER", INT2NUM(PG_CODER_NUMERIC_AS_INTEGER) );
+	/* Decode numeric values as Float, see PG::Coder#flags= */
+	rb_define_const( rb_cPG_Coder, "NUMERIC_AS_FLOAT", INT2NUM(PG_CODER_NUMERIC_AS_FLOAT) );
 	/*
 	 * Name of the coder or the corresponding data type.
 	 *
@@ -475,6 +682,8 @@ init_pg_coder()
 	/* Document-class: PG::SimpleDecoder < PG::SimpleCoder */
 	rb_cPG_SimpleDecoder = rb_define_class_under( rb_mPG, "SimpleDecoder", rb_cPG_SimpleCoder );
 	rb_define_alloc_func( rb_cPG_SimpleDecoder, pg_simple_decoder_allocate );
+	rb_define_method( rb_cPG_SimpleDecoder, "memo_size=", pg_coder_memo_size_set, 1 );
+	rb_define_method( rb_cPG_SimpleDecoder, "memo_size", pg_coder_memo_size_get, 0 );
 
 	/* Document-class: PG::CompositeCoder < PG::Coder
 	 *
@@ -495,6 +704,8 @@ init_pg_coder()
 	/* Document-class: PG::CompositeDecoder < PG::CompositeCoder */
 	rb_cPG_CompositeDecoder = rb_define_class_under( rb_mPG, "CompositeDecoder", rb_cPG_CompositeCoder );
 	rb_define_alloc_func( rb_cPG_CompositeDecoder, pg_composite_decoder_allocate );
+	rb_define_method( rb_cPG_CompositeDecoder, "memo_size=", pg_coder_memo_size_set, 1 );
+	rb_define_method( rb_cPG_CompositeDecoder, "memo_size", pg_coder_memo_size_get, 0 );
 
 	rb_mPG_BinaryFormatting = rb_define_module_under( rb_cPG_Coder, "BinaryFormatting");
 }
@@ -0,0 +1,590 @@
+/*
+ * pg_column_pack.c - PG::Result::PackedColumn class extension
+ * $Id$
+ *
+ */
+
+#include "pg.h"
+#include "util.h"
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+#	include "ruby/memory_view.h"
+#endif
+
+/********************************************************************
+ *
+ * Document-class: PG::Result::PackedColumn
+ *
+ * The values of one result column as packed native numbers.
+ * An instance of this class is created by PG::Result#column_pack .
+ *
+ * #data is a binary String of the values in native byte order, like
+ * Array#pack would produce it with the format of #format .
+ * NULL values are stored as 0 and are flagged in #null_bitmap .
+ *
+ * On Ruby-3.0+ the data is exported per MemoryView API, so that numeric
+ * libraries can access the values without copying:
+ *    col = res.column_pack('price', :float64)
+ *    Fiddle::MemoryView.new(col).format   # => "d"
+ */
+
+VALUE rb_cPG_PackedColumn;
+
+static ID s_id_int16;
+static ID s_id_int32;
+static ID s_id_int64;
+static ID s_id_float32;
+static ID s_id_float64;
+static ID s_id_timestamp;
+
+typedef enum {
+	PACK_INT16,
+	PACK_INT32,
+	PACK_INT64,
+	PACK_FLOAT32,
+	PACK_FLOAT64,
+	PACK_TIMESTAMP
+} t_pack_type;
+
+static const struct {
+	const char *name;
+	const char *format;
+	int size;
+} pack_types[] = {
+	{ "int16", "s", 2 },
+	{ "int32", "l", 4 },
+	{ "int64", "q", 8 },
+	{ "float32", "f", 4 },
+	{ "float64", "d", 8 },
+	{ "timestamp", "q", 8 },
+};
+
+typedef struct {
+	/* Binary String with the packed values */
+	VALUE data;
+	/* Binary String with one bit per value, which is set for NULL values */
+	VALUE null_bitmap;
+	VALUE type;
+	t_pack_type pack_type;
+	long length;
+	long null_count;
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+	ssize_t shape[1];
+	ssize_t strides[1];
+#endif
+} t_pg_packed_column;
+
+static void
+pg_packed_column_gc_mark( t_pg_packed_column *this )
+{
+	rb_gc_mark( this->data );
+	rb_gc_mark( this->null_bitmap );
+	rb_gc_mark( this->type );
+}
+
+static VALUE
+pg_packed_column_s_allocate( VALUE klass )
+{
+	t_pg_packed_column *this;
+	VALUE self = Data_Make_Struct( klass, t_pg_packed_column, pg_packed_column_gc_mark, RUBY_DEFAULT_FREE, this );
+
+	this->data = Qnil;
+	this->null_bitmap = Qnil;
+	this->type = Qnil;
+
+	return self;
+}
+
+static t_pg_packed_column *
+pg_packed_column_get_this( VALUE self )
+{
+	t_pg_packed_column *this;
+	Data_Get_Struct( self, t_pg_packed_column, this );
+
+	if( NIL_P(this->data) )
+		rb_raise( rb_eTypeError, "packed column is empty" );
+	return this;
+}
+
+
+/*
+ * Parse a decimal integer, which must span the whole value.
+ * Returns 0 on invalid input or overflow.
+ */
+int
+pg_pack_parse_int( const char *val, int64_t *p_value )
+{
+	const char *p = val;
+	uint64_t i = 0;
+	int neg = 0;
+
+	if( *p == '-' ){
+		neg = 1;
+		p++;
+	}
+	if( *p < '0' || *p > '9' )
+		return 0;
+
+	for( ; *p >= '0' && *p <= '9'; p++ ){
+		if( i > (UINT64_C(9223372036854775808) - (*p - '0')) / 10 )
+			return 0;
+		i = i * 10 + (*p - '0');
+	}
+	if( *p != 0 )
+		return 0;
+	if( !neg && i > INT64_MAX )
+		return 0;
+
+	*p_value = neg ? (int64_t)(0 - i) : (int64_t)i;
+	return 1;
+}
+
+/*
+ * Parse a date, timestamp or timestamptz in ISO output format to microseconds
+ * since 1970-01-01 UTC. Timestamps without time zone are taken as UTC.
+ */
+int
+pg_pack_parse_timestamp( const char *val, int64_t *p_value )
+{
+	t_pg_iso_timestamp ts;
+
+	if( !pg_parse_iso_timestamp(val, &ts) )
+		return 0;
+	if( ts.infinity ){
+		*p_value = ts.infinity > 0 ? INT64_MAX : INT64_MIN;
+		return 1;
+	}
+
+	*p_value = (pg_days_from_civil(ts.year, ts.mon, ts.day) * 86400 + ts.hour * 3600 + ts.min * 60 + ts.sec - ts.tz_offset) *
+			INT64_C(1000000) + ts.nsec / 1000;
+	return 1;
+}
+
+static void
+pack_raise_invalid( t_pack_type pack_type, const char *val, int row )
+{
+	rb_raise( rb_eArgError, "invalid value for %s at row %d: %s",
+			pack_type == PACK_TIMESTAMP ? "timestamp" : pack_type >= PACK_FLOAT32 ? "float" : "integer",
+			row, val );
+}
+
+static void
+pack_raise_range( int64_t i, int row )
+{
+	rb_raise( rb_eRangeError, "value %lld at row %d is out of range", (long long)i, row );
+}
+
+/*
+ * Retrieve a value of a binary integer, date or timestamp column as int64.
+ * Returns 0 for unsupported lengths.
+ */
+int
+pg_pack_read_binary_int( const char *val, int len, int timestamp, int64_t *p_int )
+{
+	if( timestamp ){
+		if( len == 8 ){
+			int64_t t = read_nbo64( val );
+			*p_int = t == INT64_MAX || t == INT64_MIN ? t : t + POSTGRES_EPOCH_USEC;
+			return 1;
+		} else if( len == 4 ){
+			int32_t d = read_nbo32( val );
+			*p_int = d == INT32_MAX ? INT64_MAX : d == INT32_MIN ? INT64_MIN : d * USEC_PER_DAY + POSTGRES_EPOCH_USEC;
+			return 1;
+		}
+		return 0;
+	}
+
+	switch( len ){
+		case 2: *p_int = read_nbo16( val ); return 1;
+		case 4: *p_int = read_nbo32( val ); return 1;
+		case 8: *p_int = read_nbo64( val ); return 1;
+	}
+	return 0;
+}
+
+int
+pg_pack_read_binary_float( const char *val, int len, double *p_float )
+{
+	union { float f; int32_t i; } swap4;
+	union { double f; int64_t i; } swap8;
+
+	switch( len ){
+		case 4:
+			swap4.i = read_nbo32( val );
+			*p_float = swap4.f;
+			return 1;
+		case 8:
+			swap8.i = read_nbo64( val );
+			*p_float = swap8.f;
+			return 1;
+	}
+	return 0;
+}
+
+static void
+pack_store_int( char *out, t_pack_type pack_type, int64_t i, int row )
+{
+	switch( pack_type ){
+		case PACK_INT16: {
+			int16_t v = (int16_t)i;
+			if( v != i ) pack_raise_range( i, row );
+			memcpy( out, &v, sizeof(v) );
+			break;
+		}
+		case PACK_INT32: {
+			int32_t v = (int32_t)i;
+			if( v != i ) pack_raise_range( i, row );
+			memcpy( out, &v, sizeof(v) );
+			break;
+		}
+		default:
+			memcpy( out, &i, sizeof(i) );
+	}
+}
+
+static void
+pack_store_float( char *out, t_pack_type pack_type, double d )
+{
+	if( pack_type == PACK_FLOAT32 ){
+		float f = (float)d;
+		memcpy( out, &f, sizeof(f) );
+	} else {
+		memcpy( out, &d, sizeof(d) );
+	}
+}
+
+static t_pack_type
+pack_type_from_sym( VALUE type )
+{
+	ID id = SYMBOL_P(type) ? SYM2ID(type) : rb_intern_str( rb_String(type) );
+
+	if( id == s_id_int16 ) return PACK_INT16;
+	if( id == s_id_int32 ) return PACK_INT32;
+	if( id == s_id_int64 ) return PACK_INT64;
+	if( id == s_id_float32 ) return PACK_FLOAT32;
+	if( id == s_id_float64 ) return PACK_FLOAT64;
+	if( id == s_id_timestamp ) return PACK_TIMESTAMP;
+
+	rb_raise( rb_eArgError, "invalid pack type %s (expected :int16, :int32, :int64, :float32, :float64 or :timestamp)",
+			RSTRING_PTR(rb_inspect(type)) );
+}
+
+/*
+ * Binary values are typed by the column type OID, since values of different
+ * types can have the same length.
+ */
+static void
+pack_check_binary_type( PGresult *pgresult, int col, t_pack_type pack_type )
+{
+	Oid ftype = PQftype( pgresult, col );
+	const char *kind;
+	int ok;
+
+	switch( ftype ){
+		case 20: case 21: case 23:
+			/* Integer columns are accepted for float types as well. */
+			kind = "integer";
+			ok = pack_type != PACK_TIMESTAMP;
+			break;
+		case 700: case 701:
+			kind = "float";
+			ok = pack_type == PACK_FLOAT32 || pack_type == PACK_FLOAT64;
+			break;
+		case 1082: case 1114: case 1184:
+			kind = "date/timestamp";
+			ok = pack_type == PACK_TIMESTAMP;
+			break;
+		default:
+			rb_raise( rb_eArgError, "binary column %s has unsupported type OID %u", PQfname(pgresult, col), (unsigned)ftype );
+	}
+	if( !ok )
+		rb_raise( rb_eArgError, "binary %s column %s can not be packed as %s", kind, PQfname(pgresult, col), pack_types[pack_type].name );
+}
+
+/*
+ * call-seq:
+ *    res.column_pack( field, type ) -> PG::Result::PackedColumn
+ *
+ * Parse the values of column +field+ into a packed binary String.
+ * +field+ can be given as column number or field name.
+ *
+ * +type+ is one of:
+ * * +:int16+ , +:int32+ , +:int64+ - native signed integers, which are parsed
+ *   from text or binary integer columns. A RangeError is raised if a value
+ *   exceeds the type.
+ * * +:float32+ , +:float64+ - native floats, which are parsed from text or
+ *   binary float or integer columns.
+ * * +:timestamp+ - int64 microseconds since 1970-01-01 UTC, which are parsed
+ *   from date, timestamp or timestamptz columns. Text values must be in ISO
+ *   DateStyle. Values without time zone are taken as UTC. +infinity+ is
+ *   stored as the maximum and +-infinity+ as the minimum int64 value.
+ *
+ * The values are parsed directly from the PGresult without building Ruby
+ * objects and without applying the type map of the result.
+ * An ArgumentError is raised for values, which can not be parsed.
+ * Columns in binary format must be of type int2, int4, int8, float4, float8,
+ * date, timestamp or timestamptz matching +type+ .
+ *
+ *    res = conn.exec("SELECT generate_series(1, 3) AS n")
+ *    col = res.column_pack('n', :int32)
+ *    col.data.unpack('l*')   # => [1, 2, 3]
+ */
+static VALUE
+pgresult_column_pack( VALUE self, VALUE field, VALUE type )
+{
+	PGresult *pgresult = pgresult_get( self );
+	int col = pg_result_field_number( self, field );
+	t_pack_type pack_type = pack_type_from_sym( type );
+	int size = pack_types[pack_type].size;
+	int is_float = pack_type == PACK_FLOAT32 || pack_type == PACK_FLOAT64;
+	int is_timestamp = pack_type == PACK_TIMESTAMP;
+	int binary = PQfformat( pgresult, col );
+	int ntuples = PQntuples( pgresult );
+	VALUE packed = pg_packed_column_s_allocate( rb_cPG_PackedColumn );
+	t_pg_packed_column *this = DATA_PTR( packed );
+	VALUE data = rb_str_new( NULL, (long)ntuples * size );
+	VALUE null_bitmap = rb_str_new( NULL, (ntuples + 7) / 8 );
+	char *p_data = RSTRING_PTR( data );
+	unsigned char *p_nulls = (unsigned char *)RSTRING_PTR( null_bitmap );
+	long null_count = 0;
+	int float_column = binary && (PQftype(pgresult, col) == 700 || PQftype(pgresult, col) == 701);
+	int row;
+
+	if( binary )
+		pack_check_binary_type( pgresult, col, pack_type );
+	memset( p_nulls, 0, RSTRING_LEN(null_bitmap) );
+
+	for( row = 0; row < ntuples; row++ ){
+		char *out = p_data + (long)row * size;
+		char *val;
+		int len;
+		int64_t i;
+		double d;
+
+		if( PQgetisnull(pgresult, row, col) ){
+			memset( out, 0, size );
+			p_nulls[row / 8] |= 1 << (row % 8);
+			null_count++;
+			continue;
+		}
+
+		val = PQgetvalue( pgresult, row, col );
+		len = PQgetlength( pgresult, row, col );
+
+		if( binary ){
+			if( float_column ){
+				if( pg_pack_read_binary_float(val, len, &d) ){
+					pack_store_float( out, pack_type, d );
+					continue;
+				}
+			} else if( pg_pack_read_binary_int(val, len, is_timestamp, &i) ){
+				/* Integer columns are accepted for float types as well. */
+				if( is_float )
+					pack_store_float( out, pack_type, (double)i );
+				else
+					pack_store_int( out, pack_type, i, row );
+				continue;
+			}
+			rb_raise( rb_eArgError, "invalid binary value length %d at row %d", len, row );
+		} else if( is_float ){
+			char *end;
+			d = strtod( val, &end );
+			if( end == val || *end != 0 )
+				pack_raise_invalid( pack_type, val, row );
+			pack_store_float( out, pack_type, d );
+		} else if( is_timestamp ){
+			if( !pg_pack_parse_timestamp(val, &i) )
+				pack_raise_invalid( pack_type, val, row );
+			pack_store_int( out, pack_type, i, row );
+		} else {
+			if( !pg_pack_parse_int(val, &i) )
+				pack_raise_invalid( pack_type, val, row );
+			pack_store_int( out, pack_type, i, row );
+		}
+	}
+
+	this->data = rb_obj_freeze( data );
+	this->null_bitmap = rb_obj_freeze( null_bitmap );
+	this->type = ID2SYM( rb_intern(pack_types[pack_type].name) );
+	this->pack_type = pack_type;
+	this->length = ntuples;
+	this->null_count = null_count;
+
+	return packed;
+}
+
+/*
+ * call-seq:
+ *    col.data -> String
+ *
+ * Returns the packed values as frozen binary String in native byte order.
+ */
+static VALUE
+pg_packed_column_data( VALUE self )
+{
+	return pg_packed_column_get_this( self )->data;
+}
+
+/*
+ * call-seq:
+ *    col.null_bitmap -> String
+ *
+ * Returns a frozen binary String with one bit per value.
+ * The bit is set for NULL values. Bits are ordered from the least
+ * significant bit of the first byte on, like String#unpack('b*') returns them.
+ */
+static VALUE
+pg_packed_column_null_bitmap( VALUE self )
+{
+	return pg_packed_column_get_this( self )->null_bitmap;
+}
+
+/*
+ * call-seq:
+ *    col.type -> Symbol
+ *
+ * Returns the type given to PG::Result#column_pack .
+ */
+static VALUE
+pg_packed_column_type( VALUE self )
+{
+	return pg_packed_column_get_this( self )->type;
+}
+
+/*
+ * call-seq:
+ *    col.format -> String
+ *
+ * Returns the Array#pack format of one value.
+ */
+static VALUE
+pg_packed_column_format( VALUE self )
+{
+	return rb_str_new_cstr( pack_types[pg_packed_column_get_this( self )->pack_type].format );
+}
+
+/*
+ * call-seq:
+ *    col.length -> Integer
+ *
+ * Returns the number of values.
+ */
+static VALUE
+pg_packed_column_length( VALUE self )
+{
+	return LONG2NUM( pg_packed_column_get_this( self )->length );
+}
+
+/*
+ * call-seq:
+ *    col.null_count -> Integer
+ *
+ * Returns the number of NULL values.
+ */
+static VALUE
+pg_packed_column_null_count( VALUE self )
+{
+	return LONG2NUM( pg_packed_column_get_this( self )->null_count );
+}
+
+/*
+ * call-seq:
+ *    col[ n ] -> Integer, Float or nil
+ *
+ * Returns the value at index +n+ or +nil+ for NULL values.
+ */
+static VALUE
+pg_packed_column_aref( VALUE self, VALUE index )
+{
+	t_pg_packed_column *this = pg_packed_column_get_this( self );
+	long n = NUM2LONG( index );
+	const char *p;
+
+	if( n < 0 ) n += this->length;
+	if( n < 0 || n >= this->length )
+		return Qnil;
+	if( RSTRING_PTR(this->null_bitmap)[n / 8] & (1 << (n % 8)) )
+		return Qnil;
+
+	p = RSTRING_PTR( this->data ) + n * pack_types[this->pack_type].size;
+	switch( this->pack_type ){
+		case PACK_INT16: { int16_t v; memcpy( &v, p, sizeof(v) ); return INT2NUM( v ); }
+		case PACK_INT32: { int32_t v; memcpy( &v, p, sizeof(v) ); return INT2NUM( v ); }
+		case PACK_FLOAT32: { float v; memcpy( &v, p, sizeof(v) ); return rb_float_new( v ); }
+		case PACK_FLOAT64: { double v; memcpy( &v, p, sizeof(v) ); return rb_float_new( v ); }
+		default: { int64_t v; memcpy( &v, p, sizeof(v) ); return LL2NUM( v ); }
+	}
+}
+
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+static bool
+pg_packed_column_memory_view_get( VALUE self, rb_memory_view_t *view, int flags )
+{
+	t_pg_packed_column *this = pg_packed_column_get_this( self );
+	int size = pack_types[this->pack_type].size;
+
+	if( (flags & RUBY_MEMORY_VIEW_WRITABLE) )
+		return false;
+	if( !rb_memory_view_init_as_byte_array(view, self, RSTRING_PTR(this->data), RSTRING_LEN(this->data), true) )
+		return false;
+
+	this->shape[0] = this->length;
+	this->strides[0] = size;
+	view->format = pack_types[this->pack_type].format;
+	view->item_size = size;
+	view->ndim = 1;
+	view->shape = this->shape;
+	view->strides = this->strides;
+	return true;
+}
+
+static bool
+pg_packed_column_memory_view_release( VALUE self, rb_memory_view_t *view )
+{
+	return true;
+}
+
+static bool
+pg_packed_column_memory_view_available_p( VALUE self )
+{
+	t_pg_packed_column *this;
+	Data_Get_Struct( self, t_pg_packed_column, this );
+	return !NIL_P( this->data );
+}
+
+static const rb_memory_view_entry_t pg_packed_column_memory_view_entry = {
+	pg_packed_column_memory_view_get,
+	pg_packed_column_memory_view_release,
+	pg_packed_column_memory_view_available_p,
+};
+#endif
+
+
+void
+init_pg_column_pack()
+{
+	s_id_int16 = rb_intern("int16");
+	s_id_int32 = rb_intern("int32");
+	s_id_int64 = rb_intern("int64");
+	s_id_float32 = rb_intern("float32");
+	s_id_float64 = rb_intern("float64");
+	s_id_timestamp = rb_intern("timestamp");
+
+	rb_cPG_PackedColumn = rb_define_class_under( rb_cPGresult, "PackedColumn", rb_cObject );
+	rb_define_alloc_func( rb_cPG_PackedColumn, pg_packed_column_s_allocate );
+	rb_undef_method( CLASS_OF(rb_cPG_PackedColumn), "new" );
+
+	rb_define_method( rb_cPG_PackedColumn, "data", pg_packed_column_data, 0 );
+	rb_define_method( rb_cPG_PackedColumn, "null_bitmap", pg_packed_column_null_bitmap, 0 );
+	rb_define_method( rb_cPG_PackedColumn, "type", pg_packed_column_type, 0 );
+	rb_define_method( rb_cPG_PackedColumn, "format", pg_packed_column_format, 0 );
+	rb_define_method( rb_cPG_PackedColumn, "length", pg_packed_column_length, 0 );
+	rb_define_alias( rb_cPG_PackedColumn, "size", "length" );
+	rb_define_method( rb_cPG_PackedColumn, "null_count", pg_packed_column_null_count, 0 );
+	rb_define_method( rb_cPG_PackedColumn, "[]", pg_packed_column_aref, 1 );
+
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+	rb_memory_view_register( rb_cPG_PackedColumn, &pg_packed_column_memory_view_entry );
+#endif
+
+	rb_define_method( rb_cPGresult, "column_pack", pgresult_column_pack, 2 );
+}
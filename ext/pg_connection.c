@@ -209,6 +209,9 @@ pgconn_s_allocate( VALUE klass )
 	this->decoder_for_get_copy_data = Qnil;
 	this->trace_stream = Qnil;
 	this->external_encoding = Qnil;
+	this->flags = 0;
+	this->max_result_rows = 0;
+	this->max_result_bytes = 0;
 
 	return self;
 }
@@ -925,7 +928,38 @@ pgconn_connection_used_password(VALUE self)
 /* :TODO: get_ssl */
 
 
-static VALUE pgconn_exec_params( int, VALUE *, VALUE );
+static VALUE pgconn_sync_exec_params( int, VALUE *, VALUE );
+static int pgconn_result_limits_get( VALUE, int *, VALUE *, t_pg_result_limits * );
+static VALUE pgconn_exec_limited( VALUE, VALUE (*)(int, VALUE *, VALUE), int, VALUE *, t_pg_result_limits * );
+static VALUE pgconn_send_query( int, VALUE *, VALUE );
+static VALUE pgconn_send_query_prepared( int, VALUE *, VALUE );
+
+static VALUE
+pgconn_sync_exec(int argc, VALUE *argv, VALUE self)
+{
+	PGconn *conn = pg_get_pgconn(self);
+	PGresult *result = NULL;
+	VALUE rb_pgresult;
+
+	/* If called with no parameters, use PQexec */
+	if ( argc == 1 ) {
+		VALUE query_str = argv[0];
+
+		result = gvl_PQexec(conn, pg_cstr_enc(query_str, ENCODING_GET(self)));
+		rb_pgresult = pg_new_result(result, self);
+		pg_result_check(rb_pgresult);
+		if (rb_block_given_p()) {
+			return rb_ensure(rb_yield, rb_pgresult, pg_result_clear, rb_pgresult);
+		}
+		return rb_pgresult;
+	}
+
+	/* Otherwise, just call #exec_params instead for backward-compatibility */
+	else {
+		return pgconn_sync_exec_params( argc, argv, self );
+	}
+
+}
 
 /*
  * call-seq:
@@ -950,32 +984,26 @@ static VALUE pgconn_exec_params( int, VALUE *, VALUE );
  * the query is finished. This is most notably visible by a delayed reaction to Control+C.
  * Both methods ensure that other threads can process while waiting for the server to
  * complete the request.
+ *
+ * The size of the result can be limited by the options +max_result_rows+ and
+ * +max_result_bytes+ given as trailing Hash. They overwrite the defaults
+ * set by #max_result_rows= and #max_result_bytes= for this call.
+ * If a limit is set, the rows are received in chunked rows mode, so that an
+ * oversized result is detected while it is transferred. The query is
+ * cancelled and PG::ResultTooLarge is raised when a limit is exceeded.
+ * The same options are accepted by #exec_params, #exec_prepared and #async_exec .
+ *
+ *   conn.exec( "SELECT * FROM big_table", max_result_rows: 10000 )
  */
 static VALUE
 pgconn_exec(int argc, VALUE *argv, VALUE self)
 {
-	PGconn *conn = pg_get_pgconn(self);
-	PGresult *result = NULL;
-	VALUE rb_pgresult;
+	t_pg_result_limits limits;
 
-	/* If called with no parameters, use PQexec */
-	if ( argc == 1 ) {
-		VALUE query_str = argv[0];
-
-		result = gvl_PQexec(conn, pg_cstr_enc(query_str, ENCODING_GET(self)));
-		rb_pgresult = pg_new_result(result, self);
-		pg_result_check(rb_pgresult);
-		if (rb_block_given_p()) {
-			return rb_ensure(rb_yield, rb_pgresult, pg_result_clear, rb_pgresult);
-		}
-		return rb_pgresult;
-	}
-
-	/* Otherwise, just call #exec_params instead for backward-compatibility */
-	else {
-		return pgconn_exec_params( argc, argv, self );
-	}
+	if( pgconn_result_limits_get(self, &argc, argv, &limits) )
+		return pgconn_exec_limited( self, pgconn_send_query, argc, argv, &limits );
 
+	return pgconn_sync_exec( argc, argv, self );
 }
 
 
@@ -1268,6 +1296,17 @@ pgconn_query_assign_typemap( VALUE self, struct query_params_data *paramsData )
  */
 static VALUE
 pgconn_exec_params( int argc, VALUE *argv, VALUE self )
+{
+	t_pg_result_limits limits;
+
+	if( pgconn_result_limits_get(self, &argc, argv, &limits) )
+		return pgconn_exec_limited( self, pgconn_send_query, argc, argv, &limits );
+
+	return pgconn_sync_exec_params( argc, argv, self );
+}
+
+static VALUE
+pgconn_sync_exec_params( int argc, VALUE *argv, VALUE self )
 {
 	PGconn *conn = pg_get_pgconn(self);
 	PGresult *result = NULL;
@@ -1285,7 +1324,7 @@ pgconn_exec_params( int argc, VALUE *argv, VALUE self )
 	 * for the second parameter.
 	 */
 	if ( NIL_P(paramsData.params) ) {
-		return pgconn_exec( 1, argv, self );
+		return pgconn_sync_exec( 1, argv, self );
 	}
 	pgconn_query_assign_typemap( self, &paramsData );
 
@@ -1412,6 +1451,10 @@ pgconn_exec_prepared(int argc, VALUE *argv, VALUE self)
 	int nParams;
 	int resultFormat;
 	struct query_params_data paramsData = { ENCODING_GET(self) };
+	t_pg_result_limits limits;
+
+	if( pgconn_result_limits_get(self, &argc, argv, &limits) )
+		return pgconn_exec_limited( self, pgconn_send_query_prepared, argc, argv, &limits );
 
 	rb_scan_args(argc, argv, "13", &name, &paramsData.params, &in_res_fmt, &paramsData.typemap);
 	paramsData.with_types = 0;
@@ -1787,6 +1830,57 @@ pgconn_set_single_row_mode(VALUE self)
 
 	return self;
 }
+
+/*
+ * call-seq:
+ *    conn.set_chunked_rows_mode( chunk_size ) -> self
+ *
+ * Select chunked rows mode for the currently executing query.
+ * Call this method immediately after a successful call of send_query
+ * (or a sibling function). Then call Connection#get_result repeatedly,
+ * until it returns nil.
+ *
+ * This is similar to #set_single_row_mode , but each received Result
+ * contains up to +chunk_size+ rows and has a Result#result_status of
+ * PGRES_TUPLES_CHUNK. This amortizes the costs of receiving and wrapping
+ * a dedicated result object for each row.
+ * Result#stream_each and Result#stream_each_row handle both modes.
+ *
+ * Chunked rows mode is available with libpq of PostgreSQL-17 or newer.
+ * With older libpq versions this method falls back to single row mode.
+ * Use the +batch+ option of Result#stream_each and Result#stream_each_row
+ * to have the rows coalesced to batches on the client side in this case.
+ *
+ * Example:
+ *   conn.send_query( "your SQL command" )
+ *   conn.set_chunked_rows_mode( 1000 )
+ *   conn.get_result.stream_each_row( batch: 1000 ) do |rows|
+ *     # do something with up to 1000 received rows
+ *   end
+ */
+static VALUE
+pgconn_set_chunked_rows_mode(VALUE self, VALUE chunk_size)
+{
+	PGconn *conn = pg_get_pgconn(self);
+	int size = NUM2INT(chunk_size);
+	VALUE error;
+
+	if( size < 1 )
+		rb_raise( rb_eArgError, "chunk size must be positive" );
+
+#ifdef HAVE_PQSETCHUNKEDROWSMODE
+	if( PQsetChunkedRowsMode(conn, size) == 0 )
+#else
+	if( PQsetSingleRowMode(conn) == 0 )
+#endif
+	{
+		error = rb_exc_new2(rb_ePGerror, PQerrorMessage(conn));
+		rb_iv_set(error, "@connection", self);
+		rb_exc_raise(error);
+	}
+
+	return self;
+}
 #endif
 
 /*
@@ -3189,6 +3283,10 @@ static VALUE
 pgconn_async_exec(int argc, VALUE *argv, VALUE self)
 {
 	VALUE rb_pgresult = Qnil;
+	t_pg_result_limits limits;
+
+	if( pgconn_result_limits_get(self, &argc, argv, &limits) )
+		return pgconn_exec_limited( self, pgconn_send_query, argc, argv, &limits );
 
 	/* remove any remaining results from the queue */
 	pgconn_block( 0, NULL, self ); /* wait for input (without blocking) before reading the last result */
@@ -3205,6 +3303,268 @@ pgconn_async_exec(int argc, VALUE *argv, VALUE self)
 }
 
 
+/* Maximum number of rows per chunk, which are received while a result limit is active */
+#define RESULT_LIMITS_CHUNK_SIZE 1000
+
+static int64_t
+pgconn_result_limit_value( VALUE value, const char *name )
+{
+	int64_t limit;
+
+	if( NIL_P(value) )
+		return 0;
+	limit = NUM2LL( value );
+	if( limit < 0 )
+		rb_raise( rb_eArgError, "%s must not be negative", name );
+	return limit;
+}
+
+/*
+ * Initialize the limits of a result to be received from the connection defaults.
+ * Returns non-zero if a limit is active.
+ */
+int
+pg_result_limits_init( VALUE self, t_pg_result_limits *limits )
+{
+	t_pg_connection *this = pg_get_connection( self );
+
+	limits->max_rows = this->max_result_rows;
+	limits->max_bytes = this->max_result_bytes;
+	limits->rows = 0;
+	limits->bytes = 0;
+
+	return limits->max_rows || limits->max_bytes;
+}
+
+/*
+ * Initialize the result limits of a query execution. A trailing Hash with
+ * options +max_result_rows+ and +max_result_bytes+ is removed from the
+ * arguments. Returns non-zero if a limit is active.
+ */
+static int
+pgconn_result_limits_get( VALUE self, int *p_argc, VALUE *argv, t_pg_result_limits *limits )
+{
+	pg_result_limits_init( self, limits );
+
+	if( *p_argc > 1 && TYPE(argv[*p_argc - 1]) == T_HASH ){
+		VALUE opts = argv[--*p_argc];
+		VALUE max_rows = rb_hash_lookup2( opts, ID2SYM(rb_intern("max_result_rows")), Qundef );
+		VALUE max_bytes = rb_hash_lookup2( opts, ID2SYM(rb_intern("max_result_bytes")), Qundef );
+		st_index_t nopts = (max_rows != Qundef) + (max_bytes != Qundef);
+
+		if( RHASH_SIZE(opts) != nopts )
+			rb_raise( rb_eArgError, "unknown option in %"PRIsVALUE", only max_result_rows and max_result_bytes are supported", rb_inspect(opts) );
+		if( max_rows != Qundef )
+			limits->max_rows = pgconn_result_limit_value( max_rows, "max_result_rows" );
+		if( max_bytes != Qundef )
+			limits->max_bytes = pgconn_result_limit_value( max_bytes, "max_result_bytes" );
+	}
+
+	return limits->max_rows || limits->max_bytes;
+}
+
+/*
+ * Account the rows of a received result to the limits.
+ *
+ * If a limit is exceeded, the running query is cancelled, all pending results
+ * are discarded and PG::ResultTooLarge is raised.
+ */
+void
+pg_result_limits_account( VALUE self, t_pg_result_limits *limits, PGresult *pgresult )
+{
+	PGconn *conn = pg_get_pgconn( self );
+	const char *name = NULL;
+	int64_t limit = 0;
+	VALUE error;
+
+	limits->rows += PQntuples( pgresult );
+	if( limits->max_rows && limits->rows > limits->max_rows ){
+		name = "max_result_rows";
+		limit = limits->max_rows;
+	} else if( limits->max_bytes ){
+		int ntuples = PQntuples( pgresult );
+		int nfields = PQnfields( pgresult );
+		int row, field;
+
+		for( row = 0; row < ntuples; row++ ){
+			for( field = 0; field < nfields; field++ ){
+				limits->bytes += PQgetlength( pgresult, row, field );
+			}
+		}
+		if( limits->bytes > limits->max_bytes ){
+			name = "max_result_bytes";
+			limit = limits->max_bytes;
+		}
+	}
+	if( !name )
+		return;
+
+#ifdef HAVE_PQGETCANCEL
+	pgconn_cancel( self );
+#endif
+	while( (pgresult = gvl_PQgetResult(conn)) != NULL )
+		PQclear( pgresult );
+
+	error = rb_exc_new3( rb_eResultTooLarge, rb_sprintf("result exceeds %s of %lld", name, (long long)limit) );
+	rb_iv_set( error, "@connection", self );
+	rb_exc_raise( error );
+}
+
+/* Result rows received so far and the chunk currently being appended */
+struct result_join {
+	PGresult *joined;
+	PGresult *chunk;
+};
+
+static void
+clear_result_join( struct result_join *join )
+{
+	if( join->chunk ){
+		PQclear( join->chunk );
+		join->chunk = NULL;
+	}
+	if( join->joined ){
+		PQclear( join->joined );
+		join->joined = NULL;
+	}
+}
+
+static void
+free_result_join( struct result_join *join )
+{
+	clear_result_join( join );
+	xfree( join );
+}
+
+/*
+ * Append the rows of the current chunk to the joined result and clear the
+ * chunk, so that only the compact joined rows are kept while receiving.
+ */
+static void
+pgconn_join_result_chunk( struct result_join *join )
+{
+	PGresult *pgresult = join->chunk;
+	int ntuples = PQntuples( pgresult );
+	int nfields = PQnfields( pgresult );
+	int out_row, row, field;
+
+	if( join->joined == NULL ){
+		join->joined = PQcopyResult( pgresult, PG_COPYRES_ATTRS );
+		if( join->joined == NULL )
+			rb_raise( rb_eNoMemError, "unable to copy PGresult" );
+	}
+	out_row = PQntuples( join->joined );
+
+	for( row = 0; row < ntuples; row++, out_row++ ){
+		for( field = 0; field < nfields; field++ ){
+			int isnull = PQgetisnull( pgresult, row, field );
+
+			if( !PQsetvalue(join->joined, out_row, field, isnull ? NULL : PQgetvalue(pgresult, row, field),
+					isnull ? -1 : PQgetlength(pgresult, row, field)) ){
+				rb_raise( rb_eNoMemError, "unable to store values into PGresult" );
+			}
+		}
+	}
+
+	PQclear( pgresult );
+	join->chunk = NULL;
+}
+
+/*
+ * Execute a query with active result limits.
+ *
+ * The query is sent per +send_func+ and the rows are received in chunked
+ * rows mode. Each chunk is appended to one PG::Result and cleared right away,
+ * as long as the limits are not exceeded.
+ */
+static VALUE
+pgconn_exec_limited( VALUE self, VALUE (*send_func)(int, VALUE *, VALUE), int argc, VALUE *argv, t_pg_result_limits *limits )
+{
+#ifdef HAVE_PQSETSINGLEROWMODE
+	PGconn *conn = pg_get_pgconn( self );
+	struct result_join *join;
+	/* Leave free'ing of the received rows to the GC, if an exception is raised */
+	VALUE join_holder = Data_Make_Struct( rb_cObject, struct result_join, NULL, free_result_join, join );
+	VALUE rb_pgresult = Qnil;
+	PGresult *pgresult;
+	int64_t chunk_size = RESULT_LIMITS_CHUNK_SIZE;
+
+	if( limits->max_rows && limits->max_rows < chunk_size )
+		chunk_size = limits->max_rows + 1;
+
+	/* remove any remaining results from the queue */
+	pgconn_block( 0, NULL, self );
+	pgconn_get_last_result( self );
+
+	send_func( argc, argv, self );
+	pgconn_set_chunked_rows_mode( self, INT2NUM((int)chunk_size) );
+
+	for(;;){
+		int status;
+		VALUE cmd_status = Qnil;
+
+		/* Wait only when the buffered input is exhausted, since PQconsumeInput()
+		 * moves all buffered data on each call. */
+		if( gvl_PQisBusy(conn) )
+			wait_socket_readable( conn, NULL, get_result_readable );
+		pgresult = gvl_PQgetResult( conn );
+		if( pgresult == NULL )
+			break;
+
+		status = PQresultStatus( pgresult );
+		switch( status ){
+			case PGRES_SINGLE_TUPLE:
+#ifdef HAVE_CONST_PGRES_TUPLES_CHUNK
+			case PGRES_TUPLES_CHUNK:
+#endif
+				join->chunk = pgresult;
+				pg_result_limits_account( self, limits, pgresult );
+				pgconn_join_result_chunk( join );
+				continue;
+			case PGRES_TUPLES_OK:
+				if( join->joined ){
+					/* The final result has no rows, but the command status,
+					 * which can't be stored into the joined PGresult. */
+					cmd_status = rb_str_new2( PQcmdStatus(pgresult) );
+					PQclear( pgresult );
+					pgresult = join->joined;
+					join->joined = NULL;
+				}
+				/* Limits apply to each result of a multi-statement query. */
+				limits->rows = 0;
+				limits->bytes = 0;
+				break;
+			default:
+				/* Rows received before an error are discarded. */
+				clear_result_join( join );
+				break;
+		}
+
+		if( !NIL_P(rb_pgresult) )
+			pg_result_clear( rb_pgresult );
+		rb_pgresult = pg_new_result( pgresult, self );
+		if( !NIL_P(cmd_status) )
+			pg_result_set_cmd_status( rb_pgresult, StringValueCStr(cmd_status) );
+
+		if( status == PGRES_COPY_OUT || status == PGRES_COPY_IN )
+			break;
+	}
+
+	RB_GC_GUARD( join_holder );
+
+	if( !NIL_P(rb_pgresult) )
+		pg_result_check( rb_pgresult );
+
+	if ( rb_block_given_p() ) {
+		return rb_ensure( rb_yield, rb_pgresult, pg_result_clear, rb_pgresult );
+	}
+	return rb_pgresult;
+#else
+	rb_raise( rb_eNotImpError, "result limits require libpq with single row mode" );
+#endif
+}
+
+
 #ifdef HAVE_PQSSLATTRIBUTE
 /*
  * call-seq:
@@ -3820,6 +4180,125 @@ pgconn_type_map_for_results_get(VALUE self)
 	return this->type_map_for_results;
 }
 
+/*
+ * call-seq:
+ *    conn.field_name_type = Symbol
+ *
+ * Set default type of field names of results retrieved by this connection.
+ * It can be set to one of:
+ * * +:string+ to use String based field names
+ * * +:symbol+ to use Symbol based field names
+ * * +:static_symbol+ to use static Symbol based field names
+ *
+ * The default is +:string+ .
+ *
+ * Field names of type +:string+ are interned, so that all results with the
+ * same column names share the same frozen String objects.
+ * Symbol based field names are faster to look up in Hashes, but
+ * +:static_symbol+ names are never garbage collected, so they should
+ * only be used with a limited set of column names.
+ *
+ * Settings the type of field names affects all value retrieving methods
+ * of results created after the assignment. See also PG::Result#field_name_type= .
+ *
+ */
+static VALUE
+pgconn_field_name_type_set(VALUE self, VALUE sym)
+{
+	t_pg_connection *this = pg_get_connection( self );
+
+	this->flags &= ~PG_RESULT_FIELD_NAMES_MASK;
+	this->flags |= pg_result_field_name_type_flags( sym );
+
+	return sym;
+}
+
+/*
+ * call-seq:
+ *    conn.field_name_type -> Symbol
+ *
+ * Get type of field names.
+ *
+ * See description at #field_name_type=
+ */
+static VALUE
+pgconn_field_name_type_get(VALUE self)
+{
+	t_pg_connection *this = pg_get_connection( self );
+
+	return pg_result_field_name_type_sym( this->flags );
+}
+
+/*
+ * call-seq:
+ *    conn.max_result_rows = Integer
+ *
+ * Set the maximum number of rows of results received by this connection.
+ * +nil+ or +0+ disables the limit, which is the default.
+ *
+ * The limit is enforced while the rows are received: #exec, #exec_params,
+ * #exec_prepared and #async_exec switch to chunked rows mode internally, and
+ * Result#stream_each and its siblings count the rows of each received chunk.
+ * If the limit is exceeded, the query is cancelled and PG::ResultTooLarge
+ * is raised, before the whole result is buffered by libpq.
+ *
+ * See also #max_result_bytes= .
+ */
+static VALUE
+pgconn_max_result_rows_set(VALUE self, VALUE limit)
+{
+	t_pg_connection *this = pg_get_connection( self );
+
+	this->max_result_rows = pgconn_result_limit_value( limit, "max_result_rows" );
+	return limit;
+}
+
+/*
+ * call-seq:
+ *    conn.max_result_rows -> Integer or nil
+ *
+ * Returns the maximum number of rows of received results or +nil+ if unlimited.
+ */
+static VALUE
+pgconn_max_result_rows_get(VALUE self)
+{
+	t_pg_connection *this = pg_get_connection( self );
+
+	return this->max_result_rows ? LL2NUM( this->max_result_rows ) : Qnil;
+}
+
+/*
+ * call-seq:
+ *    conn.max_result_bytes = Integer
+ *
+ * Set the maximum number of bytes of all field values of a result received
+ * by this connection. +nil+ or +0+ disables the limit, which is the default.
+ *
+ * The limit is enforced like described at #max_result_rows= .
+ */
+static VALUE
+pgconn_max_result_bytes_set(VALUE self, VALUE limit)
+{
+	t_pg_connection *this = pg_get_connection( self );
+
+	this->max_result_bytes = pgconn_result_limit_value( limit, "max_result_bytes" );
+	return limit;
+}
+
+/*
+ * call-seq:
+ *    conn.max_result_bytes -> Integer or nil
+ *
+ * Returns the maximum number of value bytes of received results or +nil+ if unlimited.
+ */
+static VALUE
+pgconn_max_result_bytes_get(VALUE self)
+{
+	t_pg_connection *this = pg_get_connection( self );
+
+	return this->max_result_bytes ? LL2NUM( this->max_result_bytes ) : Qnil;
+}
+
 
 /*
  * call-seq:
@@ -4010,6 +4489,7 @@ init_pg_connection()
 	rb_define_method(rb_cPGconn, "unescape_bytea", pgconn_s_unescape_bytea, 1);
 #ifdef HAVE_PQSETSINGLEROWMODE
 	rb_define_method(rb_cPGconn, "set_single_row_mode", pgconn_set_single_row_mode, 0);
+	rb_define_method(rb_cPGconn, "set_chunked_rows_mode", pgconn_set_chunked_rows_mode, 1);
 #endif
 
 	/******     PG::Connection INSTANCE METHODS: Asynchronous Command Processing     ******/
@@ -4108,5 +4588,12 @@ init_pg_connection()
 	rb_define_method(rb_cPGconn, "encoder_for_put_copy_data", pgconn_encoder_for_put_copy_data_get, 0);
 	rb_define_method(rb_cPGconn, "decoder_for_get_copy_data=", pgconn_decoder_for_get_copy_data_set, 1);
 	rb_define_method(rb_cPGconn, "decoder_for_get_copy_data", pgconn_decoder_for_get_copy_data_get, 0);
+
+	rb_define_method(rb_cPGconn, "field_name_type=", pgconn_field_name_type_set, 1 );
+	rb_define_method(rb_cPGconn, "field_name_type", pgconn_field_name_type_get, 0 );
+	rb_define_method(rb_cPGconn, "max_result_rows=", pgconn_max_result_rows_set, 1 );
+	rb_define_method(rb_cPGconn, "max_result_rows", pgconn_max_result_rows_get, 0 );
+	rb_define_method(rb_cPGconn, "max_result_bytes=", pgconn_max_result_bytes_set, 1 );
+	rb_define_method(rb_cPGconn, "max_result_bytes", pgconn_max_result_bytes_get, 0 );
 }
 
@@ -13,6 +13,7 @@ VALUE rb_eConnectionBad;
 VALUE rb_eInvalidResultStatus;
 VALUE rb_eNoResultError;
 VALUE rb_eInvalidChangeOfResultFields;
+VALUE rb_eResultTooLarge;
 
 static VALUE
 define_error_class(const char *name, const char *baseclass_code)
@@ -90,6 +91,7 @@ init_pg_errors()
 	rb_eInvalidResultStatus = rb_define_class_under( rb_mPG, "InvalidResultStatus", rb_ePGerror );
 	rb_eNoResultError = rb_define_class_under( rb_mPG, "NoResultError", rb_ePGerror );
 	rb_eInvalidChangeOfResultFields = rb_define_class_under( rb_mPG, "InvalidChangeOfResultFields", rb_ePGerror );
+	rb_eResultTooLarge = rb_define_class_under( rb_mPG, "ResultTooLarge", rb_ePGerror );
 
 	#include "errorcodes.def"
 }
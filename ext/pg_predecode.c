@@ -0,0 +1,308 @@
+/*
+ * pg_predecode.c - Parallel decoding of primitive result columns
+ * $Id$
+ *
+ * Values of integer, float and boolean columns are parsed into C buffers by
+ * several native threads without holding the GVL. Afterwards the values are
+ * boxed into Ruby objects by the calling thread, which is much cheaper than
+ * the parsing itself.
+ */
+
+#include "pg.h"
+#include "util.h"
+#ifdef HAVE_PTHREAD_H
+#	include <pthread.h>
+#endif
+
+/* Don't start threads for less rows than this. */
+#define PREDECODE_MIN_ROWS_PER_THREAD 1000
+
+/* State of each predecoded value */
+#define PREDECODE_NULL 0
+#define PREDECODE_DONE 1
+/* Value must be decoded by the regular decoder function */
+#define PREDECODE_FALLBACK 2
+
+struct pg_predecode {
+	PGresult *pgresult;
+	int ntuples;
+	int ncols;
+	int nthreads;
+	t_pg_predecoded_column cols[0];
+};
+
+typedef struct {
+	struct pg_predecode *this;
+	int row_start;
+	int row_end;
+} t_predecode_job;
+
+
+int
+pg_predecode_kind( t_pg_coder_dec_func dec_func )
+{
+	if( dec_func == pg_text_dec_integer ) return PG_PREDECODE_TEXT_INT;
+	if( dec_func == pg_text_dec_float ) return PG_PREDECODE_TEXT_FLOAT;
+	if( dec_func == pg_text_dec_boolean ) return PG_PREDECODE_TEXT_BOOL;
+	if( dec_func == pg_bin_dec_integer ) return PG_PREDECODE_BIN_INT;
+	if( dec_func == pg_bin_dec_float ) return PG_PREDECODE_BIN_FLOAT;
+	if( dec_func == pg_bin_dec_boolean ) return PG_PREDECODE_BIN_BOOL;
+	return PG_PREDECODE_NONE;
+}
+
+/*
+ * Parse a text integer the same way as pg_text_dec_integer() does.
+ * Returns 0 if the value has to be decoded by the Ruby method.
+ */
+static int
+predecode_text_int( const char *val, int len, int64_t *p_value )
+{
+	int64_t i;
+	char digit = *val;
+	int neg;
+
+	if( len > 18 )
+		return 0;
+
+	if( digit == '-' ){
+		neg = 1;
+		i = 0;
+	} else if( digit >= '0' && digit <= '9' ){
+		neg = 0;
+		i = digit - '0';
+	} else {
+		return 0;
+	}
+
+	while( (digit = *++val) ){
+		if( digit < '0' || digit > '9' )
+			return 0;
+		i = i * 10 + (digit - '0');
+	}
+
+	*p_value = neg ? -i : i;
+	return 1;
+}
+
+static int
+predecode_value( t_pg_predecoded_column *col, const char *val, int len, t_pg_predecoded_value *p_value )
+{
+	union { float f; int32_t i; } swap4;
+	union { double f; int64_t i; } swap8;
+
+	switch( col->kind ){
+		case PG_PREDECODE_TEXT_INT:
+			return predecode_text_int( val, len, &p_value->i );
+		case PG_PREDECODE_TEXT_FLOAT:
+			p_value->d = strtod( val, NULL );
+			return 1;
+		case PG_PREDECODE_TEXT_BOOL:
+			if( len < 1 ) return 0;
+			p_value->i = *val == 't';
+			return 1;
+		case PG_PREDECODE_BIN_INT:
+			switch( len ){
+				case 2: p_value->i = read_nbo16( val ); return 1;
+				case 4: p_value->i = read_nbo32( val ); return 1;
+				case 8: p_value->i = read_nbo64( val ); return 1;
+			}
+			return 0;
+		case PG_PREDECODE_BIN_FLOAT:
+			switch( len ){
+				case 4:
+					swap4.i = read_nbo32( val );
+					p_value->d = swap4.f;
+					return 1;
+				case 8:
+					swap8.i = read_nbo64( val );
+					p_value->d = swap8.f;
+					return 1;
+			}
+			return 0;
+		case PG_PREDECODE_BIN_BOOL:
+			if( len < 1 ) return 0;
+			p_value->i = *val != 0;
+			return 1;
+	}
+	return 0;
+}
+
+static void *
+predecode_rows( void *data )
+{
+	t_predecode_job *job = data;
+	struct pg_predecode *this = job->this;
+	int c, row;
+
+	for( c = 0; c < this->ncols; c++ ){
+		t_pg_predecoded_column *col = &this->cols[c];
+
+		for( row = job->row_start; row < job->row_end; row++ ){
+			if( PQgetisnull(this->pgresult, row, col->field) ){
+				col->states[row] = PREDECODE_NULL;
+			} else if( predecode_value(col, PQgetvalue(this->pgresult, row, col->field),
+						PQgetlength(this->pgresult, row, col->field), &col->values[row]) ){
+				col->states[row] = PREDECODE_DONE;
+			} else {
+				col->states[row] = PREDECODE_FALLBACK;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Split the rows across the threads. This runs without the GVL, so that
+ * no Ruby functions must be called.
+ */
+static void *
+predecode_run( void *data )
+{
+	struct pg_predecode *this = data;
+	int nthreads = this->nthreads;
+	int t;
+	t_predecode_job *jobs = malloc( sizeof(*jobs) * nthreads );
+#ifdef HAVE_PTHREAD_H
+	pthread_t *threads = malloc( sizeof(*threads) * nthreads );
+	char *started = calloc( nthreads, 1 );
+#endif
+
+	for( t = 0; t < nthreads; t++ ){
+		jobs[t].this = this;
+		jobs[t].row_start = (int)((int64_t)this->ntuples * t / nthreads);
+		jobs[t].row_end = (int)((int64_t)this->ntuples * (t + 1) / nthreads);
+	}
+
+#ifdef HAVE_PTHREAD_H
+	if( threads && started ){
+		/* The first job is processed by the calling thread. */
+		for( t = 1; t < nthreads; t++ ){
+			started[t] = pthread_create( &threads[t], NULL, predecode_rows, &jobs[t] ) == 0;
+		}
+		predecode_rows( &jobs[0] );
+		for( t = 1; t < nthreads; t++ ){
+			if( started[t] )
+				pthread_join( threads[t], NULL );
+			else
+				predecode_rows( &jobs[t] );
+		}
+	} else
+#endif
+	{
+		for( t = 0; t < nthreads; t++ ){
+			predecode_rows( &jobs[t] );
+		}
+	}
+
+#ifdef HAVE_PTHREAD_H
+	free( started );
+	free( threads );
+#endif
+	free( jobs );
+	return NULL;
+}
+
+static void
+pg_predecode_free( struct pg_predecode *this )
+{
+	int c;
+
+	for( c = 0; c < this->ncols; c++ ){
+		xfree( this->cols[c].values );
+		xfree( this->cols[c].states );
+	}
+	xfree( this );
+}
+
+/*
+ * Parse the columns +fields+ of +pgresult+ by up to +nthreads+ threads.
+ * +kinds+ are the values of pg_predecode_kind() for each column.
+ * Columns with kind PG_PREDECODE_NONE are skipped.
+ *
+ * Returns NULL, if the result is too small to be processed in parallel.
+ * Otherwise the data is wrapped into a hidden object, which is stored to +p_wrapper+
+ * and which must be kept alive while the data is accessed.
+ */
+struct pg_predecode *
+pg_predecode_columns( PGresult *pgresult, int ncols, const int *fields, const int *kinds, int nthreads, VALUE *p_wrapper )
+{
+	struct pg_predecode *this;
+	int ntuples = PQntuples( pgresult );
+	int c, npre = 0;
+
+	if( nthreads > ntuples / PREDECODE_MIN_ROWS_PER_THREAD )
+		nthreads = ntuples / PREDECODE_MIN_ROWS_PER_THREAD;
+	if( nthreads < 2 )
+		return NULL;
+
+	for( c = 0; c < ncols; c++ ){
+		if( kinds[c] != PG_PREDECODE_NONE ) npre++;
+	}
+	if( npre == 0 )
+		return NULL;
+
+	this = xmalloc( sizeof(*this) + sizeof(*this->cols) * npre );
+	this->pgresult = pgresult;
+	this->ntuples = ntuples;
+	this->nthreads = nthreads;
+	this->ncols = 0;
+	*p_wrapper = Data_Wrap_Struct( 0, NULL, pg_predecode_free, this );
+
+	for( c = 0; c < ncols; c++ ){
+		t_pg_predecoded_column *col;
+		if( kinds[c] == PG_PREDECODE_NONE ) continue;
+
+		col = &this->cols[this->ncols++];
+		col->kind = kinds[c];
+		col->field = fields[c];
+		col->values = NULL;
+		col->states = NULL;
+		col->values = ALLOC_N( t_pg_predecoded_value, ntuples );
+		col->states = ALLOC_N( char, ntuples );
+	}
+
+	rb_thread_call_without_gvl( predecode_run, this, NULL, NULL );
+
+	return this;
+}
+
+/*
+ * Retrieve the predecoded column of field +field+ or NULL if it wasn't predecoded.
+ */
+t_pg_predecoded_column *
+pg_predecoded_column( struct pg_predecode *this, int field )
+{
+	int c;
+
+	if( !this ) return NULL;
+	for( c = 0; c < this->ncols; c++ ){
+		if( this->cols[c].field == field ) return &this->cols[c];
+	}
+	return NULL;
+}
+
+/*
+ * Box a predecoded value into a Ruby object.
+ * Returns Qundef if the value has to be decoded by the regular decoder.
+ */
+VALUE
+pg_predecoded_value( t_pg_predecoded_column *col, int row )
+{
+	switch( col->states[row] ){
+		case PREDECODE_NULL:
+			return Qnil;
+		case PREDECODE_DONE:
+			switch( col->kind ){
+				case PG_PREDECODE_TEXT_INT:
+				case PG_PREDECODE_BIN_INT:
+					return LL2NUM( col->values[row].i );
+				case PG_PREDECODE_TEXT_FLOAT:
+				case PG_PREDECODE_BIN_FLOAT:
+					return rb_float_new( col->values[row].d );
+				default:
+					return col->values[row].i ? Qtrue : Qfalse;
+			}
+		default:
+			return Qundef;
+	}
+}
@@ -9,9 +9,39 @@
 
 VALUE rb_cPGresult;
 
+static VALUE sym_string, sym_symbol, sym_static_symbol;
+static ID s_id_members;
+static ID s_id_keyword_init_p;
+static ID s_id_Data;
+
+/* State of a batch of rows, which is filled by the batch iteration methods. */
+typedef struct {
+	/* Array of rows, which is yielded when full */
+	VALUE batch;
+	long batch_size;
+	/* Number of rows preallocated for a new batch Array */
+	long capa;
+	/* Number of rows stored into the current batch */
+	long num_rows;
+	/* Overwrite the same Arrays on every yield */
+	int reuse;
+} t_pg_row_batch;
+
+/* Sum of the memory of all PGresult objects not yet cleared. */
+static size_t pgresult_live_bytes = 0;
+
+#ifndef HAVE_RB_ENC_INTERNED_STR
+/* Process-wide cache of frozen field name Strings.
+ * It is flushed when it grows beyond PG_FNAME_CACHE_MAX entries.
+ */
+static VALUE s_fname_cache;
+#define PG_FNAME_CACHE_MAX 4096
+#endif
+
 static void pgresult_gc_free( t_pg_result * );
 static VALUE pgresult_type_map_set( VALUE, VALUE );
 static VALUE pgresult_s_allocate( VALUE );
+static t_pg_coder_dec_func pgresult_column_dec_func( t_pg_result *, int, t_pg_coder ** );
 static t_pg_result *pgresult_get_this( VALUE );
 static t_pg_result *pgresult_get_this_safe( VALUE );
 
@@ -21,6 +51,45 @@ static t_pg_result *pgresult_get_this_safe( VALUE );
  * Global functions
  */
 
+/*
+ * Publish the memory of the PGresult to the GC, so that large results
+ * trigger garbage collection in time.
+ */
+static void
+pgresult_track_memory( t_pg_result *this )
+{
+#ifdef HAVE_PQRESULTMEMORYSIZE
+	if( this->pgresult ){
+		this->result_size = PQresultMemorySize(this->pgresult);
+		pgresult_live_bytes += this->result_size;
+#ifdef HAVE_RB_GC_ADJUST_MEMORY_USAGE
+		rb_gc_adjust_memory_usage((ssize_t)this->result_size);
+#endif
+	}
+#endif
+}
+
+/*
+ * Free the PGresult unless it's cleared by libpq and withdraw its memory
+ * from the GC accounting.
+ */
+static void
+pgresult_clear( t_pg_result *this )
+{
+	if( this->busy )
+		rb_raise( rb_ePGerror, "result is in use by a parallel decoding in another thread" );
+	if( this->pgresult && !this->autoclear )
+		PQclear(this->pgresult);
+	this->pgresult = NULL;
+
+	pgresult_live_bytes -= this->result_size;
+#ifdef HAVE_RB_GC_ADJUST_MEMORY_USAGE
+	if( this->result_size )
+		rb_gc_adjust_memory_usage(-(ssize_t)this->result_size);
+#endif
+	this->result_size = 0;
+}
+
 /*
  * Result constructor
  */
@@ -39,21 +108,32 @@ pg_new_result(PGresult *result, VALUE rb_pgconn)
 	this->typemap = pg_typemap_all_strings;
 	this->p_typemap = DATA_PTR( this->typemap );
 	this->autoclear = 0;
+	this->result_size = 0;
+	this->busy = 0;
+	this->flags = 0;
 	this->nfields = -1;
 	this->tuple_hash = Qnil;
+	this->field_map = Qnil;
+	this->cmd_status = Qnil;
 
-	PG_ENCODING_SET_NOCHECK(self, ENCODING_GET(rb_pgconn));
+	/* Results without connection are built by PG::Result.load */
+	PG_ENCODING_SET_NOCHECK(self, NIL_P(rb_pgconn) ? rb_ascii8bit_encindex() : ENCODING_GET(rb_pgconn));
 
-	if( result ){
+	if( result && !NIL_P(rb_pgconn) ){
 		t_pg_connection *p_conn = pg_get_connection(rb_pgconn);
 		VALUE typemap = p_conn->type_map_for_results;
 
 		/* Type check is done when assigned to PG::Connection. */
 		t_typemap *p_typemap = DATA_PTR(typemap);
 
+		this->flags = p_conn->flags;
+
 		this->typemap = p_typemap->funcs.fit_to_result( typemap, self );
 		this->p_typemap = DATA_PTR( this->typemap );
 	}
+	if( result ){
+		pgresult_track_memory( this );
+	}
 
 	return self;
 }
@@ -67,6 +147,17 @@ pg_new_result_autoclear(PGresult *result, VALUE rb_pgconn)
 	return self;
 }
 
+/*
+ * Set the command status of a result, which was joined from chunks
+ * and therefore lacks the status of the final PGresult.
+ */
+void
+pg_result_set_cmd_status(VALUE self, const char *cmd_status)
+{
+	t_pg_result *this = pgresult_get_this(self);
+	this->cmd_status = rb_obj_freeze(rb_str_new2(cmd_status));
+}
+
 /*
  * call-seq:
  *    res.check -> nil
@@ -97,6 +188,9 @@ pg_result_check( VALUE self )
 #endif
 #ifdef HAVE_CONST_PGRES_SINGLE_TUPLE
 		case PGRES_SINGLE_TUPLE:
+#endif
+#ifdef HAVE_CONST_PGRES_TUPLES_CHUNK
+		case PGRES_TUPLES_CHUNK:
 #endif
 		case PGRES_EMPTY_QUERY:
 		case PGRES_COMMAND_OK:
@@ -145,12 +239,42 @@ VALUE
 pg_result_clear(VALUE self)
 {
 	t_pg_result *this = pgresult_get_this(self);
-	if( !this->autoclear )
-		PQclear(pgresult_get(self));
-	this->pgresult = NULL;
+	pgresult_clear( this );
 	return Qnil;
 }
 
+/*
+ * call-seq:
+ *    res.memsize -> Integer
+ *
+ * Returns the number of bytes allocated by libpq for this result.
+ *
+ * This memory is reported to the Ruby garbage collector, so that large
+ * results trigger garbage collection, even if the Ruby objects are small.
+ *
+ * Returns +0+ after #clear and if libpq doesn't provide PQresultMemorySize()
+ * (available since PostgreSQL-12).
+ */
+static VALUE
+pgresult_memsize( VALUE self )
+{
+	t_pg_result *this = pgresult_get_this(self);
+	return SIZET2NUM(this->result_size);
+}
+
+/*
+ * call-seq:
+ *    PG::Result.live_bytes -> Integer
+ *
+ * Returns the number of bytes held by all PG::Result objects of the process,
+ * which are not yet cleared. See #memsize .
+ */
+static VALUE
+pgresult_s_live_bytes( VALUE klass )
+{
+	return SIZET2NUM(pgresult_live_bytes);
+}
+
 /*
  * call-seq:
  *    res.cleared?      -> boolean
@@ -195,6 +319,8 @@ pgresult_gc_mark( t_pg_result *this )
 	rb_gc_mark( this->connection );
 	rb_gc_mark( this->typemap );
 	rb_gc_mark( this->tuple_hash );
+	rb_gc_mark( this->field_map );
+	rb_gc_mark( this->cmd_status );
 
 	for( i=0; i < this->nfields; i++ ){
 		rb_gc_mark( this->fnames[i] );
@@ -208,8 +334,7 @@ static void
 pgresult_gc_free( t_pg_result *this )
 {
 	if( !this ) return;
-	if(this->pgresult != NULL && !this->autoclear)
-		PQclear(this->pgresult);
+	pgresult_clear( this );
 
 	xfree(this);
 }
@@ -257,6 +382,50 @@ pgresult_s_allocate( VALUE klass )
 	return self;
 }
 
+/*
+ * Return a frozen String for the given field name.
+ *
+ * Equal field names share one String object across all results,
+ * so that they don't need to be allocated per result.
+ */
+static VALUE
+pgresult_intern_fname( const char *name, int enc_idx )
+{
+#ifdef HAVE_RB_ENC_INTERNED_STR
+	return rb_enc_interned_str( name, strlen(name), rb_enc_from_index(enc_idx) );
+#else
+	VALUE fname = rb_tainted_str_new2( name );
+	VALUE cached;
+
+	PG_ENCODING_SET_NOCHECK( fname, enc_idx );
+	cached = rb_hash_lookup( s_fname_cache, fname );
+	if( !NIL_P(cached) && ENCODING_GET(cached) == enc_idx )
+		return cached;
+
+	if( RHASH_SIZE(s_fname_cache) >= PG_FNAME_CACHE_MAX )
+		rb_hash_clear( s_fname_cache );
+	rb_obj_freeze( fname );
+	rb_hash_aset( s_fname_cache, fname, fname );
+	return fname;
+#endif
+}
+
+/*
+ * Build the field name object according to the PG_RESULT_FIELD_NAMES_* flags.
+ */
+static VALUE
+pgresult_fname_value( int flags, const char *name, int enc_idx )
+{
+	if( flags & PG_RESULT_FIELD_NAMES_STATIC_SYMBOL ){
+		return ID2SYM( rb_intern3(name, strlen(name), rb_enc_from_index(enc_idx)) );
+	} else {
+		VALUE fname = pgresult_intern_fname( name, enc_idx );
+		if( flags & PG_RESULT_FIELD_NAMES_SYMBOL )
+			return rb_str_intern( fname );
+		return fname;
+	}
+}
+
 static void pgresult_init_fnames(VALUE self)
 {
 	t_pg_result *this = pgresult_get_this_safe(self);
@@ -264,19 +433,42 @@ static void pgresult_init_fnames(VALUE self)
 	if( this->nfields == -1 ){
 		int i;
 		int nfields = PQnfields(this->pgresult);
+		int enc_idx = ENCODING_GET(self);
 
 		for( i=0; i<nfields; i++ ){
-			VALUE fname = rb_tainted_str_new2(PQfname(this->pgresult, i));
-			PG_ENCODING_SET_NOCHECK(fname, ENCODING_GET(self));
-			this->fnames[i] = rb_obj_freeze(fname);
+			this->fnames[i] = pgresult_fname_value( this->flags, PQfname(this->pgresult, i), enc_idx );
 			this->nfields = i + 1;
-
-			RB_GC_GUARD(fname);
 		}
 		this->nfields = nfields;
 	}
 }
 
+int
+pg_result_field_name_type_flags( VALUE sym )
+{
+	if( sym == sym_symbol ){
+		return PG_RESULT_FIELD_NAMES_SYMBOL;
+	} else if ( sym == sym_static_symbol ){
+		return PG_RESULT_FIELD_NAMES_STATIC_SYMBOL;
+	} else if ( sym == sym_string ){
+		return 0;
+	} else {
+		rb_raise(rb_eArgError, "invalid argument %+"PRIsVALUE, sym);
+	}
+}
+
+VALUE
+pg_result_field_name_type_sym( int flags )
+{
+	if( flags & PG_RESULT_FIELD_NAMES_SYMBOL ){
+		return sym_symbol;
+	} else if( flags & PG_RESULT_FIELD_NAMES_STATIC_SYMBOL ){
+		return sym_static_symbol;
+	} else {
+		return sym_string;
+	}
+}
+
 /********************************************************************
  *
  * Document-class: PG::Result
@@ -444,24 +636,22 @@ pgresult_nfields(VALUE self)
 
 /*
  * call-seq:
- *    res.fname( index ) -> String
+ *    res.fname( index ) -> String or Symbol
  *
  * Returns the name of the column corresponding to _index_.
+ * Depending on #field_name_type= it's a String or Symbol.
  */
 static VALUE
 pgresult_fname(VALUE self, VALUE index)
 {
-	VALUE fname;
-	PGresult *result = pgresult_get(self);
+	t_pg_result *this = pgresult_get_this_safe(self);
 	int i = NUM2INT(index);
 
-	if (i < 0 || i >= PQnfields(result)) {
+	if (i < 0 || i >= PQnfields(this->pgresult)) {
 		rb_raise(rb_eArgError,"invalid field number %d", i);
 	}
 
-	fname = rb_tainted_str_new2(PQfname(result, i));
-	PG_ENCODING_SET_NOCHECK(fname, ENCODING_GET(self));
-	return rb_obj_freeze(fname);
+	return pgresult_fname_value( this->flags, PQfname(this->pgresult, i), ENCODING_GET(self) );
 }
 
 /*
@@ -751,6 +941,13 @@ pgresult_paramtype(VALUE self, VALUE param_number)
 	return UINT2NUM(PQparamtype(result,NUM2INT(param_number)));
 }
 
+static const char *
+pgresult_cmd_status_str(VALUE self)
+{
+	t_pg_result *this = pgresult_get_this_safe(self);
+	return NIL_P(this->cmd_status) ? PQcmdStatus(this->pgresult) : RSTRING_PTR(this->cmd_status);
+}
+
 /*
  * call-seq:
  *    res.cmd_status() -> String
@@ -760,7 +957,7 @@ pgresult_paramtype(VALUE self, VALUE param_number)
 static VALUE
 pgresult_cmd_status(VALUE self)
 {
-	VALUE ret = rb_tainted_str_new2(PQcmdStatus(pgresult_get(self)));
+	VALUE ret = rb_tainted_str_new2(pgresult_cmd_status_str(self));
 	PG_ENCODING_SET_NOCHECK(ret, ENCODING_GET(self));
 	return ret;
 }
@@ -789,7 +986,17 @@ static VALUE
 pgresult_cmd_tuples(VALUE self)
 {
 	long n;
-	n = strtol(PQcmdTuples(pgresult_get(self)),NULL, 10);
+	t_pg_result *this = pgresult_get_this_safe(self);
+
+	if( NIL_P(this->cmd_status) ){
+		n = strtol(PQcmdTuples(this->pgresult),NULL, 10);
+	} else {
+		/* Joined results are always of row returning commands like "SELECT 5"
+		 * or "INSERT 0 5", which have the number of rows at the end. */
+		const char *status = RSTRING_PTR(this->cmd_status);
+		const char *p = strrchr(status, ' ');
+		n = p ? strtol(p + 1, NULL, 10) : 0;
+	}
 	return INT2NUM(n);
 }
 
@@ -803,7 +1010,15 @@ pgresult_cmd_tuples(VALUE self)
 static VALUE
 pgresult_oid_value(VALUE self)
 {
-	Oid n = PQoidValue(pgresult_get(self));
+	t_pg_result *this = pgresult_get_this_safe(self);
+	Oid n;
+
+	if( NIL_P(this->cmd_status) ){
+		n = PQoidValue(this->pgresult);
+	} else {
+		const char *status = RSTRING_PTR(this->cmd_status);
+		n = strncmp(status, "INSERT ", 7) == 0 ? (Oid)strtoul(status + 7, NULL, 10) : InvalidOid;
+	}
 	if (n == InvalidOid)
 		return Qnil;
 	else
@@ -812,6 +1027,68 @@ pgresult_oid_value(VALUE self)
 
 /* Utility methods not in libpq */
 
+#if !defined(HAVE_RB_HASH_BULK_INSERT) || !defined(HAVE_RB_HASH_NEW_CAPA)
+/*
+ * Build the template Hash for row hashes once per result.
+ * It has all field names as keys, so that copies of it are already
+ * sized and laid out for the row values.
+ */
+static VALUE
+pgresult_tuple_hash_template( VALUE self, t_pg_result *this )
+{
+	if( NIL_P(this->tuple_hash) ){
+		VALUE tuple = rb_hash_new();
+		int field_num;
+
+		for ( field_num = 0; field_num < this->nfields; field_num++ ) {
+			rb_hash_aset( tuple, this->fnames[field_num], Qnil );
+		}
+		this->tuple_hash = tuple;
+	}
+	return this->tuple_hash;
+}
+#endif
+
+/*
+ * Build the Hash of tuple +tuple_num+ with field names as keys.
+ */
+VALUE
+pg_result_tuple_hash(VALUE self, int tuple_num)
+{
+	t_pg_result *this = pgresult_get_this(self);
+	int field_num;
+	VALUE tuple;
+
+	if( this->nfields == -1 )
+		pgresult_init_fnames( self );
+
+#if defined(HAVE_RB_HASH_BULK_INSERT) && defined(HAVE_RB_HASH_NEW_CAPA)
+	/* Bulk insert into a Hash sized for the fields. Inserting into a copy
+	 * of the template would count the keys twice and would convert small
+	 * Hashes to the larger st_table layout. */
+	{
+		PG_VARIABLE_LENGTH_ARRAY(VALUE, pairs, this->nfields * 2, PG_MAX_COLUMNS * 2)
+
+		for ( field_num = 0; field_num < this->nfields; field_num++ ) {
+			pairs[field_num * 2] = this->fnames[field_num];
+			pairs[field_num * 2 + 1] = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, tuple_num, field_num);
+		}
+		tuple = rb_hash_new_capa( this->nfields );
+		rb_hash_bulk_insert( this->nfields * 2, pairs, tuple );
+	}
+#else
+	/* Copying the prefilled Hash is faster than populating an empty Hash
+	 * object, since the copy doesn't need to grow or to rehash. */
+	tuple = rb_hash_dup( pgresult_tuple_hash_template(self, this) );
+	for ( field_num = 0; field_num < this->nfields; field_num++ ) {
+		VALUE val = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, tuple_num, field_num);
+		rb_hash_aset( tuple, this->fnames[field_num], val );
+	}
+#endif
+
+	return tuple;
+}
+
 /*
  * call-seq:
  *    res[ n ] -> Hash
@@ -823,28 +1100,83 @@ pgresult_aref(VALUE self, VALUE index)
 {
 	t_pg_result *this = pgresult_get_this_safe(self);
 	int tuple_num = NUM2INT(index);
-	int field_num;
 	int num_tuples = PQntuples(this->pgresult);
-	VALUE tuple;
+
+	if ( tuple_num < 0 || tuple_num >= num_tuples )
+		rb_raise( rb_eIndexError, "Index %d is out of range", tuple_num );
+
+	return pg_result_tuple_hash( self, tuple_num );
+}
+
+void
+pg_result_init_field_map( VALUE self )
+{
+	t_pg_result *this = pgresult_get_this(self);
 
 	if( this->nfields == -1 )
 		pgresult_init_fnames( self );
 
+	if( NIL_P(this->field_map) ){
+		int i;
+		VALUE field_map = rb_hash_new();
+		for( i = 0; i < this->nfields; i++ ){
+			/* Same as PQfnumber(): the first column wins on duplicated field names. */
+			if( !RTEST(rb_hash_lookup2(field_map, this->fnames[i], Qfalse)) )
+				rb_hash_aset(field_map, this->fnames[i], INT2FIX(i));
+		}
+		rb_obj_freeze(field_map);
+		this->field_map = field_map;
+	}
+}
+
+/*
+ * call-seq:
+ *    res.tuple( n ) -> PG::Tuple
+ *
+ * Returns a PG::Tuple from the nth row of the result.
+ *
+ * Field values are decoded lazily on first access, so this is cheaper than #[]
+ * when only some fields of a row are used.
+ */
+static VALUE
+pgresult_tuple(VALUE self, VALUE index)
+{
+	int tuple_num;
+	t_pg_result *this = pgresult_get_this_safe(self);
+	int num_tuples = PQntuples(this->pgresult);
+
+	tuple_num = NUM2INT(index);
 	if ( tuple_num < 0 || tuple_num >= num_tuples )
 		rb_raise( rb_eIndexError, "Index %d is out of range", tuple_num );
 
-	/* We reuse the Hash of the previous output for larger row counts.
-	 * This is somewhat faster than populating an empty Hash object. */
-	tuple = NIL_P(this->tuple_hash) ? rb_hash_new() : this->tuple_hash;
-	for ( field_num = 0; field_num < this->nfields; field_num++ ) {
-		VALUE val = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, tuple_num, field_num);
-		rb_hash_aset( tuple, this->fnames[field_num], val );
-	}
-	/* Store a copy of the filled hash for use at the next row. */
-	if( num_tuples > 10 )
-		this->tuple_hash = rb_hash_dup(tuple);
+	pg_result_init_field_map(self);
 
-	return tuple;
+	return pg_tuple_new(self, tuple_num);
+}
+
+/*
+ * call-seq:
+ *    res.each_tuple{ |tuple| ... }
+ *
+ * Yields each row of the result as a PG::Tuple .
+ */
+static VALUE
+pgresult_each_tuple(VALUE self)
+{
+	t_pg_result *this;
+	int tuple_num;
+	int num_tuples;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pgresult_ntuples_for_enum);
+
+	this = pgresult_get_this_safe(self);
+	num_tuples = PQntuples(this->pgresult);
+	pg_result_init_field_map(self);
+
+	for( tuple_num = 0; tuple_num < num_tuples; tuple_num++ ){
+		rb_yield(pg_tuple_new(self, tuple_num));
+	}
+	return self;
 }
 
 /*
@@ -881,104 +1213,782 @@ pgresult_each_row(VALUE self)
 	return Qnil;
 }
 
-/*
- * call-seq:
- *    res.values -> Array
- *
- * Returns all tuples as an array of arrays.
- */
-static VALUE
-pgresult_values(VALUE self)
+VALUE
+pg_result_tuple_values(VALUE self, int row, int nfields)
 {
-	t_pg_result *this = pgresult_get_this_safe(self);
-	int row;
+	t_pg_result *this = pgresult_get_this(self);
+	PG_VARIABLE_LENGTH_ARRAY(VALUE, row_values, nfields, PG_MAX_COLUMNS)
 	int field;
-	int num_rows = PQntuples(this->pgresult);
-	int num_fields = PQnfields(this->pgresult);
-	VALUE results = rb_ary_new2( num_rows );
-
-	for ( row = 0; row < num_rows; row++ ) {
-		PG_VARIABLE_LENGTH_ARRAY(VALUE, row_values, num_fields, PG_MAX_COLUMNS)
 
-		/* populate the row */
-		for ( field = 0; field < num_fields; field++ ) {
-			row_values[field] = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, row, field);
-		}
-		rb_ary_store( results, row, rb_ary_new4( num_fields, row_values ) );
+	/* populate the row */
+	for ( field = 0; field < nfields; field++ ) {
+		row_values[field] = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, row, field);
 	}
+	return rb_ary_new4( nfields, row_values );
+}
 
-	return results;
+/* Preallocated rows of batches of streamed results, whose total is unknown */
+#define PG_ROW_BATCH_STREAM_CAPA 1000
+
+/*
+ * Initialize the batch state. The batch Array is preallocated for at most
+ * +max_rows+ rows, so that huge batch sizes don't allocate memory for rows
+ * which never arrive.
+ */
+static void
+pgresult_batch_init( t_pg_row_batch *p_batch, long batch_size, long max_rows, int reuse )
+{
+	p_batch->capa = batch_size < max_rows ? batch_size : max_rows;
+	p_batch->batch = rb_ary_new2( p_batch->capa );
+	p_batch->batch_size = batch_size;
+	p_batch->num_rows = 0;
+	p_batch->reuse = reuse;
 }
 
 /*
- * Make a Ruby array out of the encoded values from the specified
- * column in the given result.
+ * Account one more row to the batch and yield the batch when it's full.
  */
-static VALUE
-make_column_result_array( VALUE self, int col )
+static void
+pgresult_batch_commit( t_pg_row_batch *p_batch )
 {
-	t_pg_result *this = pgresult_get_this_safe(self);
-	int rows = PQntuples( this->pgresult );
-	int i;
-	VALUE results = rb_ary_new2( rows );
+	if( ++p_batch->num_rows < p_batch->batch_size )
+		return;
 
-	if ( col >= PQnfields(this->pgresult) )
-		rb_raise( rb_eIndexError, "no column %d in result", col );
+	rb_yield( p_batch->batch );
 
-	for ( i=0; i < rows; i++ ) {
-		VALUE val = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, i, col);
-		rb_ary_store( results, i, val );
+	p_batch->num_rows = 0;
+	if( !p_batch->reuse ){
+		/* The yielded Array is handed over to the block, so start a new one. */
+		p_batch->batch = rb_ary_new2( p_batch->capa );
 	}
-
-	return results;
 }
 
-
-/*
- *  call-seq:
- *     res.column_values( n )   -> array
- *
- *  Returns an Array of the values from the nth column of each
- *  tuple in the result.
- *
- */
-static VALUE
-pgresult_column_values(VALUE self, VALUE index)
+static void
+pgresult_batch_push( t_pg_row_batch *p_batch, VALUE row )
 {
-	int col = NUM2INT( index );
-	return make_column_result_array( self, col );
+	rb_ary_store( p_batch->batch, p_batch->num_rows, row );
+	pgresult_batch_commit( p_batch );
 }
 
-
 /*
- *  call-seq:
- *     res.field_values( field )   -> array
- *
- *  Returns an Array of the values from the given _field_ of each tuple in the result.
- *
+ * Store the values of +row+ as Array into the batch.
+ * In reuse mode the row Array of the previous batch is overwritten,
+ * as long as the block didn't replace it by something else.
  */
-static VALUE
-pgresult_field_values( VALUE self, VALUE field )
+static void
+pgresult_batch_fill_row( t_pg_row_batch *p_batch, VALUE self, int row, int nfields )
 {
-	PGresult *result = pgresult_get( self );
-	const char *fieldname = StringValueCStr( field );
-	int fnum = PQfnumber( result, fieldname );
+	VALUE row_ary = Qnil;
 
-	if ( fnum < 0 )
-		rb_raise( rb_eIndexError, "no such field '%s' in result", fieldname );
+	if( p_batch->reuse && p_batch->num_rows < RARRAY_LEN(p_batch->batch) )
+		row_ary = rb_ary_entry( p_batch->batch, p_batch->num_rows );
 
-	return make_column_result_array( self, fnum );
-}
+	if( RB_TYPE_P(row_ary, T_ARRAY) ){
+		t_pg_result *this = pgresult_get_this(self);
+		int field;
 
+		for ( field = 0; field < nfields; field++ ) {
+			rb_ary_store( row_ary, field, this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, row, field) );
+		}
+		if( RARRAY_LEN(row_ary) > nfields )
+			rb_ary_resize( row_ary, nfields );
+		pgresult_batch_commit( p_batch );
+	} else {
+		pgresult_batch_push( p_batch, pg_result_tuple_values(self, row, nfields) );
+	}
+}
 
 /*
- * call-seq:
- *    res.each{ |tuple| ... }
- *
- * Invokes block for each tuple in the result set.
+ * Yield the remaining rows of the last, incomplete batch.
  */
-static VALUE
-pgresult_each(VALUE self)
+static void
+pgresult_batch_finish( t_pg_row_batch *p_batch )
+{
+	if( p_batch->num_rows > 0 ){
+		rb_ary_resize( p_batch->batch, p_batch->num_rows );
+		rb_yield( p_batch->batch );
+	}
+}
+
+static long
+pgresult_batch_size( VALUE batch_size_in )
+{
+	long batch_size = NUM2LONG( batch_size_in );
+	if( batch_size < 1 )
+		rb_raise( rb_eArgError, "batch size must be positive" );
+	return batch_size;
+}
+
+static int
+pgresult_batch_option_reuse( VALUE opts )
+{
+	if( NIL_P(opts) )
+		return 0;
+	Check_Type(opts, T_HASH);
+	return RTEST( rb_hash_aref(opts, ID2SYM(rb_intern("reuse"))) );
+}
+
+static VALUE
+pgresult_num_batches_for_enum(VALUE self, VALUE args, VALUE eobj)
+{
+	t_pg_result *this = pgresult_get_this(self);
+	long batch_size = pgresult_batch_size( rb_ary_entry(args, 0) );
+	long ntuples = this->pgresult ? PQntuples(this->pgresult) : 0;
+
+	return LONG2NUM( (ntuples + batch_size - 1) / batch_size );
+}
+
+/*
+ * call-seq:
+ *    res.each_row_batch( n, reuse: false ) { |rows| ... }
+ *
+ * Yields the rows of the result in batches of +n+ rows.
+ * Each batch is an Array of rows and each row is an Array of column values.
+ * The last batch may contain less than +n+ rows.
+ *
+ * This is equal to <tt>res.each_row.each_slice(n)</tt> , but faster.
+ *
+ * With <tt>reuse: true</tt> the same batch Array and the same row Arrays
+ * are overwritten with the values of the next rows on every yield.
+ * This avoids most of the allocations, but the block must not keep
+ * references to the yielded Arrays beyond the current iteration.
+ *
+ * Example:
+ *    res = conn.exec("SELECT generate_series(1,5)")
+ *    res.each_row_batch(2).to_a  # => [[["1"], ["2"]], [["3"], ["4"]], [["5"]]]
+ *
+ * See #stream_each_row for the streaming counterpart.
+ */
+static VALUE
+pgresult_each_row_batch(int argc, VALUE *argv, VALUE self)
+{
+	t_pg_result *this;
+	t_pg_row_batch batch;
+	VALUE batch_size_in, opts;
+	int row;
+	int num_rows;
+	int num_fields;
+
+	rb_scan_args( argc, argv, "11", &batch_size_in, &opts );
+	RETURN_SIZED_ENUMERATOR(self, argc, argv, pgresult_num_batches_for_enum);
+
+	this = pgresult_get_this_safe(self);
+	num_rows = PQntuples(this->pgresult);
+	num_fields = PQnfields(this->pgresult);
+
+	pgresult_batch_init( &batch, pgresult_batch_size(batch_size_in), num_rows, pgresult_batch_option_reuse(opts) );
+	for ( row = 0; row < num_rows; row++ ) {
+		pgresult_batch_fill_row( &batch, self, row, num_fields );
+	}
+	pgresult_batch_finish( &batch );
+
+	return self;
+}
+
+/*
+ * Parse the +threads+ option of #values and #columns .
+ */
+static int
+pgresult_threads_option( VALUE opts )
+{
+	VALUE threads;
+
+	if( NIL_P(opts) )
+		return 1;
+	Check_Type( opts, T_HASH );
+	threads = rb_hash_aref( opts, ID2SYM(rb_intern("threads")) );
+	if( NIL_P(threads) )
+		return 1;
+	if( NUM2INT(threads) < 1 )
+		rb_raise( rb_eArgError, "number of threads must be positive" );
+	return NUM2INT( threads );
+}
+
+struct predecode_args {
+	t_pg_result *this;
+	int ncols;
+	const int *fields;
+	const int *kinds;
+	int nthreads;
+	VALUE *p_wrapper;
+};
+
+static VALUE
+pgresult_predecode_columns( VALUE _args )
+{
+	struct predecode_args *args = (struct predecode_args *)_args;
+
+	return (VALUE)pg_predecode_columns( args->this->pgresult, args->ncols, args->fields, args->kinds, args->nthreads, args->p_wrapper );
+}
+
+static VALUE
+pgresult_predecode_release( VALUE _this )
+{
+	((t_pg_result *)_this)->busy--;
+	return Qnil;
+}
+
+/*
+ * Decode the integer, float and boolean columns out of +cols+ in parallel
+ * by +nthreads+ native threads. +cols+ can be NULL to process all columns.
+ *
+ * Returns NULL if no column can be processed in parallel.
+ */
+static struct pg_predecode *
+pgresult_predecode( VALUE self, int ncols, const int *cols, int nthreads, VALUE *p_wrapper )
+{
+	t_pg_result *this = pgresult_get_this_safe(self);
+	PG_VARIABLE_LENGTH_ARRAY(int, fields, ncols, PG_MAX_COLUMNS)
+	PG_VARIABLE_LENGTH_ARRAY(int, kinds, ncols, PG_MAX_COLUMNS)
+	struct predecode_args args;
+	int i;
+
+	if( nthreads < 2 )
+		return NULL;
+
+	for( i = 0; i < ncols; i++ ){
+		t_pg_coder *p_coder = NULL;
+		t_pg_coder_dec_func dec_func;
+
+		fields[i] = cols ? cols[i] : i;
+		dec_func = pgresult_column_dec_func( this, fields[i], &p_coder );
+		/* Memoized values are already cheap and must be stored in the memo. */
+		kinds[i] = dec_func && !(p_coder && p_coder->memo) ? pg_predecode_kind( dec_func ) : PG_PREDECODE_NONE;
+	}
+
+	args.this = this;
+	args.ncols = ncols;
+	args.fields = fields;
+	args.kinds = kinds;
+	args.nthreads = nthreads;
+	args.p_wrapper = p_wrapper;
+
+	/* Pin the PGresult, so that it isn't cleared by another thread while it's read without GVL. */
+	this->busy++;
+	return (struct pg_predecode *)rb_ensure( pgresult_predecode_columns, (VALUE)&args, pgresult_predecode_release, (VALUE)this );
+}
+
+/*
+ * call-seq:
+ *    res.values -> Array
+ *    res.values( threads: n ) -> Array
+ *
+ * Returns all tuples as an array of arrays.
+ *
+ * With option +threads+ columns decoded by the Integer, Float or Boolean
+ * decoders of PG::TextDecoder or PG::BinaryDecoder are parsed by up to +n+
+ * native threads without holding the GVL. The Ruby objects are
+ * created afterwards by the calling thread. This speeds up retrieval of large
+ * results on multi-core machines. Small results are not split across threads.
+ * Columns of all other decoders, including the Date, Timestamp and Numeric
+ * decoders, are decoded serially by the calling thread as usual.
+ */
+static VALUE
+pgresult_values(int argc, VALUE *argv, VALUE self)
+{
+	t_pg_result *this = pgresult_get_this_safe(self);
+	int row;
+	int field;
+	int num_rows = PQntuples(this->pgresult);
+	int num_fields = PQnfields(this->pgresult);
+	VALUE results = rb_ary_new2( num_rows );
+	VALUE opts, wrapper = Qnil;
+	struct pg_predecode *p_pre;
+	PG_VARIABLE_LENGTH_ARRAY(t_pg_predecoded_column *, pre_cols, num_fields, PG_MAX_COLUMNS)
+
+	rb_scan_args( argc, argv, "01", &opts );
+	p_pre = pgresult_predecode( self, num_fields, NULL, pgresult_threads_option(opts), &wrapper );
+	for ( field = 0; field < num_fields; field++ ) {
+		pre_cols[field] = pg_predecoded_column( p_pre, field );
+	}
+
+	for ( row = 0; row < num_rows; row++ ) {
+		PG_VARIABLE_LENGTH_ARRAY(VALUE, row_values, num_fields, PG_MAX_COLUMNS)
+
+		/* populate the row */
+		for ( field = 0; field < num_fields; field++ ) {
+			VALUE val = pre_cols[field] ? pg_predecoded_value( pre_cols[field], row ) : Qundef;
+			if( val == Qundef )
+				val = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, row, field);
+			row_values[field] = val;
+		}
+		rb_ary_store( results, row, rb_ary_new4( num_fields, row_values ) );
+	}
+
+	RB_GC_GUARD( wrapper );
+	return results;
+}
+
+/*
+ * Retrieve the members of a Struct or Data class.
+ */
+static VALUE
+pgresult_struct_members( VALUE klass )
+{
+	VALUE members;
+
+	if( !RB_TYPE_P(klass, T_CLASS) || !rb_respond_to(klass, s_id_members) )
+		rb_raise( rb_eTypeError, "wrong argument type %s (expected Struct or Data class)",
+				RB_TYPE_P(klass, T_CLASS) ? rb_class2name(klass) : rb_obj_classname(klass) );
+
+	members = rb_funcall( klass, s_id_members, 0 );
+	Check_Type( members, T_ARRAY );
+	return members;
+}
+
+/*
+ * Whether +klass+ is to be instantiated with keyword arguments. Data
+ * classes and keyword_init Struct classes receive their members as
+ * keywords in +initialize+ .
+ */
+static int
+pgresult_struct_keywords( VALUE klass )
+{
+	if( rb_const_defined(rb_cObject, s_id_Data) ){
+		VALUE data_klass = rb_const_get( rb_cObject, s_id_Data );
+		if( RB_TYPE_P(data_klass, T_CLASS) && rb_class_inherited_p(klass, data_klass) == Qtrue )
+			return 1;
+	}
+	return rb_respond_to( klass, s_id_keyword_init_p ) && RTEST( rb_funcall(klass, s_id_keyword_init_p, 0) );
+}
+
+/*
+ * Build one Struct or Data object per row and either yield it or
+ * collect all objects into an Array.
+ */
+static VALUE
+pgresult_build_structs( VALUE self, VALUE klass, int yield )
+{
+	t_pg_result *this = pgresult_get_this_safe(self);
+	VALUE members = pgresult_struct_members( klass );
+	int num_members = RARRAY_LENINT( members );
+	int num_rows = PQntuples(this->pgresult);
+	int num_fields = PQnfields(this->pgresult);
+	int keywords = pgresult_struct_keywords( klass );
+	VALUE results = yield ? Qnil : rb_ary_new2( num_rows );
+	int row;
+	int member;
+	PG_VARIABLE_LENGTH_ARRAY(int, member_fields, num_members, PG_MAX_COLUMNS)
+
+	/* Map the members to field numbers once per result.
+	 * Members without a matching field are set to nil.
+	 */
+	for ( member = 0; member < num_members; member++ ) {
+		VALUE member_sym = rb_ary_entry( members, member );
+		const char *member_name;
+		int field;
+
+		Check_Type( member_sym, T_SYMBOL );
+		member_name = rb_id2name( SYM2ID(member_sym) );
+		member_fields[member] = -1;
+		for ( field = 0; field < num_fields; field++ ) {
+			if( strcmp(PQfname(this->pgresult, field), member_name) == 0 ){
+				member_fields[member] = field;
+				break;
+			}
+		}
+	}
+
+	for ( row = 0; row < num_rows; row++ ) {
+		PG_VARIABLE_LENGTH_ARRAY(VALUE, member_values, num_members, PG_MAX_COLUMNS)
+		VALUE obj;
+
+		/* populate the members */
+		for ( member = 0; member < num_members; member++ ) {
+			int field = member_fields[member];
+			member_values[member] = field < 0 ? Qnil :
+				this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, row, field);
+		}
+
+		if( keywords ){
+			VALUE kwargs = rb_hash_new();
+
+			for ( member = 0; member < num_members; member++ ) {
+				rb_hash_aset( kwargs, rb_ary_entry(members, member), member_values[member] );
+			}
+#ifdef HAVE_RB_CLASS_NEW_INSTANCE_KW
+			obj = rb_class_new_instance_kw( 1, &kwargs, klass, RB_PASS_KEYWORDS );
+#else
+			obj = rb_class_new_instance( 1, &kwargs, klass );
+#endif
+		} else {
+			obj = rb_class_new_instance( num_members, member_values, klass );
+		}
+
+		if( yield )
+			rb_yield( obj );
+		else
+			rb_ary_store( results, row, obj );
+	}
+
+	return yield ? self : results;
+}
+
+/*
+ * call-seq:
+ *    res.each_as( klass ) { |obj| ... }
+ *
+ * Yields each row of the result as an instance of +klass+ , which must
+ * be a Struct or Data class.
+ *
+ * The members of +klass+ are mapped to the result fields of equal name once
+ * per result. Members without a matching field are set to +nil+ and
+ * fields without a matching member are ignored.
+ * The field values are converted by the type map of the result and are passed
+ * positionally to +initialize+ of +klass+ without an intermediate Hash or Array.
+ * Data and keyword_init Struct classes receive them as keyword arguments.
+ *
+ * Example:
+ *    Point = Struct.new(:x, :y)
+ *    res = conn.exec("SELECT 1 AS x, 2 AS y")
+ *    res.each_as(Point).to_a  # => [#<struct Point x="1", y="2">]
+ */
+static VALUE
+pgresult_each_as( VALUE self, VALUE klass )
+{
+	RETURN_SIZED_ENUMERATOR(self, 1, &klass, pgresult_ntuples_for_enum);
+	return pgresult_build_structs( self, klass, 1 );
+}
+
+/*
+ * call-seq:
+ *    res.to_structs( klass )  -> Array
+ *
+ * Returns all rows of the result as an Array of instances of +klass+ ,
+ * which must be a Struct or Data class.
+ * See #each_as for details.
+ */
+static VALUE
+pgresult_to_structs( VALUE self, VALUE klass )
+{
+	return pgresult_build_structs( self, klass, 0 );
+}
+
+/*
+ * Resolve the decoder function of the given column once, so that it can be
+ * called for every value of the column without going through the type map.
+ *
+ * Returns NULL if the type map needs to be asked for each value.
+ */
+static t_pg_coder_dec_func
+pgresult_column_dec_func( t_pg_result *this, int col, t_pg_coder **pp_coder )
+{
+	t_typemap *p_typemap = this->p_typemap;
+	int format = PQfformat(this->pgresult, col);
+
+	if( p_typemap->funcs.typecast_result_value == pg_tmbc_result_value ){
+		t_tmbc *p_tmbc = (t_tmbc *)p_typemap;
+		t_pg_coder *p_coder = p_tmbc->convs[col].cconv;
+
+		if( p_coder ){
+			/* Only C decoders are safe to call without the type map. */
+			if( !p_coder->dec_func ) return NULL;
+			*pp_coder = p_coder;
+			return p_coder->dec_func;
+		}
+		p_typemap = DATA_PTR( p_typemap->default_typemap );
+	}
+
+	if( p_typemap->funcs.typecast_result_value == pg_tmas_result_value ){
+		*pp_coder = NULL;
+		return format == 0 ? pg_text_dec_string : pg_bin_dec_bytea;
+	}
+
+	return NULL;
+}
+
+/*
+ * Resolve a field given as Integer column number or as String or Symbol
+ * field name to the column number.
+ */
+int
+pg_result_field_number( VALUE self, VALUE field )
+{
+	PGresult *result = pgresult_get( self );
+	int fnum;
+
+	if( RB_TYPE_P(field, T_FIXNUM) || RB_TYPE_P(field, T_BIGNUM) ){
+		fnum = NUM2INT( field );
+		if ( fnum < 0 || fnum >= PQnfields(result) )
+			rb_raise( rb_eIndexError, "no column %d in result", fnum );
+	} else {
+		const char *fieldname;
+		if( SYMBOL_P(field) )
+			field = rb_sym2str( field );
+		fieldname = StringValueCStr( field );
+		fnum = PQfnumber( result, fieldname );
+		if ( fnum < 0 )
+			rb_raise( rb_eIndexError, "no such field '%s' in result", fieldname );
+	}
+
+	return fnum;
+}
+
+/*
+ * Make a Ruby array out of the encoded values from the specified
+ * column in the given result.
+ *
+ * The decoder is resolved once per column and NULL checks are skipped
+ * for columns without any NULL value.
+ */
+static VALUE
+make_column_result_array( VALUE self, int col, t_pg_predecoded_column *pre_col )
+{
+	t_pg_result *this = pgresult_get_this_safe(self);
+	int rows = PQntuples( this->pgresult );
+	int i;
+	int has_nulls;
+	int enc_idx;
+	t_pg_coder *p_coder;
+	t_pg_coder_dec_func dec_func;
+	VALUE results = rb_ary_new2( rows );
+
+	if ( col < 0 || col >= PQnfields(this->pgresult) )
+		rb_raise( rb_eIndexError, "no column %d in result", col );
+
+	dec_func = pgresult_column_dec_func( this, col, &p_coder );
+
+	if( !dec_func ){
+		for ( i=0; i < rows; i++ ) {
+			VALUE val = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, i, col);
+			rb_ary_store( results, i, val );
+		}
+		return results;
+	}
+
+	/* Pre-scan the column for NULL values */
+	for ( i=0; i < rows && !PQgetisnull(this->pgresult, i, col); i++ );
+	has_nulls = i < rows;
+	enc_idx = ENCODING_GET(self);
+
+	for ( i=0; i < rows; i++ ) {
+		VALUE val = pre_col ? pg_predecoded_value( pre_col, i ) : Qundef;
+		if( val != Qundef ){
+			/* already decoded */
+		} else if( has_nulls && PQgetisnull(this->pgresult, i, col) ){
+			val = Qnil;
+		} else if( p_coder && p_coder->memo ){
+			val = pg_coder_dec_memo( p_coder, dec_func, PQgetvalue(this->pgresult, i, col),
+					PQgetlength(this->pgresult, i, col), i, col, enc_idx );
+		} else {
+			val = dec_func( p_coder, PQgetvalue(this->pgresult, i, col),
+					PQgetlength(this->pgresult, i, col), i, col, enc_idx );
+		}
+		rb_ary_store( results, i, val );
+	}
+
+	return results;
+}
+
+/*
+ *  call-seq:
+ *     res.column_values( n )   -> array
+ *
+ *  Returns an Array of the values from the nth column of each
+ *  tuple in the result.
+ *
+ */
+static VALUE
+pgresult_column_values(VALUE self, VALUE index)
+{
+	int col = NUM2INT( index );
+	return make_column_result_array( self, col, NULL );
+}
+
+
+/*
+ *  call-seq:
+ *     res.field_values( field )   -> array
+ *
+ *  Returns an Array of the values from the given _field_ of each tuple in the result.
+ *
+ */
+static VALUE
+pgresult_field_values( VALUE self, VALUE field )
+{
+	PGresult *result = pgresult_get( self );
+	const char *fieldname = StringValueCStr( field );
+	int fnum = PQfnumber( result, fieldname );
+
+	if ( fnum < 0 )
+		rb_raise( rb_eIndexError, "no such field '%s' in result", fieldname );
+
+	return make_column_result_array( self, fnum, NULL );
+}
+
+
+/*
+ * Remove a trailing options Hash from the arguments of #columns and
+ * #columns_hash and return the number of threads.
+ */
+static int
+pgresult_columns_options( int *p_argc, VALUE *argv )
+{
+	if( *p_argc > 0 && RB_TYPE_P(argv[*p_argc - 1], T_HASH) )
+		return pgresult_threads_option( argv[--*p_argc] );
+	return 1;
+}
+
+/*
+ *  call-seq:
+ *     res.columns             -> array
+ *     res.columns( *fields )  -> array
+ *     res.columns( *fields, threads: n )  -> array
+ *
+ *  Returns an Array of Arrays with the values of each column of the result.
+ *
+ *  If no +fields+ are given, all columns are returned. Otherwise only the given
+ *  columns are decoded. They can be specified as column numbers or field names.
+ *
+ *  The values are decoded column by column, so that the decoder of each
+ *  column is resolved only once. This is faster than #values if the data
+ *  is consumed column-wise.
+ *
+ *  Option +threads+ enables parallel decoding of integer, float and boolean
+ *  columns like described at #values .
+ *
+ *    res = conn.exec("SELECT 1 AS a, 'x' AS b UNION ALL SELECT 2, 'y'")
+ *    res.columns           # => [["1", "2"], ["x", "y"]]
+ *    res.columns('b', 0)   # => [["x", "y"], ["1", "2"]]
+ */
+static VALUE
+pgresult_columns(int argc, VALUE *argv, VALUE self)
+{
+	PGresult *result = pgresult_get( self );
+	int nthreads = pgresult_columns_options( &argc, argv );
+	int num_cols = argc > 0 ? argc : PQnfields(result);
+	int i;
+	VALUE columns = rb_ary_new2( num_cols );
+	VALUE wrapper = Qnil;
+	struct pg_predecode *p_pre;
+	const int *p_cols = NULL;
+	PG_VARIABLE_LENGTH_ARRAY(int, cols, num_cols, PG_MAX_COLUMNS)
+
+	if( argc > 0 ){
+		for( i = 0; i < num_cols; i++ ){
+			cols[i] = pg_result_field_number( self, argv[i] );
+		}
+		p_cols = cols;
+	}
+	p_pre = pgresult_predecode( self, num_cols, p_cols, nthreads, &wrapper );
+
+	for( i = 0; i < num_cols; i++ ){
+		int col = p_cols ? p_cols[i] : i;
+		rb_ary_store( columns, i, make_column_result_array(self, col, pg_predecoded_column(p_pre, col)) );
+	}
+
+	RB_GC_GUARD( wrapper );
+	return columns;
+}
+
+/*
+ *  call-seq:
+ *     res.columns_hash             -> hash
+ *     res.columns_hash( *fields )  -> hash
+ *
+ *  Returns a Hash with field names as keys and an Array of the column values as values.
+ *
+ *  It works like #columns , but uses the field names as keys.
+ *
+ *    res.columns_hash      # => {"a"=>["1", "2"], "b"=>["x", "y"]}
+ */
+static VALUE
+pgresult_columns_hash(int argc, VALUE *argv, VALUE self)
+{
+	t_pg_result *this = pgresult_get_this_safe(self);
+	int nthreads = pgresult_columns_options( &argc, argv );
+	int num_cols = argc > 0 ? argc : PQnfields(this->pgresult);
+	int i;
+	VALUE columns = rb_hash_new();
+	VALUE wrapper = Qnil;
+	struct pg_predecode *p_pre;
+	const int *p_cols = NULL;
+	PG_VARIABLE_LENGTH_ARRAY(int, cols, num_cols, PG_MAX_COLUMNS)
+
+	if( this->nfields == -1 )
+		pgresult_init_fnames( self );
+
+	if( argc > 0 ){
+		for( i = 0; i < num_cols; i++ ){
+			cols[i] = pg_result_field_number( self, argv[i] );
+		}
+		p_cols = cols;
+	}
+	p_pre = pgresult_predecode( self, num_cols, p_cols, nthreads, &wrapper );
+
+	for( i = 0; i < num_cols; i++ ){
+		int col = p_cols ? p_cols[i] : i;
+		rb_hash_aset( columns, this->fnames[col], make_column_result_array(self, col, pg_predecoded_column(p_pre, col)) );
+	}
+
+	RB_GC_GUARD( wrapper );
+	return columns;
+}
+
+/*
+ *  call-seq:
+ *     res.pluck( field )            -> array
+ *     res.pluck( field, *fields )   -> array of arrays
+ *
+ *  Returns the values of the given fields of each tuple in the result.
+ *  Fields can be specified as column numbers or field names (String or Symbol).
+ *
+ *  With one field, an Array of the values of this column is returned.
+ *  With several fields, an Array with one Array per tuple is returned,
+ *  containing the values in the order of the given fields.
+ *
+ *  Only the requested columns are decoded, so that large columns, which
+ *  are not needed, don't cause decoding costs.
+ *
+ *    res = conn.exec("SELECT 1 AS a, 'x' AS b, 'large' AS c UNION ALL SELECT 2, 'y', 'large'")
+ *    res.pluck(:a)          # => ["1", "2"]
+ *    res.pluck('b', 0)      # => [["x", "1"], ["y", "2"]]
+ */
+static VALUE
+pgresult_pluck(int argc, VALUE *argv, VALUE self)
+{
+	t_pg_result *this = pgresult_get_this_safe(self);
+	int num_rows = PQntuples(this->pgresult);
+	int row, i;
+	VALUE results;
+	PG_VARIABLE_LENGTH_ARRAY(int, cols, argc, PG_MAX_COLUMNS)
+
+	if( argc < 1 )
+		rb_raise( rb_eArgError, "at least one field must be given" );
+
+	for( i = 0; i < argc; i++ ){
+		cols[i] = pg_result_field_number( self, argv[i] );
+	}
+
+	results = rb_ary_new2( num_rows );
+	for( row = 0; row < num_rows; row++ ){
+		VALUE value;
+
+		if( argc == 1 ){
+			value = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, row, cols[0]);
+		} else {
+			PG_VARIABLE_LENGTH_ARRAY(VALUE, row_values, argc, PG_MAX_COLUMNS)
+
+			for( i = 0; i < argc; i++ ){
+				row_values[i] = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, row, cols[i]);
+			}
+			value = rb_ary_new4( argc, row_values );
+		}
+		rb_ary_store( results, row, value );
+	}
+
+	return results;
+}
+
+
+/*
+ * call-seq:
+ *    res.each{ |tuple| ... }
+ *
+ * Invokes block for each tuple in the result set.
+ */
+static VALUE
+pgresult_each(VALUE self)
 {
 	PGresult *result;
 	int tuple_num;
@@ -997,7 +2007,8 @@ pgresult_each(VALUE self)
  * call-seq:
  *    res.fields() -> Array
  *
- * Returns an array of Strings representing the names of the fields in the result.
+ * Depending on #field_name_type= it returns an array of Strings or Symbols
+ * representing the names of the fields in the result.
  */
 static VALUE
 pgresult_fields(VALUE self)
@@ -1056,57 +2067,138 @@ pgresult_type_map_get(VALUE self)
 	return this->typemap;
 }
 
-#ifdef HAVE_PQSETSINGLEROWMODE
 /*
  * call-seq:
- *    res.stream_each{ |tuple| ... }
+ *    res.field_name_type = Symbol
  *
- * Invokes block for each tuple in the result set in single row mode.
+ * Set type of field names specific to this result.
+ * It can be set to one of:
+ * * +:string+ to use String based field names
+ * * +:symbol+ to use Symbol based field names
+ * * +:static_symbol+ to use static Symbol based field names
  *
- * This is a convenience method for retrieving all result tuples
- * as they are transferred. It is an alternative to repeated calls of
- * PG::Connection#get_result , but given that it avoids the overhead of
- * wrapping each row into a dedicated result object, it delivers data in nearly
- * the same speed as with ordinary results.
+ * The default is retrieved from PG::Connection#field_name_type , which defaults to +:string+ .
  *
- * The result must be in status PGRES_SINGLE_TUPLE.
- * It iterates over all tuples until the status changes to PGRES_TUPLES_OK.
- * A PG::Error is raised for any errors from the server.
+ * This setting affects several result methods:
+ * * keys of Hash returned by #[] , #each and #stream_each
+ * * #fields
+ * * #fname
+ * * field names used by #tuple and #each_tuple
  *
- * Row description data does not change while the iteration. All value retrieval
- * methods refer to only the current row. Result#ntuples returns +1+ while
- * the iteration and +0+ after all tuples were yielded.
+ * The type of field names can only be changed before any of the affected methods have been called.
  *
- * Example:
- *   conn.send_query( "first SQL query; second SQL query" )
- *   conn.set_single_row_mode
- *   conn.get_result.stream_each do |row|
- *     # do something with the received row of the first query
- *   end
- *   conn.get_result.stream_each do |row|
- *     # do something with the received row of the second query
- *   end
- *   conn.get_result  # => nil   (no more results)
+ */
+static VALUE
+pgresult_field_name_type_set(VALUE self, VALUE sym)
+{
+	t_pg_result *this = pgresult_get_this(self);
+	if( this->nfields != -1 ) rb_raise(rb_eArgError, "field names are already materialized");
+
+	this->flags &= ~PG_RESULT_FIELD_NAMES_MASK;
+	this->flags |= pg_result_field_name_type_flags( sym );
+
+	return sym;
+}
+
+/*
+ * call-seq:
+ *    res.field_name_type -> Symbol
  *
- * Available since PostgreSQL-9.2
+ * Get type of field names.
+ *
+ * See description at #field_name_type=
  */
 static VALUE
-pgresult_stream_each(VALUE self)
+pgresult_field_name_type_get(VALUE self)
+{
+	t_pg_result *this = pgresult_get_this(self);
+
+	return pg_result_field_name_type_sym( this->flags );
+}
+
+#ifdef HAVE_PQSETSINGLEROWMODE
+/*
+ * Parse the options Hash of the stream_each* methods.
+ * Returns the requested batch size or 0 if rows shall be yielded one by one.
+ */
+static long
+pgresult_stream_batch_options( int argc, VALUE *argv, int *p_reuse )
+{
+	VALUE opts, batch;
+
+	rb_scan_args( argc, argv, "01", &opts );
+	*p_reuse = pgresult_batch_option_reuse( opts );
+	if( NIL_P(opts) )
+		return 0;
+
+	batch = rb_hash_aref( opts, ID2SYM(rb_intern("batch")) );
+	if( NIL_P(batch) )
+		return 0;
+
+	return pgresult_batch_size( batch );
+}
+
+static void
+yield_hash(VALUE self, int ntuples, int nfields, void *data)
+{
+	int tuple_num;
+
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		rb_yield(pgresult_aref(self, INT2NUM(tuple_num)));
+	}
+}
+
+static void
+yield_array(VALUE self, int ntuples, int nfields, void *data)
+{
+	int row;
+
+	for ( row = 0; row < ntuples; row++ ) {
+		rb_yield( pg_result_tuple_values(self, row, nfields) );
+	}
+}
+
+static void
+yield_hash_batch(VALUE self, int ntuples, int nfields, void *data)
+{
+	int tuple_num;
+
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		pgresult_batch_push( data, pgresult_aref(self, INT2NUM(tuple_num)) );
+	}
+}
+
+static void
+yield_array_batch(VALUE self, int ntuples, int nfields, void *data)
+{
+	int row;
+
+	for ( row = 0; row < ntuples; row++ ) {
+		pgresult_batch_fill_row( data, self, row, nfields );
+	}
+}
+
+/*
+ * Iterate over all results of a query in single row or chunked rows mode
+ * and hand the rows of each received PGresult over to +yielder+ .
+ */
+VALUE
+pg_result_stream_any(VALUE self, t_pg_result_yielder yielder, void *data)
 {
 	t_pg_result *this;
 	int nfields;
 	PGconn *pgconn;
 	PGresult *pgresult;
-
-	RETURN_ENUMERATOR(self, 0, NULL);
+	t_pg_result_limits limits;
+	int limited;
 
 	this = pgresult_get_this_safe(self);
 	pgconn = pg_get_pgconn(this->connection);
 	pgresult = this->pgresult;
 	nfields = PQnfields(pgresult);
+	limited = pg_result_limits_init(this->connection, &limits);
 
 	for(;;){
-		int tuple_num;
 		int ntuples = PQntuples(pgresult);
 
 		switch( PQresultStatus(pgresult) ){
@@ -1115,37 +2207,115 @@ pgresult_stream_each(VALUE self)
 					return self;
 				rb_raise( rb_eInvalidResultStatus, "PG::Result is not in single row mode");
 			case PGRES_SINGLE_TUPLE:
+#ifdef HAVE_CONST_PGRES_TUPLES_CHUNK
+			case PGRES_TUPLES_CHUNK:
+#endif
 				break;
 			default:
 				pg_result_check( self );
 		}
 
-		for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
-			rb_yield(pgresult_aref(self, INT2NUM(tuple_num)));
-		}
+		if( limited )
+			pg_result_limits_account( this->connection, &limits, pgresult );
 
-		if( !this->autoclear ){
-			PQclear( pgresult );
-			this->pgresult = NULL;
-		}
+		yielder( self, ntuples, nfields, data );
+
+		pgresult_clear( this );
 
 		pgresult = gvl_PQgetResult(pgconn);
 		if( pgresult == NULL )
 			rb_raise( rb_eNoResultError, "no result received - possibly an intersection with another result retrieval");
 
+		this->pgresult = pgresult;
+		pgresult_track_memory( this );
+
 		if( nfields != PQnfields(pgresult) )
 			rb_raise( rb_eInvalidChangeOfResultFields, "number of fields must not change in single row mode");
-
-		this->pgresult = pgresult;
 	}
 
 	/* never reached */
 	return self;
 }
 
+static VALUE
+pgresult_stream_batches(VALUE self, t_pg_result_yielder yielder, long batch_size, int reuse)
+{
+	t_pg_row_batch batch;
+
+	pgresult_batch_init( &batch, batch_size, PG_ROW_BATCH_STREAM_CAPA, reuse );
+	pg_result_stream_any( self, yielder, &batch );
+	pgresult_batch_finish( &batch );
+
+	return self;
+}
+
+/*
+ * call-seq:
+ *    res.stream_each{ |tuple| ... }
+ *    res.stream_each( batch: n, reuse: false ){ |tuples| ... }
+ *
+ * Invokes block for each tuple in the result set in single row mode.
+ *
+ * This is a convenience method for retrieving all result tuples
+ * as they are transferred. It is an alternative to repeated calls of
+ * PG::Connection#get_result , but given that it avoids the overhead of
+ * wrapping each row into a dedicated result object, it delivers data in nearly
+ * the same speed as with ordinary results.
+ *
+ * The result must be in status PGRES_SINGLE_TUPLE or PGRES_TUPLES_CHUNK.
+ * It iterates over all tuples until the status changes to PGRES_TUPLES_OK.
+ * A PG::Error is raised for any errors from the server.
+ *
+ * Row description data does not change while the iteration. All value retrieval
+ * methods refer to only the current row. Result#ntuples returns +1+ while
+ * the iteration and +0+ after all tuples were yielded.
+ * In chunked rows mode Result#ntuples returns the number of tuples of the
+ * current chunk.
+ *
+ * With option +batch+ the tuples are collected into Arrays of +n+ tuples,
+ * which are yielded instead of single tuples. Rows are coalesced across the
+ * received results, so that the batch size is independent of the chunk size
+ * given to PG::Connection#set_chunked_rows_mode . The last batch may contain
+ * less than +n+ tuples.
+ * Option <tt>reuse: true</tt> yields the same batch Array each time,
+ * like described at #each_row_batch .
+ *
+ * The limits set by PG::Connection#max_result_rows= and
+ * PG::Connection#max_result_bytes= are checked for each received result.
+ * PG::ResultTooLarge is raised and the query is cancelled when they are exceeded.
+ *
+ * Example:
+ *   conn.send_query( "first SQL query; second SQL query" )
+ *   conn.set_single_row_mode
+ *   conn.get_result.stream_each do |row|
+ *     # do something with the received row of the first query
+ *   end
+ *   conn.get_result.stream_each do |row|
+ *     # do something with the received row of the second query
+ *   end
+ *   conn.get_result  # => nil   (no more results)
+ *
+ * Available since PostgreSQL-9.2
+ */
+static VALUE
+pgresult_stream_each(int argc, VALUE *argv, VALUE self)
+{
+	long batch_size;
+	int reuse;
+
+	RETURN_ENUMERATOR(self, argc, argv);
+
+	batch_size = pgresult_stream_batch_options( argc, argv, &reuse );
+	if( batch_size > 0 )
+		return pgresult_stream_batches( self, yield_hash_batch, batch_size, reuse );
+
+	return pg_result_stream_any( self, yield_hash, NULL );
+}
+
 /*
  * call-seq:
  *    res.stream_each_row { |row| ... }
+ *    res.stream_each_row( batch: n, reuse: false ){ |rows| ... }
  *
  * Yields each row of the result set in single row mode.
  * The row is a list of column values.
@@ -1153,66 +2323,24 @@ pgresult_stream_each(VALUE self)
  * This method works equally to #stream_each , but yields an Array of
  * values.
  *
+ * With option +batch+ it is the streaming counterpart of #each_row_batch .
+ * Option <tt>reuse: true</tt> overwrites the same row Arrays on every yield.
+ *
  * Available since PostgreSQL-9.2
  */
 static VALUE
-pgresult_stream_each_row(VALUE self)
+pgresult_stream_each_row(int argc, VALUE *argv, VALUE self)
 {
-	t_pg_result *this;
-	int row;
-	int nfields;
-	PGconn *pgconn;
-	PGresult *pgresult;
+	long batch_size;
+	int reuse;
 
-	RETURN_ENUMERATOR(self, 0, NULL);
+	RETURN_ENUMERATOR(self, argc, argv);
 
-	this = pgresult_get_this_safe(self);
-	pgconn = pg_get_pgconn(this->connection);
-	pgresult = this->pgresult;
-	nfields = PQnfields(pgresult);
+	batch_size = pgresult_stream_batch_options( argc, argv, &reuse );
+	if( batch_size > 0 )
+		return pgresult_stream_batches( self, yield_array_batch, batch_size, reuse );
 
-	for(;;){
-		int ntuples = PQntuples(pgresult);
-
-		switch( PQresultStatus(pgresult) ){
-			case PGRES_TUPLES_OK:
-				if( ntuples == 0 )
-					return self;
-				rb_raise( rb_eInvalidResultStatus, "PG::Result is not in single row mode");
-			case PGRES_SINGLE_TUPLE:
-				break;
-			default:
-				pg_result_check( self );
-		}
-
-		for ( row = 0; row < ntuples; row++ ) {
-			PG_VARIABLE_LENGTH_ARRAY(VALUE, row_values, nfields, PG_MAX_COLUMNS)
-			int field;
-
-			/* populate the row */
-			for ( field = 0; field < nfields; field++ ) {
-				row_values[field] = this->p_typemap->funcs.typecast_result_value(this->p_typemap, self, row, field);
-			}
-			rb_yield( rb_ary_new4( nfields, row_values ));
-		}
-
-		if( !this->autoclear ){
-			PQclear( pgresult );
-			this->pgresult = NULL;
-		}
-
-		pgresult = gvl_PQgetResult(pgconn);
-		if( pgresult == NULL )
-			rb_raise( rb_eNoResultError, "no result received - possibly an intersection with another result retrieval");
-
-		if( nfields != PQnfields(pgresult) )
-			rb_raise( rb_eInvalidChangeOfResultFields, "number of fields must not change in single row mode");
-
-		this->pgresult = pgresult;
-	}
-
-	/* never reached */
-	return self;
+	return pg_result_stream_any( self, yield_array, NULL );
 }
 #endif
 
@@ -1220,6 +2348,18 @@ pgresult_stream_each_row(VALUE self)
 void
 init_pg_result()
 {
+	sym_string = ID2SYM(rb_intern("string"));
+	sym_symbol = ID2SYM(rb_intern("symbol"));
+	sym_static_symbol = ID2SYM(rb_intern("static_symbol"));
+	s_id_members = rb_intern("members");
+	s_id_keyword_init_p = rb_intern("keyword_init?");
+	s_id_Data = rb_intern("Data");
+
+#ifndef HAVE_RB_ENC_INTERNED_STR
+	s_fname_cache = rb_hash_new();
+	rb_gc_register_address( &s_fname_cache );
+#endif
+
 	rb_cPGresult = rb_define_class_under( rb_mPG, "Result", rb_cObject );
 	rb_define_alloc_func( rb_cPGresult, pgresult_s_allocate );
 	rb_include_module(rb_cPGresult, rb_mEnumerable);
@@ -1262,19 +2402,32 @@ init_pg_result()
 	rb_define_method(rb_cPGresult, "each", pgresult_each, 0);
 	rb_define_method(rb_cPGresult, "fields", pgresult_fields, 0);
 	rb_define_method(rb_cPGresult, "each_row", pgresult_each_row, 0);
-	rb_define_method(rb_cPGresult, "values", pgresult_values, 0);
+	rb_define_method(rb_cPGresult, "each_row_batch", pgresult_each_row_batch, -1);
+	rb_define_method(rb_cPGresult, "values", pgresult_values, -1);
+	rb_define_method(rb_cPGresult, "each_as", pgresult_each_as, 1);
+	rb_define_method(rb_cPGresult, "to_structs", pgresult_to_structs, 1);
 	rb_define_method(rb_cPGresult, "column_values", pgresult_column_values, 1);
 	rb_define_method(rb_cPGresult, "field_values", pgresult_field_values, 1);
+	rb_define_method(rb_cPGresult, "columns", pgresult_columns, -1);
+	rb_define_method(rb_cPGresult, "columns_hash", pgresult_columns_hash, -1);
+	rb_define_method(rb_cPGresult, "pluck", pgresult_pluck, -1);
+	rb_define_method(rb_cPGresult, "tuple", pgresult_tuple, 1);
+	rb_define_method(rb_cPGresult, "each_tuple", pgresult_each_tuple, 0);
 	rb_define_method(rb_cPGresult, "cleared?", pgresult_cleared_p, 0);
 	rb_define_method(rb_cPGresult, "autoclear?", pgresult_autoclear_p, 0);
+	rb_define_method(rb_cPGresult, "memsize", pgresult_memsize, 0);
+	rb_define_singleton_method(rb_cPGresult, "live_bytes", pgresult_s_live_bytes, 0);
 
 	rb_define_method(rb_cPGresult, "type_map=", pgresult_type_map_set, 1);
 	rb_define_method(rb_cPGresult, "type_map", pgresult_type_map_get, 0);
 
+	rb_define_method(rb_cPGresult, "field_name_type=", pgresult_field_name_type_set, 1 );
+	rb_define_method(rb_cPGresult, "field_name_type", pgresult_field_name_type_get, 0 );
+
 #ifdef HAVE_PQSETSINGLEROWMODE
 	/******     PG::Result INSTANCE METHODS: streaming     ******/
-	rb_define_method(rb_cPGresult, "stream_each", pgresult_stream_each, 0);
-	rb_define_method(rb_cPGresult, "stream_each_row", pgresult_stream_each_row, 0);
+	rb_define_method(rb_cPGresult, "stream_each", pgresult_stream_each, -1);
+	rb_define_method(rb_cPGresult, "stream_each_row", pgresult_stream_each_row, -1);
 #endif
 }
 
@@ -0,0 +1,565 @@
+/*
+ * pg_result_aggregate.c - PG::Result#aggregate
+ * $Id$
+ *
+ * Aggregates over a single column, which are computed from the raw values
+ * of the PGresult without creating a Ruby object per value.
+ */
+
+#include "pg.h"
+#include "util.h"
+#include <math.h>
+
+#define AGG_MAX_DECIMAL_DIGITS 18
+
+typedef enum {
+	AGG_SUM,
+	AGG_MIN,
+	AGG_MAX,
+	AGG_AVG,
+	AGG_COUNT_NONNULL
+} t_agg_op;
+
+typedef enum {
+	AGG_KIND_INT,
+	AGG_KIND_FLOAT,
+	AGG_KIND_NUMERIC,
+	AGG_KIND_TIMESTAMP
+} t_agg_kind;
+
+static const struct {
+	const char *name;
+	t_agg_op op;
+} agg_ops[] = {
+	{ "sum", AGG_SUM },
+	{ "min", AGG_MIN },
+	{ "max", AGG_MAX },
+	{ "avg", AGG_AVG },
+	{ "count_nonnull", AGG_COUNT_NONNULL },
+};
+
+static const int64_t agg_pow10[AGG_MAX_DECIMAL_DIGITS + 1] = {
+	INT64_C(1), INT64_C(10), INT64_C(100), INT64_C(1000), INT64_C(10000), INT64_C(100000),
+	INT64_C(1000000), INT64_C(10000000), INT64_C(100000000), INT64_C(1000000000),
+	INT64_C(10000000000), INT64_C(100000000000), INT64_C(1000000000000),
+	INT64_C(10000000000000), INT64_C(100000000000000), INT64_C(1000000000000000),
+	INT64_C(10000000000000000), INT64_C(100000000000000000), INT64_C(1000000000000000000),
+};
+
+static ID s_id_utc;
+
+/* Exact sum of int64 values, which continues in a Ruby Integer on overflow. */
+typedef struct {
+	int64_t sum;
+	VALUE big;
+} t_agg_int_sum;
+
+/* Exact sum of decimal values as scaled int64, which continues in a BigDecimal on overflow. */
+typedef struct {
+	int64_t mant;
+	int scale;
+	VALUE big;
+} t_agg_decimal_sum;
+
+
+static t_agg_op
+agg_op_from_value( VALUE op )
+{
+	const char *name;
+	size_t i;
+
+	if( SYMBOL_P(op) ){
+		name = rb_id2name( SYM2ID(op) );
+	} else {
+		name = StringValueCStr( op );
+	}
+
+	for( i = 0; i < sizeof(agg_ops) / sizeof(agg_ops[0]); i++ ){
+		if( strcmp(name, agg_ops[i].name) == 0 )
+			return agg_ops[i].op;
+	}
+	rb_raise( rb_eArgError, "unknown aggregate %s", name );
+}
+
+static t_agg_kind
+agg_kind_from_type( PGresult *pgresult, int col )
+{
+	Oid ftype = PQftype( pgresult, col );
+
+	switch( ftype ){
+		case 20: case 21: case 23:
+			return AGG_KIND_INT;
+		case 700: case 701:
+			return AGG_KIND_FLOAT;
+		case 1700:
+			return AGG_KIND_NUMERIC;
+		case 1082: case 1114: case 1184:
+			return AGG_KIND_TIMESTAMP;
+	}
+	rb_raise( rb_eArgError, "column %s has unsupported type OID %u", PQfname(pgresult, col), (unsigned)ftype );
+}
+
+static void
+agg_raise_invalid( const char *kind, const char *val, int row )
+{
+	rb_raise( rb_eArgError, "invalid value for %s at row %d: %s", kind, row, val );
+}
+
+
+static void
+agg_int_sum_add( t_agg_int_sum *acc, int64_t i )
+{
+	if( (i > 0 && acc->sum > INT64_MAX - i) || (i < 0 && acc->sum < INT64_MIN - i) ){
+		VALUE sum = LL2NUM( acc->sum );
+		acc->big = NIL_P(acc->big) ? sum : rb_funcall( acc->big, '+', 1, sum );
+		acc->sum = 0;
+	}
+	acc->sum += i;
+}
+
+static VALUE
+agg_int_sum_value( t_agg_int_sum *acc )
+{
+	VALUE sum = LL2NUM( acc->sum );
+	return NIL_P(acc->big) ? sum : rb_funcall( acc->big, '+', 1, sum );
+}
+
+
+/*
+ * Parse a decimal in numeric output format to a scaled int64.
+ * Returns 0 for NaN, infinity and values with too many digits.
+ */
+static int
+agg_parse_decimal( const char *p, int64_t *p_mant, int *p_scale )
+{
+	int64_t mant = 0;
+	int ndigits = 0, scale = 0, neg = 0;
+
+	if( *p == '-' ){
+		neg = 1;
+		p++;
+	}
+	if( *p < '0' || *p > '9' )
+		return 0;
+	for( ; *p >= '0' && *p <= '9'; p++ ){
+		if( ++ndigits > AGG_MAX_DECIMAL_DIGITS ) return 0;
+		mant = mant * 10 + (*p - '0');
+	}
+	if( *p == '.' ){
+		for( p++; *p >= '0' && *p <= '9'; p++, scale++ ){
+			if( ++ndigits > AGG_MAX_DECIMAL_DIGITS ) return 0;
+			mant = mant * 10 + (*p - '0');
+		}
+	}
+	if( *p != 0 )
+		return 0;
+
+	*p_mant = neg ? -mant : mant;
+	*p_scale = scale;
+	return 1;
+}
+
+/* Multiply a scaled value by a power of ten. Returns 0 on overflow. */
+static int
+agg_decimal_rescale( int64_t *p_mant, int from, int to )
+{
+	int64_t factor = agg_pow10[to - from];
+
+	if( *p_mant > INT64_MAX / factor || *p_mant < INT64_MIN / factor )
+		return 0;
+	*p_mant *= factor;
+	return 1;
+}
+
+/* Decimal digits of the largest absolute int64 value */
+#define AGG_INT64_DIGITS 19
+
+static VALUE
+agg_decimal_to_s( int64_t mant, int scale )
+{
+	/* sign, digits and decimal point */
+	char buf[1 + AGG_INT64_DIGITS + 1];
+	char digits[AGG_INT64_DIGITS + 1];
+	uint64_t abs = mant < 0 ? (uint64_t)0 - (uint64_t)mant : (uint64_t)mant;
+	int ndigits;
+	char *p = buf;
+
+	/* The scale is limited by agg_parse_decimal(), so that the digits always fit. */
+	if( scale < 0 || scale > AGG_MAX_DECIMAL_DIGITS )
+		rb_raise( rb_eArgError, "invalid decimal scale %d", scale );
+	ndigits = snprintf( digits, sizeof(digits), "%0*llu", scale + 1, (unsigned long long)abs );
+	if( ndigits < 0 || ndigits >= (int)sizeof(digits) )
+		rb_raise( rb_eRangeError, "decimal value is too long" );
+
+	if( mant < 0 ) *p++ = '-';
+	memcpy( p, digits, ndigits - scale );
+	p += ndigits - scale;
+	if( scale > 0 ){
+		*p++ = '.';
+		memcpy( p, digits + ndigits - scale, scale );
+		p += scale;
+	}
+	return rb_str_new( buf, p - buf );
+}
+
+static void
+agg_decimal_sum_flush( t_agg_decimal_sum *acc )
+{
+	VALUE sum = pg_bigdecimal_new( agg_decimal_to_s(acc->mant, acc->scale) );
+	acc->big = NIL_P(acc->big) ? sum : rb_funcall( acc->big, '+', 1, sum );
+	acc->mant = 0;
+	acc->scale = 0;
+}
+
+static void
+agg_decimal_sum_add( t_agg_decimal_sum *acc, const char *val, long len )
+{
+	int64_t mant;
+	int scale;
+
+	if( !agg_parse_decimal(val, &mant, &scale) ){
+		/* NaN, infinity or too many digits for the int64 fast path */
+		VALUE value = pg_bigdecimal_new( rb_str_new(val, len) );
+		acc->big = NIL_P(acc->big) ? value : rb_funcall( acc->big, '+', 1, value );
+		return;
+	}
+
+	if( scale > acc->scale ){
+		if( !agg_decimal_rescale(&acc->mant, acc->scale, scale) ){
+			agg_decimal_sum_flush( acc );
+		}
+		acc->scale = scale;
+	} else if( scale < acc->scale ){
+		if( !agg_decimal_rescale(&mant, scale, acc->scale) ){
+			agg_decimal_sum_flush( acc );
+			acc->scale = scale;
+		}
+	}
+
+	if( (mant > 0 && acc->mant > INT64_MAX - mant) || (mant < 0 && acc->mant < INT64_MIN - mant) ){
+		int scale_sum = acc->scale;
+		agg_decimal_sum_flush( acc );
+		acc->scale = scale_sum;
+	}
+	acc->mant += mant;
+}
+
+static VALUE
+agg_decimal_sum_value( t_agg_decimal_sum *acc )
+{
+	VALUE sum = pg_bigdecimal_new( agg_decimal_to_s(acc->mant, acc->scale) );
+	return NIL_P(acc->big) ? sum : rb_funcall( acc->big, '+', 1, sum );
+}
+
+static int
+agg_decimal_rank( const char *p )
+{
+	if( strcmp(p, "NaN") == 0 ) return 3;
+	if( strcmp(p, "Infinity") == 0 ) return 2;
+	if( strcmp(p, "-Infinity") == 0 ) return -2;
+	return *p == '-' ? -1 : 1;
+}
+
+/*
+ * Compare two values in numeric output format with the sort order of
+ * PostgreSQL, which places NaN above all other values.
+ */
+static int
+agg_decimal_cmp( const char *a, const char *b )
+{
+	int rank_a = agg_decimal_rank( a );
+	int rank_b = agg_decimal_rank( b );
+	size_t ilen_a, ilen_b;
+	int cmp;
+
+	if( rank_a != rank_b )
+		return rank_a < rank_b ? -1 : 1;
+	if( rank_a != 1 && rank_a != -1 )
+		return 0;
+
+	if( rank_a < 0 ){
+		a++;
+		b++;
+	}
+	/* The output format has no leading zeros, so that longer integer parts are bigger. */
+	ilen_a = strcspn( a, "." );
+	ilen_b = strcspn( b, "." );
+	if( ilen_a != ilen_b ){
+		cmp = ilen_a < ilen_b ? -1 : 1;
+	} else {
+		cmp = memcmp( a, b, ilen_a );
+		if( cmp == 0 ){
+			const char *fa = a[ilen_a] ? a + ilen_a + 1 : a + ilen_a;
+			const char *fb = b[ilen_b] ? b + ilen_b + 1 : b + ilen_b;
+
+			while( cmp == 0 && (*fa || *fb) ){
+				char ca = *fa ? *fa++ : '0';
+				char cb = *fb ? *fb++ : '0';
+				cmp = ca - cb;
+			}
+		}
+		cmp = cmp < 0 ? -1 : cmp > 0 ? 1 : 0;
+	}
+	return rank_a < 0 ? -cmp : cmp;
+}
+
+/*
+ * Convert a numeric value in binary format to the text output format.
+ * The text is written NUL terminated into +buf+ .
+ */
+static void
+agg_numeric_bin_to_s( const char *val, int len, VALUE buf, int row )
+{
+	int size = pg_numeric_bin_to_str( val, len, NULL );
+
+	if( size < 0 )
+		rb_raise( rb_eArgError, "invalid binary numeric length %d at row %d", len, row );
+	rb_str_resize( buf, size );
+	size = pg_numeric_bin_to_str( val, len, RSTRING_PTR(buf) );
+	rb_str_set_len( buf, size );
+	RSTRING_PTR(buf)[size] = 0;
+}
+
+
+/* Ordering of floats with NaN above all other values, like PostgreSQL does. */
+static int
+agg_float_gt( double a, double b )
+{
+	if( isnan(a) ) return !isnan(b);
+	return !isnan(b) && a > b;
+}
+
+static VALUE
+agg_time_value( int64_t usec )
+{
+	int64_t sec, rem;
+
+	if( usec == INT64_MAX ) return rb_float_new( HUGE_VAL );
+	if( usec == INT64_MIN ) return rb_float_new( -HUGE_VAL );
+
+	sec = usec / 1000000;
+	rem = usec % 1000000;
+	if( rem < 0 ){
+		sec--;
+		rem += 1000000;
+	}
+	return rb_funcall( rb_time_nano_new((time_t)sec, (long)rem * 1000), s_id_utc, 0 );
+}
+
+/*
+ * Compute an aggregate over the given rows of a column.
+ * +rows+ may be NULL to aggregate over all rows of the result.
+ */
+VALUE
+pg_result_aggregate( VALUE result, const int *rows, long nrows, VALUE field, VALUE op_value )
+{
+	PGresult *pgresult = pgresult_get( result );
+	int col = pg_result_field_number( result, field );
+	t_agg_op op = agg_op_from_value( op_value );
+	t_agg_kind kind = agg_kind_from_type( pgresult, col );
+	int binary = PQfformat( pgresult, col );
+	long count = 0, i;
+
+	if( rows == NULL )
+		nrows = PQntuples( pgresult );
+
+	if( op == AGG_COUNT_NONNULL ){
+		for( i = 0; i < nrows; i++ ){
+			if( !PQgetisnull(pgresult, rows ? rows[i] : (int)i, col) )
+				count++;
+		}
+		return LONG2NUM( count );
+	}
+
+	switch( kind ){
+		case AGG_KIND_INT:
+		case AGG_KIND_TIMESTAMP: {
+			int is_timestamp = kind == AGG_KIND_TIMESTAMP;
+			t_agg_int_sum acc = { 0, Qnil };
+			int64_t min = INT64_MAX, max = INT64_MIN;
+
+			if( is_timestamp && (op == AGG_SUM || op == AGG_AVG) )
+				rb_raise( rb_eArgError, "%s is not supported for date and timestamp columns", op == AGG_SUM ? "sum" : "avg" );
+
+			for( i = 0; i < nrows; i++ ){
+				int row = rows ? rows[i] : (int)i;
+				char *val;
+				int64_t v;
+
+				if( PQgetisnull(pgresult, row, col) ) continue;
+				val = PQgetvalue( pgresult, row, col );
+
+				if( binary ){
+					if( !pg_pack_read_binary_int(val, PQgetlength(pgresult, row, col), is_timestamp, &v) )
+						rb_raise( rb_eArgError, "invalid binary value length %d at row %d", PQgetlength(pgresult, row, col), row );
+				} else if( is_timestamp ){
+					if( !pg_pack_parse_timestamp(val, &v) )
+						agg_raise_invalid( "timestamp", val, row );
+				} else {
+					if( !pg_pack_parse_int(val, &v) )
+						agg_raise_invalid( "integer", val, row );
+				}
+
+				if( op == AGG_MIN ){
+					if( v < min ) min = v;
+				} else if( op == AGG_MAX ){
+					if( v > max ) max = v;
+				} else {
+					agg_int_sum_add( &acc, v );
+				}
+				count++;
+			}
+
+			if( count == 0 ) return Qnil;
+			switch( op ){
+				case AGG_MIN: return is_timestamp ? agg_time_value( min ) : LL2NUM( min );
+				case AGG_MAX: return is_timestamp ? agg_time_value( max ) : LL2NUM( max );
+				case AGG_SUM: return agg_int_sum_value( &acc );
+				default:
+					if( NIL_P(acc.big) )
+						return rb_float_new( (double)acc.sum / count );
+					return rb_float_new( NUM2DBL(agg_int_sum_value(&acc)) / count );
+			}
+		}
+
+		case AGG_KIND_FLOAT: {
+			double sum = 0.0, best = 0.0;
+
+			for( i = 0; i < nrows; i++ ){
+				int row = rows ? rows[i] : (int)i;
+				char *val;
+				double d;
+
+				if( PQgetisnull(pgresult, row, col) ) continue;
+				val = PQgetvalue( pgresult, row, col );
+
+				if( binary ){
+					if( !pg_pack_read_binary_float(val, PQgetlength(pgresult, row, col), &d) )
+						rb_raise( rb_eArgError, "invalid binary value length %d at row %d", PQgetlength(pgresult, row, col), row );
+				} else {
+					char *end;
+					d = strtod( val, &end );
+					if( end == val || *end != 0 )
+						agg_raise_invalid( "float", val, row );
+				}
+
+				if( op == AGG_MIN ){
+					if( count == 0 || agg_float_gt(best, d) ) best = d;
+				} else if( op == AGG_MAX ){
+					if( count == 0 || agg_float_gt(d, best) ) best = d;
+				} else {
+					sum += d;
+				}
+				count++;
+			}
+
+			if( count == 0 ) return Qnil;
+			switch( op ){
+				case AGG_MIN: case AGG_MAX: return rb_float_new( best );
+				case AGG_SUM: return rb_float_new( sum );
+				default: return rb_float_new( sum / count );
+			}
+		}
+
+		case AGG_KIND_NUMERIC: {
+			t_agg_decimal_sum acc = { 0, 0, Qnil };
+			/* The current binary value as text and a copy of the best one so far */
+			VALUE buf = binary ? rb_str_buf_new( 32 ) : Qnil;
+			VALUE best_buf = binary ? rb_str_buf_new( 32 ) : Qnil;
+			const char *best = NULL;
+			VALUE value;
+
+			for( i = 0; i < nrows; i++ ){
+				int row = rows ? rows[i] : (int)i;
+				const char *val;
+				long len;
+
+				if( PQgetisnull(pgresult, row, col) ) continue;
+
+				if( binary ){
+					agg_numeric_bin_to_s( PQgetvalue(pgresult, row, col), PQgetlength(pgresult, row, col), buf, row );
+					val = RSTRING_PTR( buf );
+					len = RSTRING_LEN( buf );
+				} else {
+					val = PQgetvalue( pgresult, row, col );
+					len = PQgetlength( pgresult, row, col );
+				}
+
+				if( op == AGG_MIN || op == AGG_MAX ){
+					int cmp = best ? agg_decimal_cmp( val, best ) : 0;
+					if( !best || (op == AGG_MIN ? cmp < 0 : cmp > 0) ){
+						if( binary ){
+							rb_str_resize( best_buf, len );
+							memcpy( RSTRING_PTR(best_buf), val, len + 1 );
+							best = RSTRING_PTR( best_buf );
+						} else {
+							best = val;
+						}
+					}
+				} else {
+					agg_decimal_sum_add( &acc, val, len );
+				}
+				count++;
+			}
+
+			if( count == 0 ) return Qnil;
+			if( op == AGG_MIN || op == AGG_MAX ){
+				value = pg_bigdecimal_new( rb_str_new_cstr(best) );
+			} else {
+				value = agg_decimal_sum_value( &acc );
+				if( op == AGG_AVG )
+					value = rb_funcall( value, '/', 1, LONG2NUM(count) );
+			}
+			RB_GC_GUARD( buf );
+			RB_GC_GUARD( best_buf );
+			return value;
+		}
+	}
+	return Qnil;
+}
+
+
+/*
+ * call-seq:
+ *    res.aggregate( field, op ) -> Integer, Float, BigDecimal, Time or nil
+ *
+ * Computes the aggregate _op_ over all non-NULL values of a column.
+ * _field_ can be given as column number or field name.
+ * _op_ is one of:
+ * * +:sum+ - the exact sum as Integer for integer columns, Float for
+ *   +real+ and <tt>double precision</tt> and BigDecimal for +numeric+ columns.
+ * * +:min+, +:max+ - the smallest or largest value as Integer, Float,
+ *   BigDecimal or UTC based Time for +date+, +timestamp+ and +timestamptz+
+ *   columns. Infinite dates and timestamps are returned as Float::INFINITY
+ *   or -Float::INFINITY . NaN sorts above all other values, like in SQL.
+ * * +:avg+ - the mean value as Float or as BigDecimal for +numeric+ columns.
+ * * +:count_nonnull+ - the number of non-NULL values of a column of any type.
+ *
+ * The values are scanned directly in the PGresult in text or binary format,
+ * so that neither the type map of the result is applied nor a Ruby object is
+ * created per value. Text dates and timestamps must be in ISO DateStyle and
+ * timestamps without time zone are taken as UTC.
+ *
+ * Like in SQL, +nil+ is returned if there is no non-NULL value.
+ * An ArgumentError is raised for other column types, for +:sum+ and +:avg+
+ * on date and timestamp columns and for values which can not be parsed.
+ *
+ *    res = conn.exec("SELECT * FROM (VALUES (1), (2), (NULL)) AS t(n)")
+ *    res.aggregate('n', :sum)            # => 3
+ *    res.aggregate('n', :avg)            # => 1.5
+ *    res.aggregate('n', :count_nonnull)  # => 2
+ */
+static VALUE
+pgresult_aggregate( VALUE self, VALUE field, VALUE op )
+{
+	return pg_result_aggregate( self, NULL, 0, field, op );
+}
+
+
+void
+init_pg_result_aggregate()
+{
+	s_id_utc = rb_intern( "utc" );
+
+	rb_define_method( rb_cPGresult, "aggregate", pgresult_aggregate, 2 );
+}
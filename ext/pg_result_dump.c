@@ -0,0 +1,282 @@
+/*
+ * pg_result_dump.c - PG::Result#dump and PG::Result.load
+ * $Id$
+ *
+ * Compact binary serialization of query results.
+ *
+ * All integers are in network byte order. The dump consists of:
+ * * the magic bytes "PGR\1"
+ * * uint32 number of fields and uint32 number of tuples
+ * * uint16 length and name of the result encoding
+ * * per field: uint16 length and name, uint32 table OID, int16 column number,
+ *   int16 format, uint32 type OID, int16 type size and int32 type modifier
+ * * a bitmap of NULL values in row-major order, bit set = NULL, LSB first
+ * * per non-NULL value in row-major order: uint32 length and the raw bytes
+ */
+
+#include "pg.h"
+#include "util.h"
+
+#define DUMP_MAGIC "PGR\1"
+#define DUMP_MAGIC_LEN 4
+/* Size of a field description without its name */
+#define DUMP_FIELD_MIN_LEN (2 + 4 + 2 + 2 + 4 + 2 + 4)
+
+static void
+dump_raise_invalid( const char *what )
+{
+	rb_raise( rb_eArgError, "invalid PG::Result dump: %s", what );
+}
+
+/*
+ * call-seq:
+ *    res.dump -> String
+ *
+ * Serializes the result into a compact binary String.
+ *
+ * The dump stores the field descriptions (name, table, column, format,
+ * type OID, size and modifier), the NULL values as bitmap and the raw bytes of
+ * all values, as they were received from the server. No value is decoded,
+ * so that the type map of the result is not applied.
+ *
+ * The String can be restored by PG::Result.load , for instance after it was
+ * stored in a cache shared by several processes:
+ *
+ *    cache.set( key, conn.exec(sql).dump )
+ *    res = PG::Result.load( cache.get(key), conn )
+ *
+ * Only results with status PGRES_TUPLES_OK (or a single row or chunk of
+ * rows) can be dumped. The command status is not preserved.
+ */
+static VALUE
+pgresult_dump( VALUE self )
+{
+	PGresult *pgresult = pgresult_get( self );
+	int nfields = PQnfields( pgresult );
+	int ntuples = PQntuples( pgresult );
+	const char *enc_name = rb_enc_name( rb_enc_from_index(ENCODING_GET(self)) );
+	size_t enc_len = strlen( enc_name );
+	size_t bitmap_len = ((size_t)ntuples * nfields + 7) / 8;
+	size_t size;
+	size_t bit;
+	int row, field;
+	VALUE dump;
+	char *p;
+
+	switch( PQresultStatus(pgresult) ){
+		case PGRES_TUPLES_OK:
+#ifdef HAVE_CONST_PGRES_SINGLE_TUPLE
+		case PGRES_SINGLE_TUPLE:
+#endif
+#ifdef HAVE_CONST_PGRES_TUPLES_CHUNK
+		case PGRES_TUPLES_CHUNK:
+#endif
+			break;
+		default:
+			rb_raise( rb_eInvalidResultStatus, "only results with tuples can be dumped" );
+	}
+
+	/* Compute the size of the dump first, so that it's written in one pass. */
+	size = DUMP_MAGIC_LEN + 4 + 4 + 2 + enc_len + bitmap_len;
+	for( field = 0; field < nfields; field++ ){
+		size += DUMP_FIELD_MIN_LEN + strlen( PQfname(pgresult, field) );
+	}
+	for( row = 0; row < ntuples; row++ ){
+		for( field = 0; field < nfields; field++ ){
+			if( !PQgetisnull(pgresult, row, field) )
+				size += 4 + PQgetlength( pgresult, row, field );
+		}
+	}
+
+	dump = rb_str_new( NULL, size );
+	p = RSTRING_PTR( dump );
+
+	memcpy( p, DUMP_MAGIC, DUMP_MAGIC_LEN ); p += DUMP_MAGIC_LEN;
+	write_nbo32( nfields, p ); p += 4;
+	write_nbo32( ntuples, p ); p += 4;
+	write_nbo16( enc_len, p ); p += 2;
+	memcpy( p, enc_name, enc_len ); p += enc_len;
+
+	for( field = 0; field < nfields; field++ ){
+		const char *fname = PQfname( pgresult, field );
+		size_t fname_len = strlen( fname );
+
+		write_nbo16( fname_len, p ); p += 2;
+		memcpy( p, fname, fname_len ); p += fname_len;
+		write_nbo32( PQftable(pgresult, field), p ); p += 4;
+		write_nbo16( PQftablecol(pgresult, field), p ); p += 2;
+		write_nbo16( PQfformat(pgresult, field), p ); p += 2;
+		write_nbo32( PQftype(pgresult, field), p ); p += 4;
+		write_nbo16( PQfsize(pgresult, field), p ); p += 2;
+		write_nbo32( PQfmod(pgresult, field), p ); p += 4;
+	}
+
+	memset( p, 0, bitmap_len );
+	for( bit = 0, row = 0; row < ntuples; row++ ){
+		for( field = 0; field < nfields; field++, bit++ ){
+			if( PQgetisnull(pgresult, row, field) )
+				p[bit / 8] |= 1 << (bit % 8);
+		}
+	}
+	p += bitmap_len;
+
+	for( row = 0; row < ntuples; row++ ){
+		for( field = 0; field < nfields; field++ ){
+			int len;
+
+			if( PQgetisnull(pgresult, row, field) )
+				continue;
+			len = PQgetlength( pgresult, row, field );
+			write_nbo32( len, p ); p += 4;
+			memcpy( p, PQgetvalue(pgresult, row, field), len ); p += len;
+		}
+	}
+
+	return dump;
+}
+
+/*
+ * call-seq:
+ *    PG::Result.load( string, connection = nil ) -> PG::Result
+ *
+ * Restores a result from a String created by PG::Result#dump .
+ *
+ * The returned object behaves like the result it was dumped from. Values are
+ * decoded on access per type map as usual. If a _connection_ is given, the
+ * result inherits its PG::Connection#type_map_for_results and
+ * PG::Connection#field_name_type , like a result received per this connection.
+ * Otherwise PG::TypeMapAllStrings is used, which can be changed per
+ * PG::Result#type_map= . The encoding of the values is restored in any case.
+ *
+ * An ArgumentError is raised if _string_ is not a valid dump.
+ */
+static VALUE
+pgresult_s_load( int argc, VALUE *argv, VALUE klass )
+{
+	VALUE data, connection, self;
+	VALUE enc_name, attrs_holder, names;
+	const char *p, *end, *values;
+	int nfields, ntuples, enc_idx, row, field;
+	size_t bitmap_len, bit, enc_len;
+	const unsigned char *bitmap;
+	PGresult *pgresult;
+	PGresAttDesc *attrs;
+
+	rb_scan_args( argc, argv, "11", &data, &connection );
+	StringValue( data );
+	if( !NIL_P(connection) && !rb_obj_is_kind_of(connection, rb_cPGconn) )
+		rb_raise( rb_eTypeError, "wrong argument type %s (expected PG::Connection)", rb_obj_classname(connection) );
+
+	p = RSTRING_PTR( data );
+	end = p + RSTRING_LEN( data );
+
+#define DUMP_NEED(n) do{ if( (size_t)(end - p) < (size_t)(n) ) dump_raise_invalid( "unexpected end of data" ); }while(0)
+
+	DUMP_NEED( DUMP_MAGIC_LEN + 4 + 4 + 2 );
+	if( memcmp(p, DUMP_MAGIC, DUMP_MAGIC_LEN) != 0 )
+		dump_raise_invalid( "wrong magic bytes" );
+	p += DUMP_MAGIC_LEN;
+	nfields = read_nbo32( p ); p += 4;
+	ntuples = read_nbo32( p ); p += 4;
+	if( nfields < 0 || ntuples < 0 || (nfields == 0 && ntuples > 0) )
+		dump_raise_invalid( "wrong number of fields or tuples" );
+	enc_len = (uint16_t)read_nbo16( p ); p += 2;
+	DUMP_NEED( enc_len );
+	enc_name = rb_str_new( p, enc_len );
+	p += enc_len;
+	enc_idx = rb_enc_find_index( StringValueCStr(enc_name) );
+	if( enc_idx < 0 )
+		enc_idx = rb_ascii8bit_encindex();
+
+	/* Check the data length before allocating per field, since the number of
+	 * fields is untrusted. Each field record has at least DUMP_FIELD_MIN_LEN bytes. */
+	DUMP_NEED( (size_t)nfields * DUMP_FIELD_MIN_LEN );
+
+	/* The field names are kept NUL terminated in Strings until PQsetResultAttrs() copied them. */
+	attrs_holder = rb_str_new( NULL, sizeof(PGresAttDesc) * (size_t)nfields );
+	attrs = (PGresAttDesc *)RSTRING_PTR( attrs_holder );
+	names = rb_ary_new2( nfields );
+
+	for( field = 0; field < nfields; field++ ){
+		size_t fname_len;
+		VALUE fname;
+
+		DUMP_NEED( 2 );
+		fname_len = (uint16_t)read_nbo16( p ); p += 2;
+		DUMP_NEED( fname_len + DUMP_FIELD_MIN_LEN - 2 );
+		fname = rb_str_new( p, fname_len );
+		rb_ary_push( names, fname );
+		attrs[field].name = StringValueCStr( fname );
+		p += fname_len;
+		attrs[field].tableid = (Oid)read_nbo32( p ); p += 4;
+		attrs[field].columnid = read_nbo16( p ); p += 2;
+		attrs[field].format = read_nbo16( p ); p += 2;
+		attrs[field].typid = (Oid)read_nbo32( p ); p += 4;
+		attrs[field].typlen = read_nbo16( p ); p += 2;
+		attrs[field].atttypmod = read_nbo32( p ); p += 4;
+	}
+
+	bitmap_len = ((size_t)ntuples * nfields + 7) / 8;
+	DUMP_NEED( bitmap_len );
+	bitmap = (const unsigned char *)p;
+	p += bitmap_len;
+
+	/* Validate the value lengths before the PGresult is built, so that it can't leak. */
+	values = p;
+	for( bit = 0; bit < (size_t)ntuples * nfields; bit++ ){
+		if( !(bitmap[bit / 8] & (1 << (bit % 8))) ){
+			int len;
+
+			DUMP_NEED( 4 );
+			len = read_nbo32( p ); p += 4;
+			if( len < 0 )
+				dump_raise_invalid( "negative value length" );
+			DUMP_NEED( len );
+			p += len;
+		}
+	}
+	if( p != end )
+		dump_raise_invalid( "trailing data" );
+#undef DUMP_NEED
+
+	pgresult = PQmakeEmptyPGresult( NULL, PGRES_TUPLES_OK );
+	if( pgresult == NULL )
+		rb_raise( rb_eNoMemError, "unable to allocate PGresult" );
+	if( nfields > 0 && !PQsetResultAttrs(pgresult, nfields, attrs) ){
+		PQclear( pgresult );
+		rb_raise( rb_eNoMemError, "unable to set PGresult attributes" );
+	}
+
+	p = values;
+	for( bit = 0, row = 0; row < ntuples; row++ ){
+		for( field = 0; field < nfields; field++, bit++ ){
+			const char *value = NULL;
+			int len = -1;
+
+			if( !(bitmap[bit / 8] & (1 << (bit % 8))) ){
+				len = read_nbo32( p ); p += 4;
+				value = p;
+				p += len;
+			}
+			if( !PQsetvalue(pgresult, row, field, (char *)value, len) ){
+				PQclear( pgresult );
+				rb_raise( rb_eNoMemError, "unable to store values into PGresult" );
+			}
+		}
+	}
+
+	self = pg_new_result( pgresult, connection );
+	PG_ENCODING_SET_NOCHECK( self, enc_idx );
+
+	RB_GC_GUARD( data );
+	RB_GC_GUARD( attrs_holder );
+	RB_GC_GUARD( names );
+	return self;
+}
+
+void
+init_pg_result_dump()
+{
+	rb_define_method( rb_cPGresult, "dump", pgresult_dump, 0 );
+	rb_define_singleton_method( rb_cPGresult, "load", pgresult_s_load, -1 );
+}
@@ -0,0 +1,421 @@
+/*
+ * pg_result_index.c - PG::Result::Index class extension
+ * $Id$
+ *
+ */
+
+#include "pg.h"
+
+/********************************************************************
+ *
+ * Document-class: PG::Result::Index
+ *
+ * A hash index over one column of a PG::Result .
+ * An instance of this class is created by PG::Result#index_by or
+ * PG::Result#group_by .
+ *
+ * The index is built over the raw bytes of the column values, so that
+ * neither keys nor rows are decoded while building it.
+ * Rows are returned as lazy PG::Tuple objects, which decode their field
+ * values on first access.
+ *
+ * Keys given to #[] are compared with the PostgreSQL representation of
+ * the column values: Strings are compared byte by byte, all other objects
+ * are converted per +to_s+ before. Rows with a NULL key are not indexed.
+ *
+ * The index refers to the memory of the result, so that the result must
+ * not be cleared, while the index is used.
+ *
+ * Example:
+ *    res = conn.exec("SELECT * FROM (VALUES (1, 'a'), (2, 'b'), (1, 'c')) AS t(id, v)")
+ *    idx = res.index_by("id")
+ *    idx[1]        # => #<PG::Tuple id: "1", v: "c">
+ *    idx["2"]["v"] # => "b"
+ *    res.group_by(:id)[1].map{|t| t["v"] }  # => ["a", "c"]
+ */
+
+VALUE rb_cPG_ResultIndex;
+
+typedef struct {
+	const char *ptr;
+	int len;
+} t_pg_index_key;
+
+typedef struct {
+	/* PG::Result object the index refers to */
+	VALUE result;
+	/* Column number of the key */
+	int column;
+	/* 1 if created by group_by, 0 by index_by */
+	int group;
+	/* Raw key bytes -> group number */
+	st_table *table;
+	/* Number of distinct keys */
+	int ngroups;
+	/* Raw key bytes of each group in insertion order */
+	t_pg_index_key *keys;
+	/* First and last row number and number of rows of each group */
+	int *first_row;
+	int *last_row;
+	int *num_rows;
+	/* Next row of the same group for each row or -1 */
+	int *next_row;
+} t_pg_result_index;
+
+static int
+pg_index_key_cmp( st_data_t a, st_data_t b )
+{
+	t_pg_index_key *ka = (t_pg_index_key *)a;
+	t_pg_index_key *kb = (t_pg_index_key *)b;
+
+	return ka->len != kb->len || memcmp(ka->ptr, kb->ptr, ka->len);
+}
+
+static st_index_t
+pg_index_key_hash( st_data_t a )
+{
+	t_pg_index_key *ka = (t_pg_index_key *)a;
+
+	return rb_memhash( ka->ptr, ka->len );
+}
+
+static const struct st_hash_type pg_index_key_type = {
+	pg_index_key_cmp,
+	pg_index_key_hash,
+};
+
+static void
+pg_result_index_gc_mark( t_pg_result_index *this )
+{
+	if( !this ) return;
+	rb_gc_mark( this->result );
+}
+
+static void
+pg_result_index_gc_free( t_pg_result_index *this )
+{
+	if( !this ) return;
+	if( this->table )
+		st_free_table( this->table );
+	xfree( this->keys );
+	xfree( this->first_row );
+	xfree( this->last_row );
+	xfree( this->num_rows );
+	xfree( this->next_row );
+	xfree( this );
+}
+
+/*
+ * Document-method: allocate
+ *
+ * call-seq:
+ *   PG::Result::Index.allocate -> obj
+ */
+static VALUE
+pg_result_index_s_allocate( VALUE klass )
+{
+	return Data_Wrap_Struct( klass, pg_result_index_gc_mark, pg_result_index_gc_free, NULL );
+}
+
+static t_pg_result_index *
+pg_result_index_get_this( VALUE self )
+{
+	t_pg_result_index *this = DATA_PTR(self);
+
+	if( this == NULL )
+		rb_raise( rb_eTypeError, "index is empty" );
+	/* The keys point into the PGresult. */
+	if( pgresult_get_this(this->result)->pgresult == NULL )
+		rb_raise( rb_ePGerror, "result has been cleared" );
+
+	return this;
+}
+
+static VALUE
+pg_result_index_new( VALUE result, VALUE column, int group )
+{
+	VALUE self = pg_result_index_s_allocate( rb_cPG_ResultIndex );
+	PGresult *pgresult = pgresult_get( result );
+	int ntuples = PQntuples( pgresult );
+	int col = pg_result_field_number( result, column );
+	t_pg_result_index *this;
+	int row;
+
+	/* Required by the PG::Tuple objects returned later on. */
+	pg_result_init_field_map( result );
+
+	this = xmalloc( sizeof(*this) );
+	memset( this, 0, sizeof(*this) );
+	this->result = result;
+	this->column = col;
+	this->group = group;
+	DATA_PTR(self) = this;
+
+	this->table = st_init_table( &pg_index_key_type );
+	this->keys = ALLOC_N( t_pg_index_key, ntuples );
+	this->first_row = ALLOC_N( int, ntuples );
+	this->last_row = ALLOC_N( int, ntuples );
+	this->num_rows = ALLOC_N( int, ntuples );
+	this->next_row = ALLOC_N( int, ntuples );
+
+	for( row = 0; row < ntuples; row++ ){
+		t_pg_index_key key;
+		st_data_t group_num;
+
+		this->next_row[row] = -1;
+		if( PQgetisnull(pgresult, row, col) )
+			continue;
+
+		key.ptr = PQgetvalue( pgresult, row, col );
+		key.len = PQgetlength( pgresult, row, col );
+
+		if( st_lookup(this->table, (st_data_t)&key, &group_num) ){
+			this->next_row[this->last_row[group_num]] = row;
+			this->last_row[group_num] = row;
+			this->num_rows[group_num]++;
+		} else {
+			int g = this->ngroups++;
+			this->keys[g] = key;
+			this->first_row[g] = row;
+			this->last_row[g] = row;
+			this->num_rows[g] = 1;
+			st_insert( this->table, (st_data_t)&this->keys[g], (st_data_t)g );
+		}
+	}
+
+	return self;
+}
+
+/*
+ * Look up the group number of a Ruby key or return -1.
+ */
+static int
+pg_result_index_lookup( t_pg_result_index *this, VALUE key )
+{
+	t_pg_index_key index_key;
+	st_data_t group_num;
+
+	if( NIL_P(key) )
+		return -1;
+	if( !RB_TYPE_P(key, T_STRING) )
+		key = rb_obj_as_string( key );
+
+	index_key.ptr = RSTRING_PTR( key );
+	index_key.len = (int)RSTRING_LEN( key );
+
+	if( !st_lookup(this->table, (st_data_t)&index_key, &group_num) )
+		return -1;
+	return (int)group_num;
+}
+
+/*
+ * Build the value of a group: the last row for index_by and an
+ * Array of all rows for group_by .
+ */
+static VALUE
+pg_result_index_group_value( t_pg_result_index *this, int g )
+{
+	VALUE tuples;
+	int row;
+
+	if( !this->group )
+		return pg_tuple_new( this->result, this->last_row[g] );
+
+	tuples = rb_ary_new2( this->num_rows[g] );
+	for( row = this->first_row[g]; row >= 0; row = this->next_row[row] ){
+		rb_ary_push( tuples, pg_tuple_new(this->result, row) );
+	}
+	return tuples;
+}
+
+/*
+ * call-seq:
+ *    idx[ key ] -> PG::Tuple, Array or nil
+ *
+ * Returns the row with the given key as PG::Tuple .
+ * If several rows have this key, the last one is returned.
+ *
+ * For an index created by PG::Result#group_by it returns an Array of
+ * PG::Tuple objects of all rows with this key.
+ *
+ * Returns +nil+ if the key is not found.
+ */
+static VALUE
+pg_result_index_aref( VALUE self, VALUE key )
+{
+	t_pg_result_index *this = pg_result_index_get_this( self );
+	int g = pg_result_index_lookup( this, key );
+
+	return g < 0 ? Qnil : pg_result_index_group_value( this, g );
+}
+
+/*
+ * call-seq:
+ *    idx.key?( key ) -> Boolean
+ *
+ * Returns +true+ if at least one row with the given key exists.
+ */
+static VALUE
+pg_result_index_key_p( VALUE self, VALUE key )
+{
+	t_pg_result_index *this = pg_result_index_get_this( self );
+
+	return pg_result_index_lookup( this, key ) < 0 ? Qfalse : Qtrue;
+}
+
+/*
+ * call-seq:
+ *    idx.size -> Integer
+ *
+ * Returns the number of distinct keys.
+ */
+static VALUE
+pg_result_index_size( VALUE self )
+{
+	t_pg_result_index *this = pg_result_index_get_this( self );
+
+	return INT2NUM( this->ngroups );
+}
+
+static VALUE
+pg_result_index_key( t_pg_result_index *this, int g )
+{
+	t_pg_result *p_result = pgresult_get_this( this->result );
+
+	return p_result->p_typemap->funcs.typecast_result_value( p_result->p_typemap, this->result, this->first_row[g], this->column );
+}
+
+/*
+ * call-seq:
+ *    idx.keys -> Array
+ *
+ * Returns all distinct keys in the order of their first occurrence.
+ * The keys are decoded by the type map of the result.
+ */
+static VALUE
+pg_result_index_keys( VALUE self )
+{
+	t_pg_result_index *this = pg_result_index_get_this( self );
+	VALUE keys = rb_ary_new2( this->ngroups );
+	int g;
+
+	for( g = 0; g < this->ngroups; g++ ){
+		rb_ary_store( keys, g, pg_result_index_key(this, g) );
+	}
+	return keys;
+}
+
+static VALUE
+pg_result_index_size_for_enum( VALUE self, VALUE args, VALUE eobj )
+{
+	return pg_result_index_size( self );
+}
+
+/*
+ * call-seq:
+ *    idx.each{ |key, value| ... }
+ *
+ * Yields each key together with its row or rows, like #[] returns them.
+ * The keys are decoded by the type map of the result.
+ */
+static VALUE
+pg_result_index_each( VALUE self )
+{
+	t_pg_result_index *this;
+	int g;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pg_result_index_size_for_enum);
+
+	this = pg_result_index_get_this( self );
+	for( g = 0; g < this->ngroups; g++ ){
+		rb_yield_values( 2, pg_result_index_key(this, g), pg_result_index_group_value(this, g) );
+	}
+	return self;
+}
+
+/*
+ * call-seq:
+ *    idx.result -> PG::Result
+ *
+ * Returns the result the index was built from.
+ */
+static VALUE
+pg_result_index_result( VALUE self )
+{
+	t_pg_result_index *this = DATA_PTR(self);
+
+	return this ? this->result : Qnil;
+}
+
+/*
+ * call-seq:
+ *    res.index_by( column ) -> PG::Result::Index
+ *    res.index_by{ |row| ... } -> Hash
+ *
+ * Builds a hash index over the raw values of +column+ , which can be given
+ * as column number or field name.
+ *
+ * This is a fast replacement of:
+ *   res.each_with_object({}){|row, h| h[row["id"]] = row }
+ *
+ * See PG::Result::Index for details.
+ *
+ * Without +column+ it calls the index_by method of the ancestors, like
+ * Enumerable#index_by of ActiveSupport.
+ */
+static VALUE
+pgresult_index_by( int argc, VALUE *argv, VALUE self )
+{
+	VALUE column;
+
+	if( argc == 0 )
+		return rb_call_super( argc, argv );
+
+	rb_scan_args( argc, argv, "10", &column );
+	return pg_result_index_new( self, column, 0 );
+}
+
+/*
+ * call-seq:
+ *    res.group_by( column ) -> PG::Result::Index
+ *    res.group_by{ |row| ... } -> Hash
+ *
+ * Builds a hash index over the raw values of +column+ , which returns all
+ * rows of a given key.
+ *
+ * See PG::Result::Index for details.
+ *
+ * Without +column+ it behaves like Enumerable#group_by .
+ */
+static VALUE
+pgresult_group_by( int argc, VALUE *argv, VALUE self )
+{
+	VALUE column;
+
+	if( argc == 0 )
+		return rb_call_super( argc, argv );
+
+	rb_scan_args( argc, argv, "10", &column );
+	return pg_result_index_new( self, column, 1 );
+}
+
+void
+init_pg_result_index()
+{
+	rb_cPG_ResultIndex = rb_define_class_under( rb_cPGresult, "Index", rb_cObject );
+	rb_define_alloc_func( rb_cPG_ResultIndex, pg_result_index_s_allocate );
+	rb_undef_method( CLASS_OF(rb_cPG_ResultIndex), "new" );
+	rb_include_module( rb_cPG_ResultIndex, rb_mEnumerable );
+
+	rb_define_method( rb_cPG_ResultIndex, "[]", pg_result_index_aref, 1 );
+	rb_define_method( rb_cPG_ResultIndex, "key?", pg_result_index_key_p, 1 );
+	rb_define_alias( rb_cPG_ResultIndex, "include?", "key?" );
+	rb_define_method( rb_cPG_ResultIndex, "size", pg_result_index_size, 0 );
+	rb_define_alias( rb_cPG_ResultIndex, "length", "size" );
+	rb_define_method( rb_cPG_ResultIndex, "keys", pg_result_index_keys, 0 );
+	rb_define_method( rb_cPG_ResultIndex, "each", pg_result_index_each, 0 );
+	rb_define_method( rb_cPG_ResultIndex, "result", pg_result_index_result, 0 );
+
+	rb_define_method( rb_cPGresult, "index_by", pgresult_index_by, -1 );
+	rb_define_method( rb_cPGresult, "group_by", pgresult_group_by, -1 );
+}
@@ -0,0 +1,673 @@
+/*
+ * pg_result_view.c - PG::Result::View class extension
+ * $Id$
+ *
+ */
+
+#include "pg.h"
+#include "util.h"
+#include <errno.h>
+
+/********************************************************************
+ *
+ * Document-class: PG::Result::View
+ *
+ * A subset of the rows of a PG::Result .
+ * An instance of this class is created by PG::Result#where .
+ *
+ * The view holds only a reference to the result and the numbers of the
+ * matching rows. It provides the iteration methods of PG::Result , so that
+ * only the rows of the view are decoded.
+ *
+ * Example:
+ *    res = conn.exec("SELECT * FROM (VALUES (1, 'a'), (2, 'b'), (3, 'c')) AS t(id, v)")
+ *    view = res.where('id', '>', 1)
+ *    view.rows        # => [1, 2]
+ *    view.values      # => [["2", "b"], ["3", "c"]]
+ *    view.where('v', '=', 'c').to_a  # => [{"id"=>"3", "v"=>"c"}]
+ */
+
+VALUE rb_cPG_ResultView;
+
+typedef enum {
+	VIEW_OP_EQ,
+	VIEW_OP_NE,
+	VIEW_OP_LT,
+	VIEW_OP_LE,
+	VIEW_OP_GT,
+	VIEW_OP_GE,
+	VIEW_OP_IN,
+	VIEW_OP_NULL,
+	VIEW_OP_NOT_NULL,
+	VIEW_OP_PREFIX
+} t_view_op;
+
+static const struct {
+	const char *name;
+	t_view_op op;
+} view_ops[] = {
+	{ "=", VIEW_OP_EQ },
+	{ "==", VIEW_OP_EQ },
+	{ "!=", VIEW_OP_NE },
+	{ "<>", VIEW_OP_NE },
+	{ "<", VIEW_OP_LT },
+	{ "<=", VIEW_OP_LE },
+	{ ">", VIEW_OP_GT },
+	{ ">=", VIEW_OP_GE },
+	{ "in", VIEW_OP_IN },
+	{ "is null", VIEW_OP_NULL },
+	{ "is_null", VIEW_OP_NULL },
+	{ "is not null", VIEW_OP_NOT_NULL },
+	{ "not_null", VIEW_OP_NOT_NULL },
+	{ "prefix", VIEW_OP_PREFIX },
+};
+
+/* A value to compare the column values with */
+typedef struct {
+	int numeric;
+	int is_int;
+	int64_t i;
+	double d;
+	const char *ptr;
+	long len;
+} t_view_operand;
+
+typedef struct {
+	/* PG::Result object the view refers to */
+	VALUE result;
+	/* Matching row numbers in ascending order */
+	int *rows;
+	long nrows;
+} t_pg_result_view;
+
+static void
+pg_result_view_gc_mark( t_pg_result_view *this )
+{
+	rb_gc_mark( this->result );
+}
+
+static void
+pg_result_view_gc_free( t_pg_result_view *this )
+{
+	xfree( this->rows );
+	xfree( this );
+}
+
+/*
+ * Document-method: allocate
+ *
+ * call-seq:
+ *   PG::Result::View.allocate -> obj
+ */
+static VALUE
+pg_result_view_s_allocate( VALUE klass )
+{
+	t_pg_result_view *this;
+	VALUE self = Data_Make_Struct( klass, t_pg_result_view, pg_result_view_gc_mark, pg_result_view_gc_free, this );
+
+	this->result = Qnil;
+	return self;
+}
+
+static t_pg_result_view *
+pg_result_view_get_this( VALUE self )
+{
+	t_pg_result_view *this;
+	Data_Get_Struct( self, t_pg_result_view, this );
+
+	if( NIL_P(this->result) )
+		rb_raise( rb_eTypeError, "view is empty" );
+	/* Raise a proper exception instead of accessing a cleared PGresult. */
+	pgresult_get( this->result );
+
+	return this;
+}
+
+static t_view_op
+pg_result_view_op( VALUE op )
+{
+	const char *name;
+	size_t i;
+
+	if( SYMBOL_P(op) )
+		op = rb_sym2str( op );
+	name = StringValueCStr( op );
+
+	for( i = 0; i < sizeof(view_ops) / sizeof(*view_ops); i++ ){
+		if( STRCASECMP(name, view_ops[i].name) == 0 )
+			return view_ops[i].op;
+	}
+	rb_raise( rb_eArgError, "unsupported operator %s", RSTRING_PTR(rb_inspect(op)) );
+}
+
+/*
+ * Prepare +value+ for comparison. Numeric values are compared numerically,
+ * all others by the bytes of their String representation.
+ * The String is appended to +keep+ to protect it from GC.
+ */
+static void
+pg_result_view_operand( VALUE value, t_view_operand *p_operand, VALUE keep )
+{
+	memset( p_operand, 0, sizeof(*p_operand) );
+
+	if( NIL_P(value) ){
+		rb_raise( rb_eArgError, "comparison with nil never matches - use 'IS NULL' instead" );
+	} else if( FIXNUM_P(value) || RB_TYPE_P(value, T_BIGNUM) ){
+		p_operand->numeric = 1;
+		if( FIXNUM_P(value) || rb_big_cmp(value, LL2NUM(INT64_MAX)) != INT2FIX(1) ){
+			if( FIXNUM_P(value) || rb_big_cmp(value, LL2NUM(INT64_MIN)) != INT2FIX(-1) ){
+				p_operand->is_int = 1;
+				p_operand->i = NUM2LL( value );
+			}
+		}
+		p_operand->d = NUM2DBL( value );
+	} else if( RB_TYPE_P(value, T_FLOAT) ){
+		p_operand->numeric = 1;
+		p_operand->d = RFLOAT_VALUE( value );
+	} else {
+		VALUE str = rb_obj_as_string( value );
+		rb_ary_push( keep, str );
+		p_operand->ptr = RSTRING_PTR( str );
+		p_operand->len = RSTRING_LEN( str );
+	}
+}
+
+/*
+ * Parse a column value as number.
+ * Sets *p_is_int if the value is an integer stored in *p_int ,
+ * otherwise the value is stored in *p_float .
+ */
+static void
+pg_result_view_parse_number( PGresult *pgresult, int row, int col, int *p_is_int, int64_t *p_int, double *p_float )
+{
+	char *val = PQgetvalue( pgresult, row, col );
+	int len = PQgetlength( pgresult, row, col );
+
+	if( PQfformat(pgresult, col) == 0 ){
+		char *end;
+		long long i;
+
+		/* strtoll() accepts leading spaces, which PostgreSQL never emits. */
+		errno = 0;
+		i = strtoll( val, &end, 10 );
+		if( end != val && *end == 0 && errno == 0 ){
+			*p_is_int = 1;
+			*p_int = i;
+			return;
+		}
+		*p_float = strtod( val, &end );
+		if( end != val && *end == 0 ){
+			*p_is_int = 0;
+			return;
+		}
+	} else {
+		Oid type = PQftype( pgresult, col );
+		union { float f; int32_t i; } swap4;
+		union { double f; int64_t i; } swap8;
+
+		/* Binary values must be typed by OID, since other types can have the same lengths. */
+		switch( type ){
+			case 20: case 21: case 23:
+				*p_is_int = 1;
+				break;
+			case 700: case 701:
+				*p_is_int = 0;
+				break;
+			default:
+				rb_raise( rb_eArgError, "can not compare binary column %s of type OID %u with a number", PQfname(pgresult, col), (unsigned)type );
+		}
+		switch( len ){
+			case 2:
+				*p_int = read_nbo16( val );
+				return;
+			case 4:
+				if( *p_is_int ){
+					*p_int = read_nbo32( val );
+				} else {
+					swap4.i = read_nbo32( val );
+					*p_float = swap4.f;
+				}
+				return;
+			case 8:
+				if( *p_is_int ){
+					*p_int = read_nbo64( val );
+				} else {
+					swap8.i = read_nbo64( val );
+					*p_float = swap8.f;
+				}
+				return;
+		}
+	}
+	rb_raise( rb_eArgError, "can not compare non numeric value at row %d with a number", row );
+}
+
+/*
+ * Compare the value at +row+ and +col+ with +p_operand+ .
+ * Returns <0, 0 or >0 like memcmp() or 2 if the values are not comparable (NaN).
+ */
+static int
+pg_result_view_compare( PGresult *pgresult, int row, int col, t_view_operand *p_operand )
+{
+	if( p_operand->numeric ){
+		int is_int;
+		int64_t i = 0;
+		double d = 0.0;
+
+		pg_result_view_parse_number( pgresult, row, col, &is_int, &i, &d );
+		if( is_int && p_operand->is_int )
+			return i < p_operand->i ? -1 : i > p_operand->i ? 1 : 0;
+		if( is_int )
+			d = (double)i;
+		if( d < p_operand->d ) return -1;
+		if( d > p_operand->d ) return 1;
+		if( d == p_operand->d ) return 0;
+		return 2;
+	} else {
+		long len = PQgetlength( pgresult, row, col );
+		int cmp = memcmp( PQgetvalue(pgresult, row, col), p_operand->ptr, len < p_operand->len ? len : p_operand->len );
+
+		if( cmp != 0 ) return cmp < 0 ? -1 : 1;
+		return len < p_operand->len ? -1 : len > p_operand->len ? 1 : 0;
+	}
+}
+
+static int
+pg_result_view_match( PGresult *pgresult, int row, int col, t_view_op op, t_view_operand *operands, long noperands )
+{
+	long i;
+	int cmp;
+
+	if( PQgetisnull(pgresult, row, col) )
+		return op == VIEW_OP_NULL;
+
+	switch( op ){
+		case VIEW_OP_NULL:
+			return 0;
+		case VIEW_OP_NOT_NULL:
+			return 1;
+		case VIEW_OP_PREFIX:
+			return PQgetlength(pgresult, row, col) >= operands[0].len &&
+					memcmp( PQgetvalue(pgresult, row, col), operands[0].ptr, operands[0].len ) == 0;
+		case VIEW_OP_IN:
+			for( i = 0; i < noperands; i++ ){
+				if( pg_result_view_compare(pgresult, row, col, &operands[i]) == 0 )
+					return 1;
+			}
+			return 0;
+		default:
+			break;
+	}
+
+	cmp = pg_result_view_compare( pgresult, row, col, &operands[0] );
+	switch( op ){
+		case VIEW_OP_EQ: return cmp == 0;
+		case VIEW_OP_NE: return cmp != 0 && cmp != 2;
+		case VIEW_OP_LT: return cmp == -1;
+		case VIEW_OP_LE: return cmp == -1 || cmp == 0;
+		case VIEW_OP_GT: return cmp == 1;
+		case VIEW_OP_GE: return cmp == 1 || cmp == 0;
+		default: return 0;
+	}
+}
+
+/*
+ * Build a view of all rows of +result+ out of +rows+ (or all rows if NULL),
+ * which match the condition given in +argv+ .
+ */
+static VALUE
+pg_result_view_filter( VALUE result, const int *rows, long nrows, int argc, VALUE *argv )
+{
+	PGresult *pgresult = pgresult_get( result );
+	VALUE column, op_in, value;
+	VALUE keep = rb_ary_new();
+	VALUE operands_buf;
+	VALUE self = pg_result_view_s_allocate( rb_cPG_ResultView );
+	t_pg_result_view *this = DATA_PTR( self );
+	t_view_op op;
+	t_view_operand *operands;
+	long noperands = 1;
+	long i, n = 0;
+	int col;
+
+	rb_scan_args( argc, argv, "21", &column, &op_in, &value );
+	col = pg_result_field_number( result, column );
+	op = pg_result_view_op( op_in );
+
+	switch( op ){
+		case VIEW_OP_NULL:
+		case VIEW_OP_NOT_NULL:
+			if( argc > 2 )
+				rb_raise( rb_eArgError, "operator %s takes no value", RSTRING_PTR(rb_inspect(op_in)) );
+			noperands = 0;
+			break;
+		case VIEW_OP_IN:
+			value = rb_Array( value );
+			noperands = RARRAY_LEN( value );
+			break;
+		default:
+			if( argc < 3 )
+				rb_raise( rb_eArgError, "operator %s requires a value", RSTRING_PTR(rb_inspect(op_in)) );
+	}
+
+	/* The operands are stored in a String, so that they are freed in case of exceptions. */
+	operands_buf = rb_str_new( NULL, sizeof(t_view_operand) * (noperands > 0 ? noperands : 1) );
+	rb_ary_push( keep, operands_buf );
+	operands = (t_view_operand *)RSTRING_PTR( operands_buf );
+
+	if( op == VIEW_OP_IN ){
+		long num_values = noperands;
+		noperands = 0;
+		for( i = 0; i < num_values; i++ ){
+			VALUE element = rb_ary_entry( value, i );
+			/* NULL is never equal to anything. */
+			if( !NIL_P(element) )
+				pg_result_view_operand( element, &operands[noperands++], keep );
+		}
+	} else if( noperands > 0 ){
+		pg_result_view_operand( value, &operands[0], keep );
+		if( op == VIEW_OP_PREFIX && operands[0].numeric )
+			rb_raise( rb_eArgError, "prefix match requires a String" );
+	}
+
+	this->result = result;
+	if( !rows )
+		nrows = PQntuples( pgresult );
+	this->rows = ALLOC_N( int, nrows > 0 ? nrows : 1 );
+
+	for( i = 0; i < nrows; i++ ){
+		int row = rows ? rows[i] : (int)i;
+		if( pg_result_view_match(pgresult, row, col, op, operands, noperands) )
+			this->rows[n++] = row;
+	}
+	this->nrows = n;
+
+	RB_GC_GUARD( keep );
+	return self;
+}
+
+/*
+ * call-seq:
+ *    res.where( column, operator, value ) -> PG::Result::View
+ *    res.where( column, operator ) -> PG::Result::View
+ *
+ * Returns a view of all rows, whose value of +column+ satisfies the given condition.
+ * The condition is evaluated on the raw values of the PGresult, without decoding them.
+ * +column+ can be given as column number or field name.
+ *
+ * Supported operators are:
+ * * <tt>=</tt> , <tt>!=</tt> , <tt><</tt> , <tt><=</tt> , <tt>></tt> , <tt>>=</tt>
+ * * +IN+ - +value+ is an Array of allowed values
+ * * <tt>IS NULL</tt> , <tt>IS NOT NULL</tt> - no +value+ is given
+ * * +PREFIX+ - the column value starts with the String +value+
+ *
+ * If +value+ is an Integer or Float, the column values are compared numerically.
+ * They must be integer or float values in text format or columns of type
+ * int2, int4, int8, float4 or float8 in binary format then.
+ * All other objects are converted per +to_s+ and are compared byte by byte
+ * with the column values.
+ *
+ * Like in SQL, NULL values match +IS NULL+ only.
+ *
+ *    res.where('score', '>', 2.5).each{|row| ... }
+ *    res.where(:state, 'IN', %w[new open]).values
+ */
+static VALUE
+pgresult_where( int argc, VALUE *argv, VALUE self )
+{
+	return pg_result_view_filter( self, NULL, 0, argc, argv );
+}
+
+/*
+ * call-seq:
+ *    view.where( column, operator, value ) -> PG::Result::View
+ *
+ * Filter the rows of the view further. See PG::Result#where .
+ */
+static VALUE
+pg_result_view_where( int argc, VALUE *argv, VALUE self )
+{
+	t_pg_result_view *this = pg_result_view_get_this( self );
+
+	return pg_result_view_filter( this->result, this->rows, this->nrows, argc, argv );
+}
+
+/*
+ * call-seq:
+ *    view.result -> PG::Result
+ *
+ * Returns the result the view refers to.
+ */
+static VALUE
+pg_result_view_result( VALUE self )
+{
+	return pg_result_view_get_this( self )->result;
+}
+
+/*
+ * call-seq:
+ *    view.rows -> Array
+ *
+ * Returns the row numbers of the matching rows within the result.
+ */
+static VALUE
+pg_result_view_rows( VALUE self )
+{
+	t_pg_result_view *this = pg_result_view_get_this( self );
+	VALUE rows = rb_ary_new2( this->nrows );
+	long i;
+
+	for( i = 0; i < this->nrows; i++ ){
+		rb_ary_store( rows, i, INT2FIX(this->rows[i]) );
+	}
+	return rows;
+}
+
+/*
+ * call-seq:
+ *    view.ntuples -> Integer
+ *
+ * Returns the number of matching rows.
+ */
+static VALUE
+pg_result_view_ntuples( VALUE self )
+{
+	return LONG2NUM( pg_result_view_get_this(self)->nrows );
+}
+
+static VALUE
+pg_result_view_ntuples_for_enum( VALUE self, VALUE args, VALUE eobj )
+{
+	return pg_result_view_ntuples( self );
+}
+
+static int
+pg_result_view_row( t_pg_result_view *this, VALUE index )
+{
+	long i = NUM2LONG( index );
+
+	if( i < 0 || i >= this->nrows )
+		rb_raise( rb_eIndexError, "Index %ld is out of range", i );
+	return this->rows[i];
+}
+
+/*
+ * call-seq:
+ *    view[ n ] -> Hash
+ *
+ * Returns the nth row of the view as Hash.
+ */
+static VALUE
+pg_result_view_aref( VALUE self, VALUE index )
+{
+	t_pg_result_view *this = pg_result_view_get_this( self );
+
+	return pg_result_tuple_hash( this->result, pg_result_view_row(this, index) );
+}
+
+/*
+ * call-seq:
+ *    view.tuple( n ) -> PG::Tuple
+ *
+ * Returns the nth row of the view as PG::Tuple .
+ */
+static VALUE
+pg_result_view_tuple( VALUE self, VALUE index )
+{
+	t_pg_result_view *this = pg_result_view_get_this( self );
+	int row = pg_result_view_row( this, index );
+
+	pg_result_init_field_map( this->result );
+	return pg_tuple_new( this->result, row );
+}
+
+/*
+ * call-seq:
+ *    view.each{ |tuple| ... }
+ *
+ * Invokes block for each row of the view. The row is given as Hash.
+ */
+static VALUE
+pg_result_view_each( VALUE self )
+{
+	t_pg_result_view *this;
+	long i;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pg_result_view_ntuples_for_enum);
+
+	this = pg_result_view_get_this( self );
+	for( i = 0; i < this->nrows; i++ ){
+		rb_yield( pg_result_tuple_hash(this->result, this->rows[i]) );
+	}
+	return self;
+}
+
+/*
+ * call-seq:
+ *    view.each_row{ |row| ... }
+ *
+ * Yields each row of the view as Array of values.
+ */
+static VALUE
+pg_result_view_each_row( VALUE self )
+{
+	t_pg_result_view *this;
+	int nfields;
+	long i;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pg_result_view_ntuples_for_enum);
+
+	this = pg_result_view_get_this( self );
+	nfields = PQnfields( pgresult_get(this->result) );
+	for( i = 0; i < this->nrows; i++ ){
+		rb_yield( pg_result_tuple_values(this->result, this->rows[i], nfields) );
+	}
+	return self;
+}
+
+/*
+ * call-seq:
+ *    view.each_tuple{ |tuple| ... }
+ *
+ * Yields each row of the view as PG::Tuple .
+ */
+static VALUE
+pg_result_view_each_tuple( VALUE self )
+{
+	t_pg_result_view *this;
+	long i;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pg_result_view_ntuples_for_enum);
+
+	this = pg_result_view_get_this( self );
+	pg_result_init_field_map( this->result );
+	for( i = 0; i < this->nrows; i++ ){
+		rb_yield( pg_tuple_new(this->result, this->rows[i]) );
+	}
+	return self;
+}
+
+/*
+ * call-seq:
+ *    view.values -> Array
+ *
+ * Returns all rows of the view as an Array of Arrays.
+ */
+static VALUE
+pg_result_view_values( VALUE self )
+{
+	t_pg_result_view *this = pg_result_view_get_this( self );
+	int nfields = PQnfields( pgresult_get(this->result) );
+	VALUE results = rb_ary_new2( this->nrows );
+	long i;
+
+	for( i = 0; i < this->nrows; i++ ){
+		rb_ary_store( results, i, pg_result_tuple_values(this->result, this->rows[i], nfields) );
+	}
+	return results;
+}
+
+/*
+ * call-seq:
+ *    view.field_values( field ) -> Array
+ *
+ * Returns an Array of the values of the given _field_ of each row of the view.
+ * _field_ can be given as column number or field name.
+ */
+static VALUE
+pg_result_view_field_values( VALUE self, VALUE field )
+{
+	t_pg_result_view *this = pg_result_view_get_this( self );
+	t_pg_result *p_result = pgresult_get_this( this->result );
+	int col = pg_result_field_number( this->result, field );
+	VALUE results = rb_ary_new2( this->nrows );
+	long i;
+
+	for( i = 0; i < this->nrows; i++ ){
+		rb_ary_store( results, i, p_result->p_typemap->funcs.typecast_result_value(p_result->p_typemap, this->result, this->rows[i], col) );
+	}
+	return results;
+}
+
+/*
+ * call-seq:
+ *    view.aggregate( field, op ) -> Integer, Float, BigDecimal, Time or nil
+ *
+ * Computes the aggregate _op_ over the values of the given _field_ of the
+ * rows of the view. See PG::Result#aggregate .
+ */
+static VALUE
+pg_result_view_aggregate( VALUE self, VALUE field, VALUE op )
+{
+	t_pg_result_view *this = pg_result_view_get_this( self );
+
+	return pg_result_aggregate( this->result, this->rows, this->nrows, field, op );
+}
+
+
+void
+init_pg_result_view()
+{
+	rb_cPG_ResultView = rb_define_class_under( rb_cPGresult, "View", rb_cObject );
+	rb_define_alloc_func( rb_cPG_ResultView, pg_result_view_s_allocate );
+	rb_undef_method( CLASS_OF(rb_cPG_ResultView), "new" );
+	rb_include_module( rb_cPG_ResultView, rb_mEnumerable );
+
+	rb_define_method( rb_cPG_ResultView, "where", pg_result_view_where, -1 );
+	rb_define_method( rb_cPG_ResultView, "result", pg_result_view_result, 0 );
+	rb_define_method( rb_cPG_ResultView, "rows", pg_result_view_rows, 0 );
+	rb_define_method( rb_cPG_ResultView, "ntuples", pg_result_view_ntuples, 0 );
+	rb_define_alias( rb_cPG_ResultView, "num_tuples", "ntuples" );
+	rb_define_alias( rb_cPG_ResultView, "size", "ntuples" );
+	rb_define_alias( rb_cPG_ResultView, "length", "ntuples" );
+	rb_define_method( rb_cPG_ResultView, "[]", pg_result_view_aref, 1 );
+	rb_define_method( rb_cPG_ResultView, "tuple", pg_result_view_tuple, 1 );
+	rb_define_method( rb_cPG_ResultView, "each", pg_result_view_each, 0 );
+	rb_define_method( rb_cPG_ResultView, "each_row", pg_result_view_each_row, 0 );
+	rb_define_method( rb_cPG_ResultView, "each_tuple", pg_result_view_each_tuple, 0 );
+	rb_define_method( rb_cPG_ResultView, "values", pg_result_view_values, 0 );
+	rb_define_method( rb_cPG_ResultView, "field_values", pg_result_view_field_values, 1 );
+	rb_define_alias( rb_cPG_ResultView, "column_values", "field_values" );
+	rb_define_method( rb_cPG_ResultView, "aggregate", pg_result_view_aggregate, 2 );
+
+	rb_define_method( rb_cPGresult, "where", pgresult_where, -1 );
+}
@@ -0,0 +1,384 @@
+/*
+ * pg_result_writer.c - CSV and JSON-lines serialization of PG::Result
+ * $Id$
+ *
+ * The values are read from the PGresult, escaped into a reusable output
+ * buffer and written per IO#write in chunks, without creating Ruby objects
+ * per value.
+ */
+
+#include "pg.h"
+
+/* The output buffer is written to the IO, when it exceeds this size. */
+#define WRITER_CHUNK_SIZE 65536
+
+/* OIDs of types with a dedicated JSON representation */
+#define PG_OID_BOOL 16
+#define PG_OID_INT8 20
+#define PG_OID_INT2 21
+#define PG_OID_INT4 23
+#define PG_OID_OID 26
+#define PG_OID_JSON 114
+#define PG_OID_FLOAT4 700
+#define PG_OID_FLOAT8 701
+#define PG_OID_NUMERIC 1700
+#define PG_OID_JSONB 3802
+
+enum pg_json_kind {
+	JSON_STRING,
+	JSON_NUMBER,
+	JSON_BOOL,
+	JSON_RAW,
+};
+
+typedef struct {
+	VALUE io;
+	VALUE buffer;
+	char *current;
+	char *end;
+	int enc_idx;
+} t_result_writer;
+
+static ID s_id_write;
+static VALUE sym_headers;
+
+
+static void
+pg_writer_init( t_result_writer *this, VALUE result, VALUE io )
+{
+	this->io = io;
+	this->enc_idx = ENCODING_GET( result );
+	PG_RB_STR_NEW( this->buffer, this->current, this->end );
+	this->current = pg_rb_str_ensure_capa( this->buffer, WRITER_CHUNK_SIZE, this->current, &this->end );
+}
+
+static void
+pg_writer_flush( t_result_writer *this )
+{
+	long len = this->current - RSTRING_PTR(this->buffer);
+	VALUE chunk;
+
+	if( len == 0 )
+		return;
+
+	chunk = rb_str_new( RSTRING_PTR(this->buffer), len );
+	PG_ENCODING_SET_NOCHECK( chunk, this->enc_idx );
+	this->current = RSTRING_PTR(this->buffer);
+	rb_funcall( this->io, s_id_write, 1, chunk );
+}
+
+/*
+ * Write the buffer, after a complete row was added.
+ * Chunks are cut at row boundaries only, so that multibyte characters are
+ * never split across two IO#write calls.
+ */
+static void
+pg_writer_end_row( t_result_writer *this )
+{
+	if( this->current - RSTRING_PTR(this->buffer) >= WRITER_CHUNK_SIZE )
+		pg_writer_flush( this );
+}
+
+static void
+pg_writer_append( t_result_writer *this, const char *ptr, long len )
+{
+	PG_RB_STR_ENSURE_CAPA( this->buffer, len, this->current, this->end );
+	memcpy( this->current, ptr, len );
+	this->current += len;
+}
+
+static void
+pg_writer_check_text_format( PGresult *pgresult )
+{
+	int field;
+	int nfields = PQnfields( pgresult );
+
+	for( field = 0; field < nfields; field++ ){
+		if( PQfformat(pgresult, field) != 0 )
+			rb_raise( rb_eArgError, "column %d is in binary format - only text format is supported", field );
+	}
+}
+
+
+/*
+ * CSV
+ */
+
+static void
+pg_writer_append_csv( t_result_writer *this, const char *val, int len )
+{
+	int i;
+	int needs_quotes = len == 0;
+	char *out;
+
+	for( i = 0; i < len && !needs_quotes; i++ ){
+		switch( val[i] ){
+			case ',': case '"': case '\r': case '\n':
+				needs_quotes = 1;
+		}
+	}
+
+	if( !needs_quotes ){
+		pg_writer_append( this, val, len );
+		return;
+	}
+
+	/* worst case: all characters are quotes; computed as long, since
+	 * doubling a value above 1 GB overflows int */
+	PG_RB_STR_ENSURE_CAPA( this->buffer, 2 * (long)len + 2, this->current, this->end );
+	out = this->current;
+	*out++ = '"';
+	for( i = 0; i < len; i++ ){
+		if( val[i] == '"' ) *out++ = '"';
+		*out++ = val[i];
+	}
+	*out++ = '"';
+	this->current = out;
+}
+
+/*
+ * call-seq:
+ *    res.write_csv( io, headers: true ) -> self
+ *
+ * Writes all rows of the result as CSV to +io+ .
+ *
+ * The first line contains the field names, unless <tt>headers: false</tt>
+ * is given. Fields are separated by comma and rows are terminated by LF.
+ * Values containing comma, quote or line breaks are enclosed in double
+ * quotes. NULL values are written as empty field, while empty strings are
+ * written as <tt>""</tt> , like COPY in CSV format does.
+ *
+ * The values are written in their PostgreSQL text representation, without
+ * converting them through the type map of the result. Output is collected in
+ * a buffer and written in chunks per <tt>io.write</tt> .
+ * The result must not contain binary format columns.
+ *
+ * Example:
+ *    res = conn.exec("SELECT 1 AS a, 'x,y' AS b")
+ *    res.write_csv($stdout)
+ *    # a,b
+ *    # 1,"x,y"
+ */
+static VALUE
+pgresult_write_csv( int argc, VALUE *argv, VALUE self )
+{
+	PGresult *pgresult = pgresult_get( self );
+	t_result_writer writer;
+	VALUE io, opts;
+	int headers = 1;
+	int nfields = PQnfields( pgresult );
+	int ntuples = PQntuples( pgresult );
+	int row, field;
+
+	rb_scan_args( argc, argv, "11", &io, &opts );
+	if( !NIL_P(opts) ){
+		Check_Type( opts, T_HASH );
+		if( rb_hash_lookup2(opts, sym_headers, Qtrue) == Qfalse )
+			headers = 0;
+	}
+	pg_writer_check_text_format( pgresult );
+	pg_writer_init( &writer, self, io );
+
+	if( headers ){
+		for( field = 0; field < nfields; field++ ){
+			const char *fname = PQfname( pgresult, field );
+			if( field > 0 ) pg_writer_append( &writer, ",", 1 );
+			pg_writer_append_csv( &writer, fname, (int)strlen(fname) );
+		}
+		pg_writer_append( &writer, "\n", 1 );
+	}
+
+	for( row = 0; row < ntuples; row++ ){
+		for( field = 0; field < nfields; field++ ){
+			if( field > 0 ) pg_writer_append( &writer, ",", 1 );
+			if( !PQgetisnull(pgresult, row, field) )
+				pg_writer_append_csv( &writer, PQgetvalue(pgresult, row, field), PQgetlength(pgresult, row, field) );
+		}
+		pg_writer_append( &writer, "\n", 1 );
+		pg_writer_end_row( &writer );
+	}
+	pg_writer_flush( &writer );
+
+	RB_GC_GUARD( writer.buffer );
+	return self;
+}
+
+
+/*
+ * JSON lines
+ */
+
+static void
+pg_writer_append_json_string( t_result_writer *this, const char *val, int len )
+{
+	static const char hex[] = "0123456789abcdef";
+	const char *start = val;
+	const char *stop = val + len;
+	const char *ptr;
+
+	pg_writer_append( this, "\"", 1 );
+	for( ptr = val; ptr < stop; ptr++ ){
+		unsigned char c = (unsigned char)*ptr;
+		char esc[6];
+		int esc_len = 2;
+
+		if( c >= 0x20 && c != '"' && c != '\\' )
+			continue;
+
+		esc[0] = '\\';
+		switch( c ){
+			case '"': esc[1] = '"'; break;
+			case '\\': esc[1] = '\\'; break;
+			case '\b': esc[1] = 'b'; break;
+			case '\f': esc[1] = 'f'; break;
+			case '\n': esc[1] = 'n'; break;
+			case '\r': esc[1] = 'r'; break;
+			case '\t': esc[1] = 't'; break;
+			default:
+				esc[1] = 'u';
+				esc[2] = '0';
+				esc[3] = '0';
+				esc[4] = hex[c >> 4];
+				esc[5] = hex[c & 0xf];
+				esc_len = 6;
+		}
+		pg_writer_append( this, start, ptr - start );
+		pg_writer_append( this, esc, esc_len );
+		start = ptr + 1;
+	}
+	pg_writer_append( this, start, stop - start );
+	pg_writer_append( this, "\"", 1 );
+}
+
+static enum pg_json_kind
+pg_writer_json_kind( Oid oid )
+{
+	switch( oid ){
+		case PG_OID_BOOL:
+			return JSON_BOOL;
+		case PG_OID_INT2:
+		case PG_OID_INT4:
+		case PG_OID_INT8:
+		case PG_OID_OID:
+		case PG_OID_FLOAT4:
+		case PG_OID_FLOAT8:
+		case PG_OID_NUMERIC:
+			return JSON_NUMBER;
+		case PG_OID_JSON:
+		case PG_OID_JSONB:
+			return JSON_RAW;
+		default:
+			return JSON_STRING;
+	}
+}
+
+/*
+ * call-seq:
+ *    res.write_jsonl( io ) -> self
+ *
+ * Writes all rows of the result as JSON lines to +io+ .
+ *
+ * Each row is written as one JSON object with the field names as keys,
+ * terminated by LF.
+ * Values of numeric types are written as JSON numbers, except NaN and
+ * Infinity, which are written as strings. +bool+ values are written as
+ * +true+ or +false+ and values of type +json+ and +jsonb+ are embedded as is.
+ * All other values are written as JSON strings and NULL values as +null+ .
+ *
+ * The values are taken from the PostgreSQL text representation, without
+ * converting them through the type map of the result. Output is collected in
+ * a buffer and written in chunks per <tt>io.write</tt> .
+ * The result must not contain binary format columns.
+ *
+ * Example:
+ *    res = conn.exec("SELECT 1 AS a, 'x' AS b, NULL AS c")
+ *    res.write_jsonl($stdout)
+ *    # {"a":1,"b":"x","c":null}
+ */
+static VALUE
+pgresult_write_jsonl( VALUE self, VALUE io )
+{
+	PGresult *pgresult = pgresult_get( self );
+	t_result_writer writer;
+	VALUE keys;
+	int nfields = PQnfields( pgresult );
+	int ntuples = PQntuples( pgresult );
+	int row, field;
+	PG_VARIABLE_LENGTH_ARRAY(long, key_offsets, nfields + 1, PG_MAX_COLUMNS + 1)
+	PG_VARIABLE_LENGTH_ARRAY(enum pg_json_kind, kinds, nfields, PG_MAX_COLUMNS)
+
+	pg_writer_check_text_format( pgresult );
+
+	/* Escape the keys once per result, including separators:
+	 * '{"a":' for the first field and ',"b":' for subsequent fields. */
+	pg_writer_init( &writer, self, io );
+	for( field = 0; field < nfields; field++ ){
+		const char *fname = PQfname( pgresult, field );
+		key_offsets[field] = writer.current - RSTRING_PTR(writer.buffer);
+		pg_writer_append( &writer, field == 0 ? "{" : ",", 1 );
+		pg_writer_append_json_string( &writer, fname, (int)strlen(fname) );
+		pg_writer_append( &writer, ":", 1 );
+		kinds[field] = pg_writer_json_kind( PQftype(pgresult, field) );
+	}
+	key_offsets[nfields] = writer.current - RSTRING_PTR(writer.buffer);
+	keys = rb_str_new( RSTRING_PTR(writer.buffer), key_offsets[nfields] );
+	writer.current = RSTRING_PTR(writer.buffer);
+
+	for( row = 0; row < ntuples; row++ ){
+		if( nfields == 0 )
+			pg_writer_append( &writer, "{", 1 );
+
+		for( field = 0; field < nfields; field++ ){
+			const char *val;
+			int len;
+
+			pg_writer_append( &writer, RSTRING_PTR(keys) + key_offsets[field], key_offsets[field + 1] - key_offsets[field] );
+
+			if( PQgetisnull(pgresult, row, field) ){
+				pg_writer_append( &writer, "null", 4 );
+				continue;
+			}
+			val = PQgetvalue( pgresult, row, field );
+			len = PQgetlength( pgresult, row, field );
+
+			switch( kinds[field] ){
+				case JSON_BOOL:
+					if( val[0] == 't' )
+						pg_writer_append( &writer, "true", 4 );
+					else
+						pg_writer_append( &writer, "false", 5 );
+					break;
+				case JSON_NUMBER:
+					/* NaN, Infinity and -Infinity are not valid JSON numbers */
+					if( val[0] == 'N' || val[0] == 'I' || (val[0] == '-' && val[1] == 'I') )
+						pg_writer_append_json_string( &writer, val, len );
+					else
+						pg_writer_append( &writer, val, len );
+					break;
+				case JSON_RAW:
+					pg_writer_append( &writer, val, len );
+					break;
+				default:
+					pg_writer_append_json_string( &writer, val, len );
+			}
+		}
+		pg_writer_append( &writer, "}\n", 2 );
+		pg_writer_end_row( &writer );
+	}
+	pg_writer_flush( &writer );
+
+	RB_GC_GUARD( keys );
+	RB_GC_GUARD( writer.buffer );
+	return self;
+}
+
+
+void
+init_pg_result_writer()
+{
+	s_id_write = rb_intern("write");
+	sym_headers = ID2SYM(rb_intern("headers"));
+
+	rb_define_method(rb_cPGresult, "write_csv", pgresult_write_csv, -1);
+	rb_define_method(rb_cPGresult, "write_jsonl", pgresult_write_jsonl, 1);
+}
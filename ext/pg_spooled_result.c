@@ -0,0 +1,980 @@
+/*
+ * pg_spooled_result.c - PG::SpooledResult class extension
+ * $Id$
+ *
+ */
+
+#include "pg.h"
+#include <fcntl.h>
+#include <errno.h>
+#ifdef HAVE_SYS_MMAN_H
+#	include <sys/mman.h>
+#endif
+
+/********************************************************************
+ *
+ * Document-class: PG::SpooledResult
+ *
+ * A query result, which is stored in a file instead of the process memory.
+ * An instance of this class is created by PG::Connection#exec_to_spool or
+ * by PG::SpooledResult.new .
+ *
+ * The rows are received in single row or chunked rows mode and are written
+ * to the spool file while they are transferred. The file is organized in
+ * segments of up to 65536 rows, which store the values column by column.
+ * After the transfer, the file is mapped into memory, so that the values
+ * are paged in on demand by the operating system and the resident memory
+ * stays constant regardless of the size of the result.
+ *
+ * The spool file uses the native byte order and is meant as temporary
+ * storage of the running process only.
+ *
+ * The read API follows PG::Result :
+ *    conn = PG.connect(dbname: 'test')
+ *    res = conn.exec_to_spool("SELECT generate_series(1, 100000000) AS n")
+ *    res.ntuples        # => 100000000
+ *    res.getvalue(5, 0) # => "6"
+ *    res.each{|row| p row }  # {"n"=>"1"}, ...
+ *
+ * Values are decoded per PG::TypeMapByColumn assigned by #type_map= .
+ * Columns without a decoder are returned as Strings like PG::TypeMapAllStrings does.
+ */
+
+VALUE rb_cPG_SpooledResult;
+
+/* Flush the current segment when one of these limits is reached.
+ * The row limit is lowered for wide results, so that the per row buffers
+ * of all columns don't exceed SPOOL_SEGMENT_BYTES either. */
+#define SPOOL_SEGMENT_ROWS 65536
+#define SPOOL_SEGMENT_BYTES (16 * 1024 * 1024)
+
+#define SPOOL_ALIGN8(n) (((n) + 7) & ~(uint64_t)7)
+
+/*
+ * Layout of a segment within the spool file:
+ *   uint64_t nrows
+ *   uint64_t column_offset[nfields]   (relative to the segment start)
+ * followed by each column:
+ *   uint64_t offsets[nrows + 1]       (relative to the column data)
+ *   char     nulls[nrows]             (padded to 8 bytes)
+ *   char     data[]                   (each value NUL terminated, padded to 8 bytes)
+ */
+typedef struct {
+	uint64_t *offsets;
+	char *nulls;
+	char *data;
+	size_t data_len;
+	size_t data_capa;
+} t_spool_column;
+
+typedef struct {
+	/* PG::Result with the field descriptions but without tuples */
+	VALUE result;
+	/* Array of field names */
+	VALUE fields;
+	/* Path of the spool file or nil for an anonymous temporary file */
+	VALUE path;
+	/* PG::TypeMapByColumn or nil */
+	VALUE typemap;
+	/* PG::TypeMapByColumn built from the default_type_map of typemap or nil */
+	VALUE default_colmap;
+	/* Prefilled Hash with field names as keys */
+	VALUE tuple_hash;
+
+	/* 0 while spooling, 1 when readable, 2 when closed */
+	int state;
+	int fd;
+	int nfields;
+	int enc_idx;
+	int *fformats;
+	long ntuples;
+
+	char *map;
+	size_t map_size;
+
+	long nsegments;
+	long segments_capa;
+	long *seg_first_row;
+	uint64_t *seg_offset;
+
+	/* Buffers of the current segment, only while spooling */
+	t_spool_column *columns;
+	long seg_rows;
+	long seg_max_rows;
+	size_t seg_bytes;
+	uint64_t file_size;
+} t_pg_spooled_result;
+
+typedef struct {
+	long first_row;
+	long nrows;
+	char *base;
+} t_spool_segment;
+
+
+static void
+pg_spooled_result_free_columns( t_pg_spooled_result *this )
+{
+	int i;
+
+	if( !this->columns ) return;
+	for( i = 0; i < this->nfields; i++ ){
+		xfree( this->columns[i].offsets );
+		xfree( this->columns[i].nulls );
+		xfree( this->columns[i].data );
+	}
+	xfree( this->columns );
+	this->columns = NULL;
+}
+
+static void
+pg_spooled_result_unmap( t_pg_spooled_result *this )
+{
+#ifdef HAVE_SYS_MMAN_H
+	if( this->map )
+		munmap( this->map, this->map_size );
+#endif
+	this->map = NULL;
+	if( this->fd >= 0 )
+		close( this->fd );
+	this->fd = -1;
+}
+
+static void
+pg_spooled_result_gc_mark( t_pg_spooled_result *this )
+{
+	rb_gc_mark( this->result );
+	rb_gc_mark( this->fields );
+	rb_gc_mark( this->path );
+	rb_gc_mark( this->typemap );
+	rb_gc_mark( this->default_colmap );
+	rb_gc_mark( this->tuple_hash );
+}
+
+static void
+pg_spooled_result_gc_free( t_pg_spooled_result *this )
+{
+	pg_spooled_result_unmap( this );
+	pg_spooled_result_free_columns( this );
+	xfree( this->fformats );
+	xfree( this->seg_first_row );
+	xfree( this->seg_offset );
+	xfree( this );
+}
+
+/*
+ * Document-method: allocate
+ *
+ * call-seq:
+ *   PG::SpooledResult.allocate -> obj
+ */
+static VALUE
+pg_spooled_result_s_allocate( VALUE klass )
+{
+	t_pg_spooled_result *this;
+	VALUE self = Data_Make_Struct( klass, t_pg_spooled_result, pg_spooled_result_gc_mark, pg_spooled_result_gc_free, this );
+
+	this->result = Qnil;
+	this->fields = Qnil;
+	this->path = Qnil;
+	this->typemap = Qnil;
+	this->default_colmap = Qnil;
+	this->tuple_hash = Qnil;
+	this->fd = -1;
+
+	return self;
+}
+
+static t_pg_spooled_result *
+pg_spooled_result_get_this( VALUE self )
+{
+	t_pg_spooled_result *this;
+	Data_Get_Struct( self, t_pg_spooled_result, this );
+
+	if( this->state == 0 )
+		rb_raise( rb_ePGerror, "spooled result is not initialized" );
+	if( this->state == 2 )
+		rb_raise( rb_ePGerror, "spooled result has been closed" );
+
+	return this;
+}
+
+
+/*
+ * Write +len+ bytes to the spool file.
+ */
+static void
+spool_write( t_pg_spooled_result *this, const void *ptr, size_t len )
+{
+	const char *p = ptr;
+
+	while( len > 0 ){
+		ssize_t written = write( this->fd, p, len );
+		if( written < 0 ){
+			if( errno == EINTR ) continue;
+			rb_sys_fail( NIL_P(this->path) ? "spool file" : StringValueCStr(this->path) );
+		}
+		p += written;
+		len -= written;
+	}
+	this->file_size += (uint64_t)(p - (const char *)ptr);
+}
+
+static void
+spool_write_padding( t_pg_spooled_result *this, size_t len )
+{
+	static const char zeros[8];
+
+	if( SPOOL_ALIGN8(len) != len )
+		spool_write( this, zeros, SPOOL_ALIGN8(len) - len );
+}
+
+static void
+spool_flush_segment( t_pg_spooled_result *this )
+{
+	long nrows = this->seg_rows;
+	uint64_t header_size = sizeof(uint64_t) * (1 + this->nfields);
+	uint64_t col_offset = header_size;
+	int i;
+
+	if( nrows == 0 ) return;
+
+	if( this->nsegments == this->segments_capa ){
+		this->segments_capa = this->segments_capa ? this->segments_capa * 2 : 16;
+		REALLOC_N( this->seg_first_row, long, this->segments_capa );
+		REALLOC_N( this->seg_offset, uint64_t, this->segments_capa );
+	}
+	this->seg_first_row[this->nsegments] = this->ntuples;
+	this->seg_offset[this->nsegments] = this->file_size;
+	this->nsegments++;
+
+	{
+		PG_VARIABLE_LENGTH_ARRAY(uint64_t, header, this->nfields + 1, PG_MAX_COLUMNS + 1)
+
+		header[0] = nrows;
+		for( i = 0; i < this->nfields; i++ ){
+			header[1 + i] = col_offset;
+			col_offset += sizeof(uint64_t) * (nrows + 1) + SPOOL_ALIGN8(nrows) + SPOOL_ALIGN8(this->columns[i].data_len);
+		}
+		spool_write( this, header, header_size );
+	}
+
+	for( i = 0; i < this->nfields; i++ ){
+		t_spool_column *col = &this->columns[i];
+
+		spool_write( this, col->offsets, sizeof(uint64_t) * (nrows + 1) );
+		spool_write( this, col->nulls, nrows );
+		spool_write_padding( this, nrows );
+		spool_write( this, col->data, col->data_len );
+		spool_write_padding( this, col->data_len );
+		col->data_len = 0;
+	}
+
+	this->ntuples += nrows;
+	this->seg_rows = 0;
+	this->seg_bytes = 0;
+}
+
+/*
+ * Callback of pg_result_stream_any() : append all rows of the current
+ * PGresult to the segment buffers.
+ */
+static void
+spool_yield_rows( VALUE result, int ntuples, int nfields, void *data )
+{
+	t_pg_spooled_result *this = data;
+	PGresult *pgresult = pgresult_get( result );
+	int row, i;
+
+	for( row = 0; row < ntuples; row++ ){
+		long seg_row = this->seg_rows;
+
+		for( i = 0; i < nfields; i++ ){
+			t_spool_column *col = &this->columns[i];
+
+			if( PQgetisnull(pgresult, row, i) ){
+				col->nulls[seg_row] = 1;
+			} else {
+				size_t len = PQgetlength( pgresult, row, i );
+
+				if( col->data_len + len + 1 > col->data_capa ){
+					col->data_capa = (col->data_len + len + 1) * 2;
+					REALLOC_N( col->data, char, col->data_capa );
+				}
+				/* Copy the terminating NUL byte as well, like PQgetvalue() provides it. */
+				memcpy( col->data + col->data_len, PQgetvalue(pgresult, row, i), len + 1 );
+				col->data_len += len + 1;
+				col->nulls[seg_row] = 0;
+				this->seg_bytes += len + 1;
+			}
+			col->offsets[seg_row + 1] = col->data_len;
+		}
+
+		if( ++this->seg_rows == this->seg_max_rows || this->seg_bytes >= SPOOL_SEGMENT_BYTES )
+			spool_flush_segment( this );
+	}
+}
+
+static void
+pg_spooled_result_open( t_pg_spooled_result *this )
+{
+#ifdef HAVE_SYS_MMAN_H
+	if( NIL_P(this->path) ){
+		VALUE tmpdir;
+		VALUE template;
+
+		rb_require( "tmpdir" );
+		tmpdir = rb_funcall( rb_cDir, rb_intern("tmpdir"), 0 );
+		template = rb_str_plus( tmpdir, rb_str_new_cstr("/pg_spool.XXXXXX") );
+		this->fd = mkstemp( StringValueCStr(template) );
+		if( this->fd < 0 )
+			rb_sys_fail( RSTRING_PTR(template) );
+		/* The file is removed while it's still open, so that it is
+		 * released by the system in any case. */
+		unlink( RSTRING_PTR(template) );
+	} else
+#endif
+	{
+		this->fd = open( StringValueCStr(this->path), O_RDWR | O_CREAT | O_TRUNC, 0600 );
+		if( this->fd < 0 )
+			rb_sys_fail( RSTRING_PTR(this->path) );
+	}
+}
+
+static void
+pg_spooled_result_map( t_pg_spooled_result *this )
+{
+	if( this->file_size > 0 ){
+#ifdef HAVE_SYS_MMAN_H
+		/* Writable private mapping, since decoders take non-const pointers.
+		 * Changes are never written back to the file. */
+		void *map = mmap( NULL, this->file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, this->fd, 0 );
+		if( map == MAP_FAILED )
+			rb_sys_fail( "mmap" );
+		this->map = map;
+		this->map_size = this->file_size;
+#endif
+	}
+	close( this->fd );
+	this->fd = -1;
+}
+
+/*
+ * call-seq:
+ *    PG::SpooledResult.new( result, path=nil )
+ *
+ * Retrieve all rows of +result+ and store them in the spool file +path+ .
+ *
+ * +result+ should be retrieved in single row or chunked rows mode, so that
+ * the remaining rows are received from the server while they are spooled.
+ * It is processed like PG::Result#stream_each does.
+ * A regular PG::Result is accepted as well and its rows are copied to the spool file.
+ *
+ * If +path+ is +nil+ , an anonymous temporary file is used, which is removed
+ * from the file system immediately.
+ * Otherwise the file at +path+ is created or truncated and is kept after
+ * the spooled result has been closed.
+ */
+static VALUE
+pg_spooled_result_init( int argc, VALUE *argv, VALUE self )
+{
+	t_pg_spooled_result *this;
+	VALUE result, path;
+	PGresult *pgresult;
+	int i;
+
+	rb_scan_args( argc, argv, "11", &result, &path );
+	Data_Get_Struct( self, t_pg_spooled_result, this );
+
+#ifndef HAVE_SYS_MMAN_H
+	rb_raise( rb_eNotImpError, "PG::SpooledResult requires mmap()" );
+#endif
+	if( this->state != 0 || this->columns )
+		rb_raise( rb_ePGerror, "spooled result is already initialized" );
+	if( !rb_obj_is_kind_of(result, rb_cPGresult) )
+		rb_raise( rb_eTypeError, "wrong argument type %s (expected PG::Result)", rb_obj_classname(result) );
+
+	pgresult = pgresult_get( result );
+	if( !NIL_P(path) )
+		path = rb_str_new4( rb_get_path(path) );
+	this->path = path;
+	this->nfields = PQnfields( pgresult );
+	this->enc_idx = ENCODING_GET( result );
+	this->fformats = ALLOC_N( int, this->nfields );
+	for( i = 0; i < this->nfields; i++ ){
+		this->fformats[i] = PQfformat( pgresult, i );
+	}
+
+	/* Each column needs an offset and a NULL flag per row of the segment. */
+	this->seg_max_rows = SPOOL_SEGMENT_ROWS;
+	if( this->nfields > 0 ){
+		long max_rows = (long)(SPOOL_SEGMENT_BYTES / (sizeof(uint64_t) + 1)) / this->nfields;
+		if( this->seg_max_rows > max_rows )
+			this->seg_max_rows = max_rows;
+	}
+
+	this->columns = ALLOC_N( t_spool_column, this->nfields );
+	memset( this->columns, 0, sizeof(*this->columns) * this->nfields );
+	for( i = 0; i < this->nfields; i++ ){
+		this->columns[i].offsets = ALLOC_N( uint64_t, this->seg_max_rows + 1 );
+		this->columns[i].offsets[0] = 0;
+		this->columns[i].nulls = ALLOC_N( char, this->seg_max_rows );
+	}
+
+	pg_spooled_result_open( this );
+
+	if( PQresultStatus(pgresult) == PGRES_TUPLES_OK ){
+		spool_yield_rows( result, PQntuples(pgresult), this->nfields, this );
+	} else {
+		pg_result_stream_any( result, spool_yield_rows, this );
+	}
+	spool_flush_segment( this );
+	pg_spooled_result_free_columns( this );
+	pg_spooled_result_map( this );
+
+	/* The result now holds the final PGresult of the query, which
+	 * describes the fields, but doesn't contain any tuples. */
+	this->result = result;
+	this->fields = rb_obj_freeze( rb_funcall(result, rb_intern("fields"), 0) );
+	this->state = 1;
+
+	return self;
+}
+
+static void
+pg_spooled_result_segment( t_pg_spooled_result *this, long seg, t_spool_segment *p_seg )
+{
+	p_seg->first_row = this->seg_first_row[seg];
+	p_seg->base = this->map + this->seg_offset[seg];
+	p_seg->nrows = (long)((uint64_t *)p_seg->base)[0];
+}
+
+static long
+pg_spooled_result_find_segment( t_pg_spooled_result *this, long row )
+{
+	long lo = 0, hi = this->nsegments - 1;
+
+	while( lo < hi ){
+		long mid = (lo + hi + 1) / 2;
+		if( this->seg_first_row[mid] <= row )
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+/*
+ * Retrieve the value of row +row+ (relative to the segment) and field +field+ .
+ * Returns NULL for NULL values.
+ */
+static char *
+pg_spooled_result_raw_value( t_pg_spooled_result *this, t_spool_segment *p_seg, long row, int field, int *p_len )
+{
+	uint64_t col_offset = ((uint64_t *)p_seg->base)[1 + field];
+	uint64_t *offsets = (uint64_t *)(p_seg->base + col_offset);
+	char *nulls = (char *)(offsets + p_seg->nrows + 1);
+	char *data = nulls + SPOOL_ALIGN8(p_seg->nrows);
+
+	if( nulls[row] )
+		return NULL;
+
+	*p_len = (int)(offsets[row + 1] - offsets[row] - 1);
+	return data + offsets[row];
+}
+
+static VALUE
+pg_spooled_result_value( t_pg_spooled_result *this, t_spool_segment *p_seg, long row, int field )
+{
+	t_pg_coder *p_coder = NULL;
+	t_pg_coder_dec_func dec_func;
+	int len;
+	char *val = pg_spooled_result_raw_value( this, p_seg, row, field, &len );
+	int tuple = (int)(p_seg->first_row + row);
+
+	if( val == NULL )
+		return Qnil;
+
+	if( !NIL_P(this->typemap) )
+		p_coder = ((t_tmbc *)DATA_PTR(this->typemap))->convs[field].cconv;
+	if( !p_coder && !NIL_P(this->default_colmap) )
+		p_coder = ((t_tmbc *)DATA_PTR(this->default_colmap))->convs[field].cconv;
+
+	if( p_coder ){
+		dec_func = p_coder->dec_func;
+		if( !dec_func )
+			dec_func = pg_coder_dec_func( p_coder, this->fformats[field] );
+		if( p_coder->memo )
+			return pg_coder_dec_memo( p_coder, dec_func, val, len, tuple, field, this->enc_idx );
+		return dec_func( p_coder, val, len, tuple, field, this->enc_idx );
+	}
+
+	if( this->fformats[field] == 0 )
+		return pg_text_dec_string( NULL, val, len, tuple, field, this->enc_idx );
+	else
+		return pg_bin_dec_bytea( NULL, val, len, tuple, field, this->enc_idx );
+}
+
+static long
+pg_spooled_result_check_row( t_pg_spooled_result *this, VALUE row_num )
+{
+	long row = NUM2LONG( row_num );
+
+	if( row < 0 || row >= this->ntuples )
+		rb_raise( rb_eIndexError, "Index %ld is out of range", row );
+	return row;
+}
+
+static int
+pg_spooled_result_check_field( t_pg_spooled_result *this, VALUE field_num )
+{
+	int field = NUM2INT( field_num );
+
+	if( field < 0 || field >= this->nfields )
+		rb_raise( rb_eArgError, "invalid field number %d", field );
+	return field;
+}
+
+/*
+ * call-seq:
+ *    res.ntuples -> Integer
+ *
+ * Returns the number of tuples in the spooled result.
+ */
+static VALUE
+pg_spooled_result_ntuples( VALUE self )
+{
+	return LONG2NUM( pg_spooled_result_get_this(self)->ntuples );
+}
+
+static VALUE
+pg_spooled_result_ntuples_for_enum( VALUE self, VALUE args, VALUE eobj )
+{
+	return pg_spooled_result_ntuples( self );
+}
+
+/*
+ * call-seq:
+ *    res.nfields -> Integer
+ *
+ * Returns the number of columns in the spooled result.
+ */
+static VALUE
+pg_spooled_result_nfields( VALUE self )
+{
+	return INT2NUM( pg_spooled_result_get_this(self)->nfields );
+}
+
+/*
+ * call-seq:
+ *    res.fields -> Array
+ *
+ * Returns an array of Strings representing the names of the fields in the result.
+ */
+static VALUE
+pg_spooled_result_fields( VALUE self )
+{
+	return pg_spooled_result_get_this(self)->fields;
+}
+
+/*
+ * call-seq:
+ *    res.result -> PG::Result
+ *
+ * Returns a PG::Result without tuples, which describes the fields
+ * of the spooled result. It can be used to retrieve PG::Result#ftype ,
+ * PG::Result#fmod and so on.
+ */
+static VALUE
+pg_spooled_result_result( VALUE self )
+{
+	return pg_spooled_result_get_this(self)->result;
+}
+
+/*
+ * call-seq:
+ *    res.path -> String or nil
+ *
+ * Returns the path of the spool file or +nil+ for an anonymous temporary file.
+ */
+static VALUE
+pg_spooled_result_path( VALUE self )
+{
+	t_pg_spooled_result *this;
+	Data_Get_Struct( self, t_pg_spooled_result, this );
+
+	return this->path;
+}
+
+/*
+ * call-seq:
+ *    res.getvalue( tup_num, field_num ) -> value
+ *
+ * Returns the value in tuple number _tup_num_, field _field_num_,
+ * or +nil+ if the field is +NULL+.
+ */
+static VALUE
+pg_spooled_result_getvalue( VALUE self, VALUE tup_num, VALUE field_num )
+{
+	t_pg_spooled_result *this = pg_spooled_result_get_this( self );
+	long row = pg_spooled_result_check_row( this, tup_num );
+	int field = pg_spooled_result_check_field( this, field_num );
+	t_spool_segment seg;
+
+	pg_spooled_result_segment( this, pg_spooled_result_find_segment(this, row), &seg );
+	return pg_spooled_result_value( this, &seg, row - seg.first_row, field );
+}
+
+/*
+ * call-seq:
+ *    res.getisnull( tup_num, field_num ) -> Boolean
+ *
+ * Returns +true+ if the specified value is +nil+; +false+ otherwise.
+ */
+static VALUE
+pg_spooled_result_getisnull( VALUE self, VALUE tup_num, VALUE field_num )
+{
+	t_pg_spooled_result *this = pg_spooled_result_get_this( self );
+	long row = pg_spooled_result_check_row( this, tup_num );
+	int field = pg_spooled_result_check_field( this, field_num );
+	t_spool_segment seg;
+	int len;
+
+	pg_spooled_result_segment( this, pg_spooled_result_find_segment(this, row), &seg );
+	return pg_spooled_result_raw_value( this, &seg, row - seg.first_row, field, &len ) ? Qfalse : Qtrue;
+}
+
+/*
+ * call-seq:
+ *    res.getlength( tup_num, field_num ) -> Integer
+ *
+ * Returns the (String) length of the field in bytes.
+ */
+static VALUE
+pg_spooled_result_getlength( VALUE self, VALUE tup_num, VALUE field_num )
+{
+	t_pg_spooled_result *this = pg_spooled_result_get_this( self );
+	long row = pg_spooled_result_check_row( this, tup_num );
+	int field = pg_spooled_result_check_field( this, field_num );
+	t_spool_segment seg;
+	int len = 0;
+
+	pg_spooled_result_segment( this, pg_spooled_result_find_segment(this, row), &seg );
+	pg_spooled_result_raw_value( this, &seg, row - seg.first_row, field, &len );
+	return INT2FIX( len );
+}
+
+static VALUE
+pg_spooled_result_row_array( t_pg_spooled_result *this, t_spool_segment *p_seg, long row )
+{
+	int field;
+	PG_VARIABLE_LENGTH_ARRAY(VALUE, row_values, this->nfields, PG_MAX_COLUMNS)
+
+	for( field = 0; field < this->nfields; field++ ){
+		row_values[field] = pg_spooled_result_value( this, p_seg, row, field );
+	}
+	return rb_ary_new4( this->nfields, row_values );
+}
+
+static VALUE
+pg_spooled_result_row_hash( t_pg_spooled_result *this, t_spool_segment *p_seg, long row )
+{
+	VALUE tuple;
+	int field;
+
+	if( NIL_P(this->tuple_hash) ){
+		tuple = rb_hash_new();
+		for( field = 0; field < this->nfields; field++ ){
+			rb_hash_aset( tuple, rb_ary_entry(this->fields, field), Qnil );
+		}
+		this->tuple_hash = tuple;
+	}
+
+	tuple = rb_hash_dup( this->tuple_hash );
+	for( field = 0; field < this->nfields; field++ ){
+		rb_hash_aset( tuple, rb_ary_entry(this->fields, field), pg_spooled_result_value(this, p_seg, row, field) );
+	}
+	return tuple;
+}
+
+/*
+ * call-seq:
+ *    res[ n ] -> Hash
+ *
+ * Returns tuple _n_ as a hash.
+ */
+static VALUE
+pg_spooled_result_aref( VALUE self, VALUE index )
+{
+	t_pg_spooled_result *this = pg_spooled_result_get_this( self );
+	long row = pg_spooled_result_check_row( this, index );
+	t_spool_segment seg;
+
+	pg_spooled_result_segment( this, pg_spooled_result_find_segment(this, row), &seg );
+	return pg_spooled_result_row_hash( this, &seg, row - seg.first_row );
+}
+
+/*
+ * call-seq:
+ *    res.each{ |tuple| ... }
+ *
+ * Invokes block for each tuple in the result set.
+ * The tuple is a Hash with field names as keys.
+ */
+static VALUE
+pg_spooled_result_each( VALUE self )
+{
+	t_pg_spooled_result *this;
+	long s, row;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pg_spooled_result_ntuples_for_enum);
+
+	this = pg_spooled_result_get_this( self );
+	for( s = 0; s < this->nsegments; s++ ){
+		t_spool_segment seg;
+
+		pg_spooled_result_segment( this, s, &seg );
+		for( row = 0; row < seg.nrows; row++ ){
+			rb_yield( pg_spooled_result_row_hash(this, &seg, row) );
+			/* The block could have closed the spooled result. */
+			this = pg_spooled_result_get_this( self );
+		}
+	}
+	return self;
+}
+
+/*
+ * call-seq:
+ *    res.each_row{ |row| ... }
+ *
+ * Yields each row of the result. The row is an Array of column values.
+ */
+static VALUE
+pg_spooled_result_each_row( VALUE self )
+{
+	t_pg_spooled_result *this;
+	long s, row;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pg_spooled_result_ntuples_for_enum);
+
+	this = pg_spooled_result_get_this( self );
+	for( s = 0; s < this->nsegments; s++ ){
+		t_spool_segment seg;
+
+		pg_spooled_result_segment( this, s, &seg );
+		for( row = 0; row < seg.nrows; row++ ){
+			rb_yield( pg_spooled_result_row_array(this, &seg, row) );
+			this = pg_spooled_result_get_this( self );
+		}
+	}
+	return self;
+}
+
+/*
+ * call-seq:
+ *    res.values -> Array
+ *
+ * Returns all tuples as an array of arrays.
+ *
+ * Note: This loads the whole result into memory.
+ * Prefer #each_row or #column_values for large results.
+ */
+static VALUE
+pg_spooled_result_values( VALUE self )
+{
+	t_pg_spooled_result *this = pg_spooled_result_get_this( self );
+	VALUE results = rb_ary_new2( this->ntuples );
+	long s, row;
+
+	for( s = 0; s < this->nsegments; s++ ){
+		t_spool_segment seg;
+
+		pg_spooled_result_segment( this, s, &seg );
+		for( row = 0; row < seg.nrows; row++ ){
+			rb_ary_push( results, pg_spooled_result_row_array(this, &seg, row) );
+		}
+	}
+	return results;
+}
+
+static VALUE
+pg_spooled_result_column_array( t_pg_spooled_result *this, int field )
+{
+	VALUE results = rb_ary_new2( this->ntuples );
+	long s, row;
+
+	for( s = 0; s < this->nsegments; s++ ){
+		t_spool_segment seg;
+
+		pg_spooled_result_segment( this, s, &seg );
+		for( row = 0; row < seg.nrows; row++ ){
+			rb_ary_push( results, pg_spooled_result_value(this, &seg, row, field) );
+		}
+	}
+	return results;
+}
+
+/*
+ * call-seq:
+ *    res.column_values( n ) -> Array
+ *
+ * Returns an Array of the values from the nth column of each tuple in the result.
+ * Since the values are stored column-wise, only the data of this column is read.
+ */
+static VALUE
+pg_spooled_result_column_values( VALUE self, VALUE index )
+{
+	t_pg_spooled_result *this = pg_spooled_result_get_this( self );
+	int field = NUM2INT( index );
+
+	if( field < 0 || field >= this->nfields )
+		rb_raise( rb_eIndexError, "no column %d in result", field );
+	return pg_spooled_result_column_array( this, field );
+}
+
+/*
+ * call-seq:
+ *    res.field_values( field ) -> Array
+ *
+ * Returns an Array of the values from the given _field_ of each tuple in the result.
+ */
+static VALUE
+pg_spooled_result_field_values( VALUE self, VALUE field )
+{
+	t_pg_spooled_result *this = pg_spooled_result_get_this( self );
+	VALUE fname = SYMBOL_P(field) ? rb_sym2str( field ) : field;
+	VALUE fnum = rb_funcall( this->fields, rb_intern("index"), 1, fname );
+
+	if( NIL_P(fnum) )
+		rb_raise( rb_eIndexError, "no such field %s in result", RSTRING_PTR(rb_inspect(field)) );
+	return pg_spooled_result_column_array( this, NUM2INT(fnum) );
+}
+
+/*
+ * Convert +typemap+ to a PG::TypeMapByColumn fitting to the fields of the
+ * result or to +nil+ , if all values are retrieved as Strings.
+ */
+static VALUE
+pg_spooled_result_column_map( t_pg_spooled_result *this, VALUE typemap )
+{
+	if( NIL_P(typemap) || rb_obj_is_kind_of(typemap, rb_cTypeMapAllStrings) )
+		return Qnil;
+	if( !rb_obj_is_kind_of(typemap, rb_cTypeMapByColumn) ){
+		if( !rb_respond_to(typemap, rb_intern("build_column_map")) ){
+			rb_raise( rb_eTypeError, "wrong argument type %s (expected PG::TypeMapByColumn)",
+					rb_obj_classname( typemap ) );
+		}
+		typemap = rb_funcall( typemap, rb_intern("build_column_map"), 1, this->result );
+	}
+	if( ((t_tmbc *)DATA_PTR(typemap))->nfields != this->nfields ){
+		rb_raise( rb_eArgError, "number of result fields (%d) does not match number of mapped columns (%d)",
+				this->nfields, ((t_tmbc *)DATA_PTR(typemap))->nfields );
+	}
+	return typemap;
+}
+
+/*
+ * call-seq:
+ *    res.type_map = typemap
+ *
+ * Set the type map that is used to decode the values.
+ *
+ * +typemap+ can be a PG::TypeMapByColumn , a type map that responds to
+ * +build_column_map+ like PG::TypeMapByOid , or +nil+ to retrieve all
+ * values as Strings.
+ *
+ * Columns without a coder are decoded per the +default_type_map+ of the
+ * PG::TypeMapByColumn , which must be one of the type maps above.
+ */
+static VALUE
+pg_spooled_result_type_map_set( VALUE self, VALUE typemap )
+{
+	t_pg_spooled_result *this = pg_spooled_result_get_this( self );
+	VALUE colmap = pg_spooled_result_column_map( this, typemap );
+	VALUE default_colmap = Qnil;
+
+	if( !NIL_P(colmap) )
+		default_colmap = pg_spooled_result_column_map( this, ((t_tmbc *)DATA_PTR(colmap))->typemap.default_typemap );
+
+	this->typemap = colmap;
+	this->default_colmap = default_colmap;
+	return typemap;
+}
+
+/*
+ * call-seq:
+ *    res.type_map -> PG::TypeMapByColumn or nil
+ *
+ * Returns the type map that is used to decode the values.
+ */
+static VALUE
+pg_spooled_result_type_map_get( VALUE self )
+{
+	return pg_spooled_result_get_this(self)->typemap;
+}
+
+/*
+ * call-seq:
+ *    res.close -> nil
+ *
+ * Unmaps the spool file. A file given as +path+ is kept on the file system.
+ * Any further access to the values raises a PG::Error .
+ */
+static VALUE
+pg_spooled_result_close( VALUE self )
+{
+	t_pg_spooled_result *this;
+	Data_Get_Struct( self, t_pg_spooled_result, this );
+
+	if( this->state == 1 ){
+		pg_spooled_result_unmap( this );
+		this->state = 2;
+	}
+	return Qnil;
+}
+
+/*
+ * call-seq:
+ *    res.closed? -> Boolean
+ *
+ * Returns +true+ if the spooled result has been closed.
+ */
+static VALUE
+pg_spooled_result_closed_p( VALUE self )
+{
+	t_pg_spooled_result *this;
+	Data_Get_Struct( self, t_pg_spooled_result, this );
+
+	return this->state == 2 ? Qtrue : Qfalse;
+}
+
+
+void
+init_pg_spooled_result()
+{
+	rb_cPG_SpooledResult = rb_define_class_under( rb_mPG, "SpooledResult", rb_cObject );
+	rb_define_alloc_func( rb_cPG_SpooledResult, pg_spooled_result_s_allocate );
+	rb_include_module( rb_cPG_SpooledResult, rb_mEnumerable );
+
+	rb_define_method( rb_cPG_SpooledResult, "initialize", pg_spooled_result_init, -1 );
+	rb_define_method( rb_cPG_SpooledResult, "ntuples", pg_spooled_result_ntuples, 0 );
+	rb_define_alias( rb_cPG_SpooledResult, "num_tuples", "ntuples" );
+	rb_define_method( rb_cPG_SpooledResult, "nfields", pg_spooled_result_nfields, 0 );
+	rb_define_alias( rb_cPG_SpooledResult, "num_fields", "nfields" );
+	rb_define_method( rb_cPG_SpooledResult, "fields", pg_spooled_result_fields, 0 );
+	rb_define_method( rb_cPG_SpooledResult, "result", pg_spooled_result_result, 0 );
+	rb_define_method( rb_cPG_SpooledResult, "path", pg_spooled_result_path, 0 );
+	rb_define_method( rb_cPG_SpooledResult, "getvalue", pg_spooled_result_getvalue, 2 );
+	rb_define_method( rb_cPG_SpooledResult, "getisnull", pg_spooled_result_getisnull, 2 );
+	rb_define_method( rb_cPG_SpooledResult, "getlength", pg_spooled_result_getlength, 2 );
+	rb_define_method( rb_cPG_SpooledResult, "[]", pg_spooled_result_aref, 1 );
+	rb_define_method( rb_cPG_SpooledResult, "each", pg_spooled_result_each, 0 );
+	rb_define_method( rb_cPG_SpooledResult, "each_row", pg_spooled_result_each_row, 0 );
+	rb_define_method( rb_cPG_SpooledResult, "values", pg_spooled_result_values, 0 );
+	rb_define_method( rb_cPG_SpooledResult, "column_values", pg_spooled_result_column_values, 1 );
+	rb_define_method( rb_cPG_SpooledResult, "field_values", pg_spooled_result_field_values, 1 );
+	rb_define_method( rb_cPG_SpooledResult, "type_map=", pg_spooled_result_type_map_set, 1 );
+	rb_define_method( rb_cPG_SpooledResult, "type_map", pg_spooled_result_type_map_get, 0 );
+	rb_define_method( rb_cPG_SpooledResult, "close", pg_spooled_result_close, 0 );
+	rb_define_method( rb_cPG_SpooledResult, "closed?", pg_spooled_result_closed_p, 0 );
+}
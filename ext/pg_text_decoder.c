@@ -30,6 +30,8 @@
 
 #include "pg.h"
 #include "util.h"
+#include <math.h>
+#include <time.h>
 #ifdef HAVE_INTTYPES_H
 #include <inttypes.h>
 #endif
@@ -45,7 +47,7 @@ static ID s_id_decode;
  * to Ruby true or false values.
  *
  */
-static VALUE
+VALUE
 pg_text_dec_boolean(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
 {
 	if (len < 1) {
@@ -77,7 +79,7 @@ pg_text_dec_string(t_pg_coder *conv, char *val, int len, int tuple, int field, i
  * to Ruby Integer objects.
  *
  */
-static VALUE
+VALUE
 pg_text_dec_integer(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
 {
 	long i;
@@ -141,7 +143,7 @@ pg_text_dec_integer(t_pg_coder *conv, char *val, int len, int tuple, int field,
  * to Ruby Float objects.
  *
  */
-static VALUE
+VALUE
 pg_text_dec_float(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
 {
 	return rb_float_new(strtod(val, NULL));
@@ -169,6 +171,184 @@ pg_text_dec_bytea(t_pg_coder *conv, char *val, int len, int tuple, int field, in
 	return ret;
 }
 
+static VALUE s_cDate;
+static VALUE s_date_gregorian;
+static ID s_id_civil;
+static ID s_id_local;
+static ID s_id_BigDecimal;
+static int bigdecimal_loaded = 0;
+
+/*
+ * Build a BigDecimal from a String. bigdecimal is loaded on first use.
+ */
+VALUE
+pg_bigdecimal_new( VALUE str )
+{
+	if( !bigdecimal_loaded ){
+		rb_require( "bigdecimal" );
+		bigdecimal_loaded = 1;
+	}
+	return rb_funcall( rb_mKernel, s_id_BigDecimal, 1, str );
+}
+
+/*
+ * Convert a numeric in text output format to the Ruby object selected by the
+ * PG_CODER_NUMERIC_* flags of the coder. +integral+ tells whether the value
+ * has no fractional digits.
+ */
+VALUE
+pg_numeric_from_str(t_pg_coder *conv, char *val, int len, int integral, int tuple, int field, int enc_idx)
+{
+	if( integral && (conv->flags & PG_CODER_NUMERIC_AS_INTEGER) ){
+		return pg_text_dec_integer(conv, val, len, tuple, field, enc_idx);
+	}else if( conv->flags & PG_CODER_NUMERIC_AS_FLOAT ){
+		return rb_float_new( strtod(val, NULL) );
+	}else{
+		return pg_bigdecimal_new( rb_str_new(val, len) );
+	}
+}
+
+/*
+ * Document-class: PG::TextDecoder::Numeric < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL numeric type
+ * to Ruby BigDecimal objects.
+ *
+ * Other types can be selected by PG::Coder#flags :
+ * * PG::Coder::NUMERIC_AS_INTEGER - values without fractional digits are returned
+ *   as Integer. That are all values of a column with scale 0.
+ * * PG::Coder::NUMERIC_AS_FLOAT - values are returned as Float. Combined with
+ *   PG::Coder::NUMERIC_AS_INTEGER only values with fractional digits are returned as Float.
+ *
+ * NaN and Infinity are returned as BigDecimal or Float.
+ *
+ */
+static VALUE
+pg_text_dec_numeric(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	/* Neither a fractional part nor NaN or Infinity */
+	int integral = len > 0 && val[len - 1] >= '0' && val[len - 1] <= '9' && !memchr(val, '.', len);
+	return pg_numeric_from_str(conv, val, len, integral, tuple, field, enc_idx);
+}
+
+/*
+ * Build a Date object in the proleptic Gregorian calendar.
+ */
+VALUE
+pg_date_new( int64_t year, int mon, int day )
+{
+	if( NIL_P(s_cDate) ){
+		rb_require( "date" );
+		s_cDate = rb_const_get( rb_cObject, rb_intern("Date") );
+		s_date_gregorian = rb_const_get( s_cDate, rb_intern("GREGORIAN") );
+	}
+	return rb_funcall( s_cDate, s_id_civil, 4, LL2NUM(year), INT2FIX(mon), INT2FIX(day), s_date_gregorian );
+}
+
+/*
+ * Build a Time object in local time from wall clock values, so that the
+ * time zone rules of the system apply.
+ */
+VALUE
+pg_time_new_local( int64_t year, int mon, int day, int hour, int min, int sec, long nsec )
+{
+	struct timespec tspec;
+	struct tm tm;
+	time_t time;
+
+	memset( &tm, 0, sizeof(tm) );
+	tm.tm_year = (int)(year - 1900);
+	tm.tm_mon = mon - 1;
+	tm.tm_mday = day;
+	tm.tm_hour = hour;
+	tm.tm_min = min;
+	tm.tm_sec = sec;
+	tm.tm_isdst = -1;
+	time = mktime( &tm );
+
+	if( time == (time_t)-1 ){
+		/* Out of range of time_t (or exactly one second before the epoch) - let Ruby do it. */
+		return rb_funcall( rb_cTime, s_id_local, 7, LL2NUM(year), INT2FIX(mon), INT2FIX(day),
+				INT2FIX(hour), INT2FIX(min), INT2FIX(sec),
+				rb_rational_new(LONG2NUM(nsec), INT2FIX(1000)) );
+	}
+	tspec.tv_sec = time;
+	tspec.tv_nsec = nsec;
+	return rb_time_timespec_new( &tspec, INT_MAX );
+}
+
+/*
+ * Document-class: PG::TextDecoder::Date < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL date type
+ * to Ruby Date objects.
+ *
+ * Dates are built in the proleptic Gregorian calendar, like PostgreSQL
+ * does. BC dates are returned with astronomical year numbering (1 BC is year 0).
+ * The values +infinity+ and +-infinity+ and dates in a DateStyle other
+ * than ISO are returned as String.
+ *
+ */
+static VALUE
+pg_text_dec_date(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	t_pg_iso_timestamp ts;
+
+	if( !pg_parse_iso_timestamp(val, &ts) )
+		return pg_text_dec_string(conv, val, len, tuple, field, enc_idx);
+	if( ts.infinity )
+		return pg_text_dec_string(conv, val, len, tuple, field, enc_idx);
+	if( ts.has_time )
+		return pg_text_dec_string(conv, val, len, tuple, field, enc_idx);
+
+	return pg_date_new( ts.year, ts.mon, ts.day );
+}
+
+/*
+ * Document-class: PG::TextDecoder::TimestampWithoutTimeZone < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL timestamp type
+ * to Ruby Time objects in local time.
+ *
+ * BC timestamps are returned with astronomical year numbering (1 BC is year 0).
+ * The values +infinity+ and +-infinity+ and timestamps in a DateStyle
+ * other than ISO are returned as String.
+ *
+ */
+/*
+ * Document-class: PG::TextDecoder::TimestampWithTimeZone < PG::SimpleDecoder
+ *
+ * This is a decoder class for conversion of PostgreSQL timestamptz type
+ * to Ruby Time objects with the UTC offset sent by the server.
+ *
+ * BC timestamps are returned with astronomical year numbering (1 BC is year 0).
+ * The values +infinity+ and +-infinity+ and timestamps in a DateStyle
+ * other than ISO are returned as String.
+ *
+ */
+static VALUE
+pg_text_dec_timestamp(t_pg_coder *conv, char *val, int len, int tuple, int field, int enc_idx)
+{
+	t_pg_iso_timestamp ts;
+	struct timespec tspec;
+
+	if( !pg_parse_iso_timestamp(val, &ts) )
+		return pg_text_dec_string(conv, val, len, tuple, field, enc_idx);
+	if( ts.infinity )
+		return pg_text_dec_string(conv, val, len, tuple, field, enc_idx);
+	if( !ts.has_time )
+		return pg_text_dec_string(conv, val, len, tuple, field, enc_idx);
+
+	if( ts.has_tz ){
+		tspec.tv_sec = (time_t)(pg_days_from_civil(ts.year, ts.mon, ts.day) * 86400 +
+				ts.hour * 3600 + ts.min * 60 + ts.sec - ts.tz_offset);
+		tspec.tv_nsec = ts.nsec;
+		return rb_time_timespec_new( &tspec, ts.tz_offset );
+	} else {
+		return pg_time_new_local( ts.year, ts.mon, ts.day, ts.hour, ts.min, ts.sec, ts.nsec );
+	}
+}
+
 /*
  * Array parser functions are thankfully borrowed from here:
  * https://github.com/dockyard/pg_array_parser
@@ -396,6 +576,12 @@ void
 init_pg_text_decoder()
 {
 	s_id_decode = rb_intern("decode");
+	s_id_civil = rb_intern("civil");
+	s_id_local = rb_intern("local");
+	s_id_BigDecimal = rb_intern("BigDecimal");
+	s_cDate = Qnil;
+	rb_global_variable( &s_cDate );
+	rb_global_variable( &s_date_gregorian );
 
 	/* This module encapsulates all decoder classes with text input format */
 	rb_mPG_TextDecoder = rb_define_module_under( rb_mPG, "TextDecoder" );
@@ -407,12 +593,20 @@ init_pg_text_decoder()
 	pg_define_coder( "Integer", pg_text_dec_integer, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
 	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "Float", rb_cPG_SimpleDecoder ); */
 	pg_define_coder( "Float", pg_text_dec_float, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "Numeric", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "Numeric", pg_text_dec_numeric, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
 	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "String", rb_cPG_SimpleDecoder ); */
 	pg_define_coder( "String", pg_text_dec_string, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
 	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "Bytea", rb_cPG_SimpleDecoder ); */
 	pg_define_coder( "Bytea", pg_text_dec_bytea, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
 	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "Identifier", rb_cPG_SimpleDecoder ); */
 	pg_define_coder( "Identifier", pg_text_dec_identifier, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "Date", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "Date", pg_text_dec_date, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "TimestampWithoutTimeZone", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "TimestampWithoutTimeZone", pg_text_dec_timestamp, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
+	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "TimestampWithTimeZone", rb_cPG_SimpleDecoder ); */
+	pg_define_coder( "TimestampWithTimeZone", pg_text_dec_timestamp, rb_cPG_SimpleDecoder, rb_mPG_TextDecoder );
 
 	/* dummy = rb_define_class_under( rb_mPG_TextDecoder, "Array", rb_cPG_CompositeDecoder ); */
 	pg_define_coder( "Array", pg_text_dec_array, rb_cPG_CompositeDecoder, rb_mPG_TextDecoder );
@@ -50,6 +50,11 @@
 VALUE rb_mPG_TextEncoder;
 static ID s_id_encode;
 static ID s_id_to_i;
+static ID s_id_year;
+static ID s_id_mon;
+static ID s_id_mday;
+static ID s_id_strftime;
+static VALUE s_cDate;
 
 static int pg_text_enc_integer(t_pg_coder *this, VALUE value, char *out, VALUE *intermediate, int enc_idx);
 
@@ -254,6 +259,219 @@ pg_text_enc_float(t_pg_coder *conv, VALUE value, char *out, VALUE *intermediate,
 	}
 }
 
+/* Upper bound of the length of an ISO date or timestamp written by write_iso_timestamp() */
+#define ISO_TIMESTAMP_MAX_LEN 64
+
+static char *
+write_fixed_digits( char *out, int64_t value, int width )
+{
+	char *p = out + width;
+	while( p > out ){
+		*--p = '0' + (char)(value % 10);
+		value /= 10;
+	}
+	return out + width;
+}
+
+/*
+ * Write a date or timestamp in ISO DateStyle with nanoseconds, like
+ * Time#strftime("%Y-%m-%d %H:%M:%S.%N %:z") does. +days+ and +sec_of_day+ are
+ * in the time zone given by +tz_offset+ . Unlike strftime, the seconds of the
+ * UTC offset are not dropped and years before 1 AD are written with BC suffix.
+ */
+static int
+write_iso_timestamp( char *out, int64_t days, int sec_of_day, long nsec, int with_time, int with_tz, int tz_offset )
+{
+	char *p = out;
+	int64_t year;
+	int mon, day;
+	int bc;
+
+	pg_civil_from_days( days, &year, &mon, &day );
+	bc = year <= 0;
+	if( bc ) year = 1 - year;
+
+	if( year < 10000 ){
+		p = write_fixed_digits( p, year, 4 );
+	}else{
+		p += sprintf( p, "%lld", (long long)year );
+	}
+	*p++ = '-';
+	p = write_fixed_digits( p, mon, 2 );
+	*p++ = '-';
+	p = write_fixed_digits( p, day, 2 );
+
+	if( with_time ){
+		*p++ = ' ';
+		p = write_fixed_digits( p, sec_of_day / 3600, 2 );
+		*p++ = ':';
+		p = write_fixed_digits( p, sec_of_day / 60 % 60, 2 );
+		*p++ = ':';
+		p = write_fixed_digits( p, sec_of_day % 60, 2 );
+
+		*p++ = '.';
+		p = write_fixed_digits( p, nsec, 9 );
+
+		if( with_tz ){
+			int abs_offset = tz_offset < 0 ? -tz_offset : tz_offset;
+			*p++ = ' ';
+			*p++ = tz_offset < 0 ? '-' : '+';
+			p = write_fixed_digits( p, abs_offset / 3600, 2 );
+			*p++ = ':';
+			p = write_fixed_digits( p, abs_offset / 60 % 60, 2 );
+			if( abs_offset % 60 ){
+				*p++ = ':';
+				p = write_fixed_digits( p, abs_offset % 60, 2 );
+			}
+		}
+	}
+
+	if( bc ){
+		memcpy( p, " BC", 3 );
+		p += 3;
+	}
+	return (int)(p - out);
+}
+
+/* Write a Time object in the time zone of its UTC offset. */
+static int
+write_iso_time( char *out, VALUE time, int with_time, int with_tz )
+{
+	struct timespec ts = rb_time_timespec( time );
+	int tz_offset = NUM2INT( rb_time_utc_offset(time) );
+	int64_t local = (int64_t)ts.tv_sec + tz_offset;
+	int64_t days = local / 86400;
+	int sec_of_day = (int)(local % 86400);
+
+	if( sec_of_day < 0 ){
+		sec_of_day += 86400;
+		days--;
+	}
+	return write_iso_timestamp( out, days, sec_of_day, ts.tv_nsec, with_time, with_tz, tz_offset );
+}
+
+/* Is +value+ a Date object? Date might not be loaded. */
+int
+pg_obj_is_date( VALUE value )
+{
+	if( NIL_P(s_cDate) ){
+		/* Date objects can only exist if date is loaded. */
+		if( !rb_const_defined(rb_cObject, rb_intern("Date")) )
+			return 0;
+		s_cDate = rb_const_get( rb_cObject, rb_intern("Date") );
+	}
+	return RTEST( rb_obj_is_kind_of(value, s_cDate) );
+}
+
+/*
+ * Days since 1970-01-01 of a Date object. The civil fields are taken as
+ * proleptic Gregorian date, so that Dates of the Julian calendar (before
+ * 1582 with the default Date::ITALY) are stored with the same year, month
+ * and day.
+ */
+int64_t
+pg_date_to_days( VALUE date )
+{
+	return pg_days_from_civil( NUM2LL(rb_funcall(date, s_id_year, 0)),
+			NUM2INT(rb_funcall(date, s_id_mon, 0)), NUM2INT(rb_funcall(date, s_id_mday, 0)) );
+}
+
+/*
+ * Encode values, which are neither Time nor Date objects.
+ *
+ * Float::INFINITY and -Float::INFINITY are encoded as +infinity+ and +-infinity+ .
+ * Other objects responding to +strftime+ are formatted per _format_ and
+ * all other objects per +to_s+ .
+ */
+static int
+pg_text_enc_timestamp_other(t_pg_coder *this, VALUE value, char *out, VALUE *intermediate, int enc_idx, const char *format)
+{
+	if( TYPE(value) == T_FLOAT && isinf(RFLOAT_VALUE(value)) ){
+		if( RFLOAT_VALUE(value) < 0 ){
+			if(out) memcpy( out, "-infinity", 9 );
+			return 9;
+		}else{
+			if(out) memcpy( out, "infinity", 8 );
+			return 8;
+		}
+	}
+	if( rb_respond_to(value, s_id_strftime) ){
+		value = rb_funcall( value, s_id_strftime, 1, rb_str_new_cstr(format) );
+	}
+	return pg_coder_enc_to_s(this, value, out, intermediate, enc_idx);
+}
+
+/*
+ * Document-class: PG::TextEncoder::Date < PG::SimpleEncoder
+ *
+ * This is the encoder class for the PostgreSQL date type.
+ *
+ * Date objects are encoded with their year, month and day, also when they
+ * are in the Julian calendar (before 1582 with Date::ITALY). Time objects are encoded as the date in
+ * their UTC offset. BC dates are sent with BC suffix. Float::INFINITY
+ * and -Float::INFINITY are encoded as +infinity+ and +-infinity+ .
+ * Other objects are formatted per +strftime+ or +to_s+ .
+ *
+ */
+static int
+pg_text_enc_date(t_pg_coder *this, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	if( rb_obj_is_kind_of(value, rb_cTime) ){
+		return out ? write_iso_time( out, value, 0, 0 ) : ISO_TIMESTAMP_MAX_LEN;
+	}else if( pg_obj_is_date(value) ){
+		if( out ){
+			return write_iso_timestamp( out, NUM2LL(*intermediate), 0, 0, 0, 0, 0 );
+		}else{
+			*intermediate = LL2NUM( pg_date_to_days(value) );
+			return ISO_TIMESTAMP_MAX_LEN;
+		}
+	}else{
+		return pg_text_enc_timestamp_other( this, value, out, intermediate, enc_idx, "%Y-%m-%d" );
+	}
+}
+
+/*
+ * Document-class: PG::TextEncoder::TimestampWithoutTimeZone < PG::SimpleEncoder
+ *
+ * This is the encoder class for the PostgreSQL timestamp type.
+ *
+ * Time objects are encoded as wall clock time in their UTC offset, without
+ * the offset itself. BC timestamps are sent with BC suffix. Float::INFINITY
+ * and -Float::INFINITY are encoded as +infinity+ and +-infinity+ .
+ * Other objects are formatted per +strftime+ or +to_s+ .
+ *
+ */
+static int
+pg_text_enc_timestamp(t_pg_coder *this, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	if( rb_obj_is_kind_of(value, rb_cTime) ){
+		return out ? write_iso_time( out, value, 1, 0 ) : ISO_TIMESTAMP_MAX_LEN;
+	}else{
+		return pg_text_enc_timestamp_other( this, value, out, intermediate, enc_idx, "%Y-%m-%d %H:%M:%S.%N" );
+	}
+}
+
+/*
+ * Document-class: PG::TextEncoder::TimestampWithTimeZone < PG::SimpleEncoder
+ *
+ * This is the encoder class for the PostgreSQL timestamptz type.
+ *
+ * Time objects are encoded with their UTC offset, including the seconds
+ * of the offset, if any. BC timestamps are sent with BC suffix.
+ * Float::INFINITY and -Float::INFINITY are encoded as +infinity+ and
+ * +-infinity+ . Other objects are formatted per +strftime+ or +to_s+ .
+ *
+ */
+static int
+pg_text_enc_timestamptz(t_pg_coder *this, VALUE value, char *out, VALUE *intermediate, int enc_idx)
+{
+	if( rb_obj_is_kind_of(value, rb_cTime) ){
+		return out ? write_iso_time( out, value, 1, 1 ) : ISO_TIMESTAMP_MAX_LEN;
+	}else{
+		return pg_text_enc_timestamp_other( this, value, out, intermediate, enc_idx, "%Y-%m-%d %H:%M:%S.%N %:z" );
+	}
+}
+
 static const char hextab[] = {
 	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
 };
@@ -656,6 +874,12 @@ init_pg_text_encoder()
 {
 	s_id_encode = rb_intern("encode");
 	s_id_to_i = rb_intern("to_i");
+	s_id_year = rb_intern("year");
+	s_id_mon = rb_intern("mon");
+	s_id_mday = rb_intern("mday");
+	s_id_strftime = rb_intern("strftime");
+	s_cDate = Qnil;
+	rb_global_variable( &s_cDate );
 
 	/* This module encapsulates all encoder classes with text output format */
 	rb_mPG_TextEncoder = rb_define_module_under( rb_mPG, "TextEncoder" );
@@ -673,6 +897,12 @@ init_pg_text_encoder()
 	pg_define_coder( "Bytea", pg_text_enc_bytea, rb_cPG_SimpleEncoder, rb_mPG_TextEncoder );
 	/* dummy = rb_define_class_under( rb_mPG_TextEncoder, "Identifier", rb_cPG_SimpleEncoder ); */
 	pg_define_coder( "Identifier", pg_text_enc_identifier, rb_cPG_SimpleEncoder, rb_mPG_TextEncoder );
+	/* dummy = rb_define_class_under( rb_mPG_TextEncoder, "Date", rb_cPG_SimpleEncoder ); */
+	pg_define_coder( "Date", pg_text_enc_date, rb_cPG_SimpleEncoder, rb_mPG_TextEncoder );
+	/* dummy = rb_define_class_under( rb_mPG_TextEncoder, "TimestampWithoutTimeZone", rb_cPG_SimpleEncoder ); */
+	pg_define_coder( "TimestampWithoutTimeZone", pg_text_enc_timestamp, rb_cPG_SimpleEncoder, rb_mPG_TextEncoder );
+	/* dummy = rb_define_class_under( rb_mPG_TextEncoder, "TimestampWithTimeZone", rb_cPG_SimpleEncoder ); */
+	pg_define_coder( "TimestampWithTimeZone", pg_text_enc_timestamptz, rb_cPG_SimpleEncoder, rb_mPG_TextEncoder );
 
 	/* dummy = rb_define_class_under( rb_mPG_TextEncoder, "Array", rb_cPG_CompositeEncoder ); */
 	pg_define_coder( "Array", pg_text_enc_array, rb_cPG_CompositeEncoder, rb_mPG_TextEncoder );
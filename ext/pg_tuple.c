@@ -0,0 +1,381 @@
+/*
+ * pg_tuple.c - PG::Tuple class extension
+ * $Id$
+ *
+ */
+
+#include "pg.h"
+
+/********************************************************************
+ *
+ * Document-class: PG::Tuple
+ *
+ * The class to represent one query result tuple (row).
+ * An instance of this class can be created by PG::Result#tuple .
+ *
+ * All field values of the tuple are retrieved on demand from the underlying PGresult object
+ * and converted to a Ruby object. Subsequent access to the same field returns the same object,
+ * since they are cached when materialized.
+ * Each PG::Tuple holds only a reference to the related PG::Result object and its row number,
+ * so that creating a tuple is cheap, regardless of the number of fields.
+ *
+ * Example:
+ *    require 'pg'
+ *    conn = PG.connect(:dbname => 'test')
+ *    res  = conn.exec('VALUES(1,2), (3,4)')
+ *    t0 = res.tuple(0)  # => #<PG::Tuple column1: "1", column2: "2">
+ *    t1 = res.tuple(1)  # => #<PG::Tuple column1: "3", column2: "4">
+ *    t1[0]  # => "3"
+ *    t1["column2"]  # => "4"
+ */
+
+VALUE rb_cPG_Tuple;
+
+typedef struct {
+	/* PG::Result object this tuple was retrieved from. */
+	VALUE result;
+
+	/* Store the typemap of the result.
+	 * It's not enough to reference the PG::TypeMap object through the result,
+	 * since it could be exchanged after the tuple has been created.
+	 */
+	VALUE typemap;
+
+	/* Hash with field names as keys and field indices as values */
+	VALUE field_map;
+
+	/* Row number within the result set */
+	int row_num;
+
+	/* Number of fields in the result set */
+	int num_fields;
+
+	/* Materialized values.
+	 * Qundef if not yet materialized.
+	 */
+	VALUE values[0];
+} t_pg_tuple;
+
+static void
+pg_tuple_gc_mark( t_pg_tuple *this )
+{
+	int i;
+
+	if( !this ) return;
+	rb_gc_mark( this->result );
+	rb_gc_mark( this->typemap );
+	rb_gc_mark( this->field_map );
+
+	for( i = 0; i < this->num_fields; i++ ){
+		if( this->values[i] != Qundef )
+			rb_gc_mark( this->values[i] );
+	}
+}
+
+static void
+pg_tuple_gc_free( t_pg_tuple *this )
+{
+	if( !this ) return;
+	xfree(this);
+}
+
+/*
+ * Document-method: allocate
+ *
+ * call-seq:
+ *   PG::Tuple.allocate -> obj
+ */
+static VALUE
+pg_tuple_s_allocate( VALUE klass )
+{
+	return Data_Wrap_Struct( klass, pg_tuple_gc_mark, pg_tuple_gc_free, NULL );
+}
+
+VALUE
+pg_tuple_new(VALUE result, int row_num)
+{
+	t_pg_tuple *this;
+	VALUE self = pg_tuple_s_allocate( rb_cPG_Tuple );
+	t_pg_result *p_result = pgresult_get_this(result);
+	int num_fields = p_result->nfields;
+	int i;
+
+	this = (t_pg_tuple *)xmalloc(
+		sizeof(*this) +
+		sizeof(*this->values) * num_fields);
+
+	this->result = result;
+	this->typemap = p_result->typemap;
+	this->field_map = p_result->field_map;
+	this->row_num = row_num;
+	this->num_fields = num_fields;
+
+	for( i = 0; i < num_fields; i++ ){
+		this->values[i] = Qundef;
+	}
+
+	DATA_PTR(self) = this;
+
+	return self;
+}
+
+static inline t_pg_tuple *
+pg_tuple_get_this( VALUE self )
+{
+	t_pg_tuple *this = DATA_PTR(self);
+	if (this == NULL)
+		rb_raise(rb_eTypeError, "tuple is empty");
+
+	return this;
+}
+
+static VALUE
+pg_tuple_materialize_field(t_pg_tuple *this, int col)
+{
+	VALUE value = this->values[col];
+
+	if( value == Qundef ){
+		t_typemap *p_typemap = DATA_PTR( this->typemap );
+
+		/* Raise a proper exception instead of accessing a cleared PGresult. */
+		if( pgresult_get_this(this->result)->pgresult == NULL )
+			rb_raise(rb_ePGerror, "result has been cleared");
+
+		value = p_typemap->funcs.typecast_result_value(p_typemap, this->result, this->row_num, col);
+		this->values[col] = value;
+	}
+
+	return value;
+}
+
+static void
+pg_tuple_materialize(t_pg_tuple *this)
+{
+	int field_num;
+	for(field_num = 0; field_num < this->num_fields; field_num++) {
+		pg_tuple_materialize_field(this, field_num);
+	}
+}
+
+/*
+ * Look up the field number of +key+ which can be a field name or a field index.
+ * Returns -1 if the key doesn't match any field.
+ */
+static int
+pg_tuple_field_index(t_pg_tuple *this, VALUE key)
+{
+	VALUE index;
+	int field_num;
+
+	switch(rb_type(key)){
+		case T_FIXNUM:
+		case T_BIGNUM:
+			field_num = NUM2INT(key);
+			if ( field_num < -this->num_fields || field_num >= this->num_fields )
+				return -1;
+			if ( field_num < 0 )
+				field_num += this->num_fields;
+			return field_num;
+		default:
+			index = rb_hash_aref(this->field_map, key);
+			return NIL_P(index) ? -1 : FIX2INT(index);
+	}
+}
+
+/*
+ * call-seq:
+ *    tup.fetch(key) → value
+ *    tup.fetch(key, default) → value
+ *    tup.fetch(key) { |key| block } → value
+ *
+ * Returns a field value by either column index or column name.
+ *
+ * An integer +key+ is interpreted as column index.
+ * Negative values of index count from the end of the array.
+ *
+ * A string +key+ is interpreted as column name.
+ *
+ * If the key can't be found, there are several options:
+ * With no other arguments, it will raise a IndexError exception;
+ * if default is given, then that will be returned;
+ * if the optional code block is specified, then that will be run and its result returned.
+ */
+static VALUE
+pg_tuple_fetch(int argc, VALUE *argv, VALUE self)
+{
+	VALUE key;
+	int field_num;
+	t_pg_tuple *this = pg_tuple_get_this(self);
+
+	rb_check_arity(argc, 1, 2);
+	key = argv[0];
+
+	field_num = pg_tuple_field_index(this, key);
+	if( field_num < 0 ){
+		if (rb_block_given_p()) {
+			return rb_yield(key);
+		} else if (argc == 1) {
+			rb_raise( rb_eIndexError, "Index %s is out of range", RSTRING_PTR(rb_inspect(key)) );
+		} else {
+			return argv[1];
+		}
+	}
+
+	return pg_tuple_materialize_field(this, field_num);
+}
+
+/*
+ * call-seq:
+ *    tup[ key ] -> value
+ *
+ * Returns a field value by either column index or column name.
+ *
+ * An integer +key+ is interpreted as column index.
+ * Negative values of index count from the end of the array.
+ *
+ * A string +key+ is interpreted as column name.
+ *
+ * If the key can't be found, it returns +nil+ .
+ */
+static VALUE
+pg_tuple_aref(VALUE self, VALUE key)
+{
+	int field_num;
+	t_pg_tuple *this = pg_tuple_get_this(self);
+
+	field_num = pg_tuple_field_index(this, key);
+	if( field_num < 0 )
+		return Qnil;
+
+	return pg_tuple_materialize_field(this, field_num);
+}
+
+static VALUE
+pg_tuple_num_fields_for_enum(VALUE self, VALUE args, VALUE eobj)
+{
+	t_pg_tuple *this = pg_tuple_get_this(self);
+	return INT2NUM(this->num_fields);
+}
+
+/*
+ * call-seq:
+ *    tup.each{ |key, value| ... }
+ *
+ * Invokes block for each field name and value in the tuple.
+ */
+static VALUE
+pg_tuple_each(VALUE self)
+{
+	t_pg_tuple *this = pg_tuple_get_this(self);
+	t_pg_result *p_result;
+	int field_num;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pg_tuple_num_fields_for_enum);
+
+	p_result = pgresult_get_this(this->result);
+	for( field_num = 0; field_num < this->num_fields; field_num++ ){
+		VALUE value = pg_tuple_materialize_field(this, field_num);
+		rb_yield_values(2, p_result->fnames[field_num], value);
+	}
+
+	return self;
+}
+
+/*
+ * call-seq:
+ *    tup.each_value{ |value| ... }
+ *
+ * Invokes block for each field value in the tuple.
+ */
+static VALUE
+pg_tuple_each_value(VALUE self)
+{
+	t_pg_tuple *this = pg_tuple_get_this(self);
+	int field_num;
+
+	RETURN_SIZED_ENUMERATOR(self, 0, NULL, pg_tuple_num_fields_for_enum);
+
+	for(field_num = 0; field_num < this->num_fields; field_num++) {
+		VALUE value = pg_tuple_materialize_field(this, field_num);
+		rb_yield(value);
+	}
+
+	return self;
+}
+
+
+/*
+ * call-seq:
+ *    tup.values  -> Array
+ *
+ * Returns the values of this tuple as Array.
+ * +res.tuple(i).values+ is equal to +res.values[i]+ .
+ */
+static VALUE
+pg_tuple_values(VALUE self)
+{
+	t_pg_tuple *this = pg_tuple_get_this(self);
+
+	pg_tuple_materialize(this);
+	return rb_ary_new4(this->num_fields, &this->values[0]);
+}
+
+/*
+ * call-seq:
+ *    tup.length → integer
+ *
+ * Returns number of fields of this tuple.
+ */
+static VALUE
+pg_tuple_length(VALUE self)
+{
+	t_pg_tuple *this = pg_tuple_get_this(self);
+	return INT2NUM(this->num_fields);
+}
+
+/*
+ * call-seq:
+ *    tup.keys  -> Array
+ *
+ * Returns the field names of this tuple as Array of Strings.
+ */
+static VALUE
+pg_tuple_keys(VALUE self)
+{
+	t_pg_tuple *this = pg_tuple_get_this(self);
+	t_pg_result *p_result = pgresult_get_this(this->result);
+
+	return rb_ary_new4(this->num_fields, p_result->fnames);
+}
+
+/*
+ * call-seq:
+ *    tup.index(key) → integer
+ *
+ * Returns the field number which matches the given column name.
+ */
+static VALUE
+pg_tuple_index(VALUE self, VALUE key)
+{
+	t_pg_tuple *this = pg_tuple_get_this(self);
+	return rb_hash_aref(this->field_map, key);
+}
+
+
+void
+init_pg_tuple()
+{
+	rb_cPG_Tuple = rb_define_class_under( rb_mPG, "Tuple", rb_cObject );
+	rb_define_alloc_func( rb_cPG_Tuple, pg_tuple_s_allocate );
+	rb_include_module(rb_cPG_Tuple, rb_mEnumerable);
+
+	rb_define_method(rb_cPG_Tuple, "fetch", pg_tuple_fetch, -1);
+	rb_define_method(rb_cPG_Tuple, "[]", pg_tuple_aref, 1);
+	rb_define_method(rb_cPG_Tuple, "each", pg_tuple_each, 0);
+	rb_define_method(rb_cPG_Tuple, "each_value", pg_tuple_each_value, 0);
+	rb_define_method(rb_cPG_Tuple, "values", pg_tuple_values, 0);
+	rb_define_method(rb_cPG_Tuple, "length", pg_tuple_length, 0);
+	rb_define_alias(rb_cPG_Tuple, "size", "length");
+	rb_define_method(rb_cPG_Tuple, "index", pg_tuple_index, 1);
+	rb_define_method(rb_cPG_Tuple, "keys", pg_tuple_keys, 0);
+}
@@ -17,7 +17,7 @@ pg_tmas_fit_to_result( VALUE self, VALUE result )
 	return self;
 }
 
-static VALUE
+VALUE
 pg_tmas_result_value( t_typemap *p_typemap, VALUE result, int tuple, int field )
 {
 	VALUE ret;
@@ -6,7 +6,7 @@
 
 #include "pg.h"
 
-static VALUE rb_cTypeMapByColumn;
+VALUE rb_cTypeMapByColumn;
 static ID s_id_decode;
 static ID s_id_encode;
 
@@ -97,14 +97,15 @@ pg_tmbc_result_value( t_typemap *p_typemap, VALUE result, int tuple, int field )
 	if( p_coder ){
 		char * val = PQgetvalue( p_result->pgresult, tuple, field );
 		int len = PQgetlength( p_result->pgresult, tuple, field );
+		t_pg_coder_dec_func dec_func = p_coder->dec_func;
 
-		if( p_coder->dec_func ){
-			return p_coder->dec_func(p_coder, val, len, tuple, field, ENCODING_GET(result));
-		} else {
-			t_pg_coder_dec_func dec_func;
+		if( !dec_func ){
 			dec_func = pg_coder_dec_func( p_coder, PQfformat(p_result->pgresult, field) );
-			return dec_func(p_coder, val, len, tuple, field, ENCODING_GET(result));
 		}
+		if( p_coder->memo ){
+			return pg_coder_dec_memo(p_coder, dec_func, val, len, tuple, field, ENCODING_GET(result));
+		}
+		return dec_func(p_coder, val, len, tuple, field, ENCODING_GET(result));
 	}
 
 	default_tm = DATA_PTR( this->typemap.default_typemap );
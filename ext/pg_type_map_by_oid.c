@@ -110,6 +110,8 @@ pg_tmbo_result_value(t_typemap *p_typemap, VALUE result, int tuple, int field)
 		char * val = PQgetvalue( p_result->pgresult, tuple, field );
 		int len = PQgetlength( p_result->pgresult, tuple, field );
 		t_pg_coder_dec_func dec_func = pg_coder_dec_func( p_coder, format );
+		if( p_coder->memo )
+			return pg_coder_dec_memo( p_coder, dec_func, val, len, tuple, field, ENCODING_GET(result) );
 		return dec_func( p_coder, val, len, tuple, field, ENCODING_GET(result) );
 	}
 
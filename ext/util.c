@@ -147,3 +147,338 @@ rbpg_strncasecmp(const char *s1, const char *s2, size_t n)
 	return 0;
 }
 
+/*
+ * Parse a fixed number of decimal digits.
+ */
+static int
+parse_digits( const char **pp, int ndigits, int *p_value )
+{
+	const char *p = *pp;
+	int i = 0;
+
+	while( ndigits-- > 0 ){
+		if( *p < '0' || *p > '9' ) return 0;
+		i = i * 10 + (*p++ - '0');
+	}
+	*pp = p;
+	*p_value = i;
+	return 1;
+}
+
+/*
+ * Parse a date, timestamp or timestamptz value in the output format of
+ * DateStyle ISO, including infinity and BC dates.
+ * Returns 0 if the value doesn't match this format.
+ */
+int
+pg_parse_iso_timestamp( const char *val, t_pg_iso_timestamp *ts )
+{
+	const char *p = val;
+
+	memset( ts, 0, sizeof(*ts) );
+
+	if( strcmp(val, "infinity") == 0 ){
+		ts->infinity = 1;
+		return 1;
+	}
+	if( strcmp(val, "-infinity") == 0 ){
+		ts->infinity = -1;
+		return 1;
+	}
+
+	if( !parse_digits(&p, 4, &ts->year) ) return 0;
+	while( *p >= '0' && *p <= '9' ){
+		if( ts->year > 100000000 ) return 0;
+		ts->year = ts->year * 10 + (*p++ - '0');
+	}
+	if( *p++ != '-' || !parse_digits(&p, 2, &ts->mon) ) return 0;
+	if( *p++ != '-' || !parse_digits(&p, 2, &ts->day) ) return 0;
+
+	if( *p == ' ' || *p == 'T' ){
+		if( p[1] >= '0' && p[1] <= '9' ){
+			p++;
+			ts->has_time = 1;
+			if( !parse_digits(&p, 2, &ts->hour) ) return 0;
+			if( *p++ != ':' || !parse_digits(&p, 2, &ts->min) ) return 0;
+			if( *p++ != ':' || !parse_digits(&p, 2, &ts->sec) ) return 0;
+			if( *p == '.' ){
+				int scale = 100000000;
+				for( p++; *p >= '0' && *p <= '9'; p++ ){
+					ts->nsec += (*p - '0') * scale;
+					scale /= 10;
+				}
+			}
+
+			/* PG::TextEncoder::TimestampWithTimeZone writes a space before the offset */
+			if( *p == ' ' && (p[1] == '+' || p[1] == '-') ) p++;
+			if( *p == '+' || *p == '-' ){
+				int sign = *p++ == '-' ? -1 : 1;
+				int tzh, tzm = 0, tzs = 0;
+
+				/* The separating colons are optional: +HH[[:]MM[[:]SS]] */
+				if( !parse_digits(&p, 2, &tzh) ) return 0;
+				if( *p == ':' ) p++;
+				if( *p >= '0' && *p <= '9' ){
+					if( !parse_digits(&p, 2, &tzm) ) return 0;
+					if( *p == ':' ) p++;
+					if( *p >= '0' && *p <= '9' ){
+						if( !parse_digits(&p, 2, &tzs) ) return 0;
+					}
+				}
+				ts->has_tz = 1;
+				ts->tz_offset = sign * (tzh * 3600 + tzm * 60 + tzs);
+			}
+		}
+	}
+
+	if( strcmp(p, " BC") == 0 ){
+		ts->year = 1 - ts->year;
+		p += 3;
+	}
+
+	return *p == 0;
+}
+
+/* Days since 1970-01-01 of a date of the proleptic Gregorian calendar. */
+int64_t
+pg_days_from_civil( int64_t y, int m, int d )
+{
+	int64_t era, yoe, doy, doe;
+
+	y -= m <= 2;
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+/* Date of the proleptic Gregorian calendar of a number of days since 1970-01-01. */
+void
+pg_civil_from_days( int64_t days, int64_t *p_year, int *p_mon, int *p_day )
+{
+	int64_t z = days + 719468;
+	int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+	int64_t doe = z - era * 146097;
+	int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	int64_t mp = (5 * doy + 2) / 153;
+	int mon = (int)(mp < 10 ? mp + 3 : mp - 9);
+
+	*p_day = (int)(doy - (153 * mp + 2) / 5 + 1);
+	*p_mon = mon;
+	*p_year = yoe + era * 400 + (mon <= 2);
+}
+
+#define NUMERIC_POS 0x0000
+#define NUMERIC_NEG 0x4000
+#define NUMERIC_NAN 0xC000
+#define NUMERIC_PINF 0xD000
+#define NUMERIC_NINF 0xF000
+
+static const int numeric_pow10[4] = { 1, 10, 100, 1000 };
+
+/* Division by 4 rounded towards -infinity */
+static int64_t
+floordiv4( int64_t x )
+{
+	return x >= 0 ? x / 4 : -((-x + 3) / 4);
+}
+
+static char *
+write_numeric_group( char *p, int digit, int strip_zeros )
+{
+	int pos;
+	for( pos = 3; pos >= 0; pos-- ){
+		int d = digit / numeric_pow10[pos] % 10;
+		if( d || !strip_zeros || pos == 0 ){
+			*p++ = '0' + d;
+			strip_zeros = 0;
+		}
+	}
+	return p;
+}
+
+/*
+ * Convert a value in binary numeric format (base 10000 digits) to the text
+ * output format of PostgreSQL.
+ *
+ * Returns the number of bytes written to +out+ or an upper bound of it, if
+ * +out+ is NULL. The output is not NUL terminated. Returns -1 for invalid data.
+ */
+int
+pg_numeric_bin_to_str( const char *val, int len, char *out )
+{
+	int ndigits, weight, sign, dscale, d;
+	char *p = out;
+
+	if( len < 8 ) return -1;
+	ndigits = read_nbo16( val );
+	weight = read_nbo16( val + 2 );
+	sign = (uint16_t)read_nbo16( val + 4 );
+	dscale = read_nbo16( val + 6 );
+	if( ndigits < 0 || dscale < 0 || len < 8 + ndigits * 2 ) return -1;
+
+	switch( sign ){
+		case NUMERIC_POS:
+		case NUMERIC_NEG:
+			break;
+		case NUMERIC_NAN:
+			if( out ) memcpy( out, "NaN", 3 );
+			return 3;
+		case NUMERIC_PINF:
+			if( out ) memcpy( out, "Infinity", 8 );
+			return 8;
+		case NUMERIC_NINF:
+			if( out ) memcpy( out, "-Infinity", 9 );
+			return 9;
+		default:
+			return -1;
+	}
+
+	if( !out ){
+		for( d = 0; d < ndigits; d++ ){
+			int digit = read_nbo16( val + 8 + d * 2 );
+			if( digit < 0 || digit > 9999 ) return -1;
+		}
+		return 1 + (weight < 0 ? 1 : (weight + 1) * 4) + 1 + dscale;
+	}
+
+	if( sign == NUMERIC_NEG ) *p++ = '-';
+	if( weight < 0 ){
+		*p++ = '0';
+	} else {
+		for( d = 0; d <= weight; d++ ){
+			int digit = d < ndigits ? read_nbo16( val + 8 + d * 2 ) : 0;
+			p = write_numeric_group( p, digit, d == 0 );
+		}
+	}
+	if( dscale > 0 ){
+		int left = dscale;
+
+		*p++ = '.';
+		for( d = weight + 1; left > 0; d++ ){
+			int digit = d >= 0 && d < ndigits ? read_nbo16( val + 8 + d * 2 ) : 0;
+			char group[4];
+
+			write_numeric_group( group, digit, 0 );
+			memcpy( p, group, left < 4 ? left : 4 );
+			p += left < 4 ? left : 4;
+			left -= 4;
+		}
+	}
+	return (int)(p - out);
+}
+
+/*
+ * Convert a decimal number in text form to the binary numeric format.
+ *
+ * The text can be in the notation of PostgreSQL, Integer#to_s , Float#to_s or
+ * BigDecimal#to_s , including an exponent and NaN and [+-]Infinity .
+ *
+ * Returns the number of bytes written to +out+ or, if +out+ is NULL, the number
+ * of bytes required. Returns -1 for invalid or out of range input.
+ */
+int
+pg_numeric_str_to_bin( const char *str, int len, char *out )
+{
+	const char *p = str, *end = str + len;
+	const char *int_part, *frac_part = NULL;
+	int int_len, frac_len = 0, neg = 0, sign;
+	int64_t exponent = 0, point, dscale, n, first, last, weight, ndigits, k;
+
+	if( len == 3 && rbpg_strncasecmp(p, "NaN", 3) == 0 ){
+		sign = NUMERIC_NAN;
+		goto special;
+	}
+	if( p < end && (*p == '-' || *p == '+') ){
+		neg = *p == '-';
+		p++;
+	}
+	if( end - p == 8 && rbpg_strncasecmp(p, "Infinity", 8) == 0 ){
+		sign = neg ? NUMERIC_NINF : NUMERIC_PINF;
+		goto special;
+	}
+
+	int_part = p;
+	while( p < end && *p >= '0' && *p <= '9' ) p++;
+	int_len = (int)(p - int_part);
+	if( p < end && *p == '.' ){
+		frac_part = ++p;
+		while( p < end && *p >= '0' && *p <= '9' ) p++;
+		frac_len = (int)(p - frac_part);
+	}
+	if( int_len + frac_len == 0 ) return -1;
+	if( p < end && (*p == 'e' || *p == 'E') ){
+		int exp_neg = 0;
+		const char *exp_start;
+
+		p++;
+		if( p < end && (*p == '-' || *p == '+') ){
+			exp_neg = *p == '-';
+			p++;
+		}
+		exp_start = p;
+		while( p < end && *p >= '0' && *p <= '9' ){
+			exponent = exponent * 10 + (*p - '0');
+			/* Far beyond the range of numeric */
+			if( exponent > 1000000 ) return -1;
+			p++;
+		}
+		if( p == exp_start ) return -1;
+		if( exp_neg ) exponent = -exponent;
+	}
+	if( p != end ) return -1;
+
+#define NUMERIC_DIGIT(i) ((i) < int_len ? int_part[i] - '0' : frac_part[(i) - int_len] - '0')
+
+	/* The value is 0.<digits> * 10^point */
+	n = int_len + frac_len;
+	point = int_len + exponent;
+	dscale = n - point > 0 ? n - point : 0;
+	if( dscale > 0x3FFF ) return -1;
+
+	for( first = 0; first < n && NUMERIC_DIGIT(first) == 0; first++ );
+	if( first == n ){
+		/* Zero is sent without digits */
+		ndigits = 0;
+		weight = 0;
+		neg = 0;
+	} else {
+		for( last = n - 1; NUMERIC_DIGIT(last) == 0; last-- );
+		/* The power of ten of each digit i is point - 1 - i */
+		weight = floordiv4( point - 1 - first );
+		ndigits = weight - floordiv4( point - 1 - last ) + 1;
+		if( weight > 0x7FFF || weight - ndigits + 1 < -0x8000 ) return -1;
+	}
+
+	if( out ){
+		write_nbo16( ndigits, out );
+		write_nbo16( weight, out + 2 );
+		write_nbo16( neg ? NUMERIC_NEG : NUMERIC_POS, out + 4 );
+		write_nbo16( dscale, out + 6 );
+
+		for( k = 0; k < ndigits; k++ ){
+			int64_t group_exp = (weight - k) * 4;
+			int digit = 0, pos;
+
+			for( pos = 0; pos < 4; pos++ ){
+				int64_t i = point - 1 - (group_exp + pos);
+				if( i >= first && i <= last )
+					digit += NUMERIC_DIGIT(i) * numeric_pow10[pos];
+			}
+			write_nbo16( digit, out + 8 + k * 2 );
+		}
+	}
+#undef NUMERIC_DIGIT
+	return (int)(8 + ndigits * 2);
+
+special:
+	if( out ){
+		write_nbo16( 0, out );
+		write_nbo16( 0, out + 2 );
+		write_nbo16( sign, out + 4 );
+		write_nbo16( 0, out + 6 );
+	}
+	return 8;
+}
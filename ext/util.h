@@ -62,4 +62,34 @@ int base64_decode( char *out, char *in, unsigned int len);
 
 int rbpg_strncasecmp(const char *s1, const char *s2, size_t n);
 
+/* Date and time as output by PostgreSQL with DateStyle ISO */
+typedef struct {
+	/* 1 for infinity, -1 for -infinity, 0 otherwise */
+	int infinity;
+	/* Astronomical year numbering: 1 BC is year 0 */
+	int year;
+	int mon;
+	int day;
+	int hour;
+	int min;
+	int sec;
+	int nsec;
+	int has_time;
+	int has_tz;
+	/* Seconds east of UTC */
+	int tz_offset;
+} t_pg_iso_timestamp;
+
+int pg_parse_iso_timestamp(const char *val, t_pg_iso_timestamp *ts);
+int64_t pg_days_from_civil(int64_t year, int mon, int day);
+void pg_civil_from_days(int64_t days, int64_t *p_year, int *p_mon, int *p_day);
+
+/* Microseconds and days between 1970-01-01 and 2000-01-01 (the PostgreSQL epoch) */
+#define POSTGRES_EPOCH_USEC INT64_C(946684800000000)
+#define POSTGRES_EPOCH_DAYS 10957
+#define USEC_PER_DAY INT64_C(86400000000)
+
+int pg_numeric_bin_to_str(const char *val, int len, char *out);
+int pg_numeric_str_to_bin(const char *str, int len, char *out);
+
 #endif /* end __utils_h */
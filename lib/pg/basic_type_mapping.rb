@@ -111,8 +111,8 @@ module PG::BasicTypeRegistry
 		[
 			[0, :encoder, PG::TextEncoder::Array],
 			[0, :decoder, PG::TextDecoder::Array],
-			[1, :encoder, nil],
-			[1, :decoder, nil],
+			[1, :encoder, PG::BinaryEncoder::Array],
+			[1, :decoder, PG::BinaryDecoder::Array],
 		].inject([]) do |h, (format, direction, arraycoder)|
 			h[format] ||= {}
 			h[format][direction] = CoderMap.new result, CODERS_BY_NAME[format][direction], format, arraycoder
@@ -154,7 +154,7 @@ module PG::BasicTypeRegistry
 	alias_type    0, 'int8', 'int2'
 	alias_type    0, 'oid',  'int2'
 
-	# register_type 0, 'numeric', OID::Decimal.new
+	register_type 0, 'numeric', nil, PG::TextDecoder::Numeric
 	register_type 0, 'text', PG::TextEncoder::String, PG::TextDecoder::String
 	alias_type 0, 'varchar', 'text'
 	alias_type 0, 'char', 'text'
@@ -213,6 +213,11 @@ module PG::BasicTypeRegistry
 	register_type 1, 'bool', PG::BinaryEncoder::Boolean, PG::BinaryDecoder::Boolean
 	register_type 1, 'float4', nil, PG::BinaryDecoder::Float
 	register_type 1, 'float8', nil, PG::BinaryDecoder::Float
+	register_type 1, 'numeric', PG::BinaryEncoder::Numeric, PG::BinaryDecoder::Numeric
+	register_type 1, 'timestamp', PG::BinaryEncoder::TimestampWithoutTimeZone, PG::BinaryDecoder::TimestampWithoutTimeZone
+	register_type 1, 'timestamptz', PG::BinaryEncoder::TimestampWithTimeZone, PG::BinaryDecoder::TimestampWithTimeZone
+	register_type 1, 'date', PG::BinaryEncoder::Date, PG::BinaryDecoder::Date
+	register_type 1, 'interval', PG::BinaryEncoder::Interval, PG::BinaryDecoder::Interval
 end
 
 # Simple set of rules for type casting common PostgreSQL types to Ruby.
@@ -28,6 +28,7 @@ module PG
 			{
 				oid: oid,
 				format: format,
+				flags: flags,
 				name: name,
 			}
 		end
@@ -54,6 +55,14 @@ module PG
 		end
 	end
 
+	class SimpleDecoder < SimpleCoder
+		def to_h
+			super.merge!({
+				memo_size: memo_size,
+			})
+		end
+	end
+
 	class CompositeCoder < Coder
 		def to_h
 			super.merge!({
@@ -70,6 +79,14 @@ module PG
 		end
 	end
 
+	class CompositeDecoder < CompositeCoder
+		def to_h
+			super.merge!({
+				memo_size: memo_size,
+			})
+		end
+	end
+
 	class CopyCoder < Coder
 		def to_h
 			super.merge!({
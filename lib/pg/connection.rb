@@ -203,6 +203,34 @@ class PG::Connection
 		end
 	end
 
+	#  call-seq:
+	#     conn.exec_to_spool( sql, path: nil, rows_per_chunk: 10000 ) -> PG::SpooledResult
+	#
+	# Execute +sql+ and write the result to a spool file instead of the memory.
+	#
+	# The rows are retrieved in chunked rows mode (or single row mode with
+	# libpq versions before 17) and are written to the file while they are
+	# transferred. Only up to +rows_per_chunk+ rows are held by libpq at the
+	# same time, so that the memory usage doesn't depend on the size of the result.
+	#
+	# If +path+ is +nil+, an anonymous temporary file is used.
+	# See PG::SpooledResult for the read API.
+	#
+	# Example:
+	#   res = conn.exec_to_spool( "SELECT * FROM huge_table" )
+	#   res.ntuples                # => 50000000
+	#   res.each_row {|row| p row }
+	#   res.close
+	def exec_to_spool( sql, path: nil, rows_per_chunk: 10_000 )
+		send_query( sql )
+		set_chunked_rows_mode( rows_per_chunk )
+		PG::SpooledResult.new( get_result, path )
+	ensure
+		while res=get_result
+			res.clear
+		end
+	end
+
 	# Backward-compatibility aliases for stuff that's moved into PG.
 	class << self
 		define_method( :isthreadsafe, &PG.method(:isthreadsafe) )
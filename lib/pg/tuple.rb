@@ -0,0 +1,23 @@
+#!/usr/bin/env ruby
+
+require 'pg' unless defined?( PG )
+
+
+class PG::Tuple
+
+	### Return a String representation of the object suitable for debugging.
+	def inspect
+		"#<#{self.class} #{self.map{|k,v| "#{k}: #{v.inspect}" }.join(", ")}>"
+	end
+
+	### Returns +true+ if the tuple has a field with the given name.
+	def has_key?(key)
+		!index(key).nil?
+	end
+	alias key? has_key?
+
+	### Invokes block for each field name of the tuple.
+	def each_key(&block)
+		keys.each(&block)
+	end
+end
@@ -42,6 +42,12 @@ describe 'Basic type mapping' do
 
 			expect( result_typenames(res) ).to eq( ['bigint[]', 'bigint[]', 'double precision[]', 'text[]'] )
 		end
+
+		it "shouldn't truncate Float elements of Integer arrays" do
+			expect{
+				@conn.exec_params( "SELECT $1", [[1, 2.7]], nil, basic_type_mapping )
+			}.to raise_error(PG::InvalidTextRepresentation)
+		end
 	end
 
 
@@ -1148,6 +1148,61 @@ describe PG::Connection do
 				expect( first_result.result_status ).to eq( PG::PGRES_SINGLE_TUPLE )
 			end
 		end
+
+		describe "result limits" do
+			after( :each ) do
+				@conn.max_result_rows = nil
+				@conn.max_result_bytes = nil
+			end
+
+			it "can set and retrieve the limits" do
+				expect( @conn.max_result_rows ).to be_nil
+				@conn.max_result_rows = 10
+				@conn.max_result_bytes = 1000
+				expect( @conn.max_result_rows ).to eq( 10 )
+				expect( @conn.max_result_bytes ).to eq( 1000 )
+				expect{ @conn.max_result_rows = -1 }.to raise_error(ArgumentError)
+			end
+
+			it "returns results within the limits unchanged" do
+				res = @conn.exec( "SELECT generate_series(1, 2500) AS n", max_result_rows: 2500 )
+				expect( res.ntuples ).to eq( 2500 )
+				expect( res.cmd_tuples ).to eq( 2500 )
+				expect( res.cmd_status ).to eq( "SELECT 2500" )
+				expect( res.result_status ).to eq( PG::PGRES_TUPLES_OK )
+				expect( res.field_values('n').last ).to eq( '2500' )
+				expect( @conn.exec_params( "SELECT $1::text", ['x'], 0, max_result_bytes: 1 ).values ).to eq( [['x']] )
+			end
+
+			it "cancels queries exceeding the limits" do
+				expect {
+					@conn.exec( "SELECT generate_series(1, 2501)", max_result_rows: 2500 )
+				}.to raise_error(PG::ResultTooLarge, /max_result_rows of 2500/){|err| expect(err.connection).to eq(@conn) }
+				@conn.max_result_bytes = 100
+				expect {
+					@conn.async_exec( "SELECT repeat('x', 1000)" )
+				}.to raise_error(PG::ResultTooLarge, /max_result_bytes/)
+				expect( @conn.exec( "SELECT 1" ).values ).to eq( [['1']] )
+			end
+
+			it "can disable connection limits per call" do
+				@conn.max_result_rows = 1
+				expect( @conn.exec( "SELECT generate_series(1, 5)", max_result_rows: nil ).ntuples ).to eq( 5 )
+				expect{ @conn.exec( "SELECT 1", limit: 1 ) }.to raise_error(ArgumentError, /unknown option/)
+			end
+
+			it "enforces the limits in streaming mode" do
+				@conn.max_result_rows = 10
+				@conn.send_query( "SELECT generate_series(1, 20)" )
+				@conn.set_single_row_mode
+				rows = []
+				expect {
+					@conn.get_result.stream_each_row{|row| rows << row }
+				}.to raise_error(PG::ResultTooLarge)
+				expect( rows.length ).to eq( 10 )
+				expect( @conn.get_result ).to be_nil
+			end
+		end
 	end
 
 	context "multinationalization support", :ruby_19 do
@@ -0,0 +1,79 @@
+#!/usr/bin/env rspec
+# encoding: utf-8
+
+require_relative '../helpers'
+
+require 'pg'
+
+describe PG::Result::PackedColumn do
+	let!(:result) { @conn.exec( "SELECT * FROM (VALUES (1, 1.5::float8, '2000-01-01 00:00:00+00'::timestamptz), (NULL, 'NaN', 'infinity'), (-7, '-Infinity', '1970-01-02 01:00:00.5+01')) AS t(i, f, t)" ) }
+
+	it "packs integer columns" do
+		col = result.column_pack('i', :int32)
+		expect( col.data.unpack('l*') ).to eq( [1, 0, -7] )
+		expect( col.type ).to eq( :int32 )
+		expect( col.format ).to eq( 'l' )
+		expect( col.length ).to eq( 3 )
+		expect( col.data ).to be_frozen
+	end
+
+	it "flags NULL values in a bitmap" do
+		col = result.column_pack(0, :int64)
+		expect( col.null_bitmap.unpack('b*').first ).to start_with( '010' )
+		expect( col.null_count ).to eq( 1 )
+		expect( col[0] ).to eq( 1 )
+		expect( col[1] ).to be_nil
+		expect( col[-1] ).to eq( -7 )
+	end
+
+	it "packs float columns" do
+		data = result.column_pack('f', :float64).data.unpack('d*')
+		expect( data[0] ).to eq( 1.5 )
+		expect( data[1] ).to be_nan
+		expect( data[2] ).to eq( -Float::INFINITY )
+		expect( result.column_pack('i', :float32)[2] ).to eq( -7.0 )
+	end
+
+	it "packs timestamps as microseconds since the Unix epoch" do
+		@conn.exec( "SET TimeZone TO 'Europe/Berlin'" )
+		res = @conn.exec( "SELECT '2000-01-01 00:00:00+00'::timestamptz, 'infinity'::timestamptz, '1970-01-02 01:00:00.5+01'::timestamptz, '2024-02-29'::date" )
+		values = res.fields.size.times.map{|i| res.column_pack(i, :timestamp)[0] }
+		expect( values ).to eq( [946684800000000, 2**63-1, 86400500000, 1709164800000000] )
+		@conn.exec( "RESET TimeZone" )
+	end
+
+	it "packs binary format columns" do
+		res = @conn.exec_params( "SELECT 5::int2, 2.5::float8, '2000-01-02'::date, '2000-01-01 00:00:01'::timestamp", [], 1 )
+		expect( res.column_pack(0, :int64)[0] ).to eq( 5 )
+		expect( res.column_pack(1, :float32)[0] ).to eq( 2.5 )
+		expect( res.column_pack(2, :timestamp)[0] ).to eq( 946771200000000 )
+		expect( res.column_pack(3, :timestamp)[0] ).to eq( 946684801000000 )
+		expect{ res.column_pack(1, :int64) }.to raise_error(ArgumentError, /float/)
+	end
+
+	it "checks the type of binary format columns" do
+		res = @conn.exec_params( "SELECT 'abcdefgh'::text, 1.5::numeric, 5::int8, '2000-01-02'::date", [], 1 )
+		expect{ res.column_pack(0, :int64) }.to raise_error(ArgumentError, /unsupported type OID 25/)
+		expect{ res.column_pack(1, "float64") }.to raise_error(ArgumentError, /unsupported type OID 1700/)
+		expect{ res.column_pack(2, :timestamp) }.to raise_error(ArgumentError, /integer column .* as timestamp/)
+		expect{ res.column_pack(3, "int64") }.to raise_error(ArgumentError, /date\/timestamp column .* as int64/)
+		expect( res.column_pack(2, :float64)[0] ).to eq( 5.0 )
+	end
+
+	it "raises an error for invalid values" do
+		expect{ result.column_pack('f', :int32) }.to raise_error(ArgumentError, /invalid value/)
+		expect{ @conn.exec("SELECT 100000").column_pack(0, :int16) }.to raise_error(RangeError)
+		expect{ result.column_pack('i', :int8) }.to raise_error(ArgumentError, /invalid pack type/)
+	end
+
+	it "exports the data per MemoryView" do
+		require 'fiddle'
+		skip "Fiddle::MemoryView is not available" unless defined?(Fiddle::MemoryView)
+		view = Fiddle::MemoryView.new( result.column_pack('i', :int64) )
+		expect( view.format ).to eq( 'q' )
+		expect( view.item_size ).to eq( 8 )
+		expect( view.shape ).to eq( [3] )
+		expect( view[2] ).to eq( -7 )
+		view.release
+	end
+end
@@ -0,0 +1,100 @@
+#!/usr/bin/env rspec
+# encoding: utf-8
+
+require_relative '../helpers'
+
+require 'pg'
+
+describe PG::Result::Index do
+	let!(:result) { @conn.exec( "VALUES(1, 'a'), (2, 'b'), (1, 'c'), (NULL, 'd')" ) }
+
+	describe "index_by" do
+		let!(:index) { result.index_by("column1") }
+
+		it "returns the last row of each key as PG::Tuple" do
+			expect( index["1"] ).to be_kind_of( PG::Tuple )
+			expect( index["1"]["column2"] ).to eq( "c" )
+			expect( index["2"]["column2"] ).to eq( "b" )
+		end
+
+		it "converts non String keys per to_s" do
+			expect( index[1]["column2"] ).to eq( "c" )
+			expect( index[2].values ).to eq( ["2", "b"] )
+		end
+
+		it "returns nil for unknown keys" do
+			expect( index["3"] ).to be_nil
+			expect( index[nil] ).to be_nil
+		end
+
+		it "doesn't index NULL keys" do
+			expect( index.size ).to eq( 2 )
+			expect( index.keys ).to eq( ["1", "2"] )
+		end
+
+		it "can check for keys" do
+			expect( index.key?(1) ).to be_truthy
+			expect( index.key?("2") ).to be_truthy
+			expect( index.key?(3) ).to be_falsey
+		end
+
+		it "can be iterated" do
+			expect( index.map{|k, t| [k, t["column2"]] } ).to eq( [["1", "c"], ["2", "b"]] )
+			expect( index.each.size ).to eq( 2 )
+		end
+
+		it "accepts column numbers" do
+			expect( result.index_by(1)["d"]["column1"] ).to be_nil
+		end
+
+		it "decodes keys per type map" do
+			result.type_map = PG::TypeMapByColumn.new [PG::TextDecoder::Integer.new, nil]
+			expect( result.index_by(0).keys ).to eq( [1, 2] )
+		end
+
+		it "raises an error for unknown columns" do
+			expect{ result.index_by("x") }.to raise_error(IndexError, /no such field/)
+			expect{ result.index_by(2) }.to raise_error(IndexError, /no column/)
+		end
+
+		it "raises an error after the result was cleared" do
+			result.clear
+			expect{ index["1"] }.to raise_error(PG::Error, /cleared/)
+		end
+
+		it "calls index_by of the ancestors without column" do
+			index_by = Module.new do
+				def index_by
+					each_with_object({}){|row, h| h[yield(row)] = row }
+				end
+			end
+			PG::Result.send( :include, index_by )
+
+			rows = result.index_by{|row| row["column2"] }
+			expect( rows ).to be_kind_of( Hash )
+			expect( rows["c"]["column1"] ).to eq( "1" )
+		end
+	end
+
+	describe "group_by" do
+		let!(:index) { result.group_by(:column1) }
+
+		it "returns all rows of each key in result order" do
+			expect( index[1].map{|t| t["column2"] } ).to eq( ["a", "c"] )
+			expect( index[2].map{|t| t["column2"] } ).to eq( ["b"] )
+			expect( index[3] ).to be_nil
+		end
+
+		it "can be iterated" do
+			expect( index.map{|k, ts| [k, ts.size] } ).to eq( [["1", 2], ["2", 1]] )
+		end
+
+		it "behaves like Enumerable#group_by without column" do
+			groups = result.group_by{|row| row["column1"] }
+			expect( groups ).to be_kind_of( Hash )
+			expect( groups["1"].map{|row| row["column2"] } ).to eq( ["a", "c"] )
+			expect( groups[nil].map{|row| row["column2"] } ).to eq( ["d"] )
+			expect( result.group_by ).to be_kind_of( Enumerator )
+		end
+	end
+end
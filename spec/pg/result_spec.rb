@@ -4,6 +4,8 @@
 require_relative '../helpers'
 
 require 'pg'
+require 'stringio'
+require 'bigdecimal'
 
 
 describe PG::Result do
@@ -14,6 +16,14 @@ describe PG::Result do
 		expect( res[0]['b'] ).to eq( '2' )
 	end
 
+	it "returns independent hashes for each row" do
+		res = @conn.exec("SELECT 1 AS a, 2 AS b, 3 AS a")
+		row = res[0]
+		expect( row ).to eq( {'a' => '3', 'b' => '2'} )
+		row['c'] = 'x'
+		expect( res[0] ).to eq( {'a' => '3', 'b' => '2'} )
+	end
+
 	it "yields a row as an array" do
 		res = @conn.exec("SELECT 1 AS a, 2 AS b")
 		list = []
@@ -39,6 +49,149 @@ describe PG::Result do
 		expect( e.to_a ).to eq [{'a'=>'1', 'b'=>'2'}]
 	end
 
+	it "yields rows in batches" do
+		res = @conn.exec("SELECT generate_series(1,5) AS a, 'x' AS b")
+		expect( res.each_row_batch(2).size ).to eq( 3 )
+		expect( res.each_row_batch(2).to_a ).to eq(
+			[[["1", "x"], ["2", "x"]], [["3", "x"], ["4", "x"]], [["5", "x"]]]
+		)
+	end
+
+	it "doesn't preallocate batches beyond the number of rows" do
+		res = @conn.exec("SELECT generate_series(1,3) AS a")
+		expect( res.each_row_batch(2**40).to_a ).to eq( [[["1"], ["2"], ["3"]]] )
+	end
+
+	it "reuses the batch Arrays in reuse mode" do
+		res = @conn.exec("SELECT generate_series(1,5) AS a")
+		batches = []
+		rows = []
+		res.each_row_batch(2, reuse: true) do |batch|
+			batches << batch
+			rows << batch.first
+			expect( batch.length ).to eq( batches.length == 3 ? 1 : 2 )
+		end
+		expect( batches.uniq(&:object_id).length ).to eq( 1 )
+		expect( rows.uniq(&:object_id).length ).to eq( 1 )
+		expect( batches.first ).to eq( [["5"]] )
+	end
+
+	it "builds Struct objects from rows" do
+		point = Struct.new(:y, :x, :z)
+		res = @conn.exec("SELECT 1 AS x, 2 AS y, 3 AS w UNION ALL SELECT 4, 5, 6")
+		expect( res.to_structs(point) ).to eq( [point.new("2", "1", nil), point.new("5", "4", nil)] )
+		expect( res.each_as(point).size ).to eq( 2 )
+		expect( res.each_as(point).to_a ).to eq( res.to_structs(point) )
+	end
+
+	it "builds keyword_init Struct objects from rows" do
+		skip "keyword_init is not available" unless RUBY_VERSION >= "2.5"
+		point = Struct.new(:x, :y, keyword_init: true)
+		res = @conn.exec("SELECT 1 AS x, 2 AS y")
+		expect( res.to_structs(point) ).to eq( [point.new(x: "1", y: "2")] )
+	end
+
+	it "calls initialize of keyword_init Struct classes" do
+		skip "keyword_init is not available" unless RUBY_VERSION >= "2.5"
+		point = Struct.new(:x, :y, keyword_init: true) do
+			def initialize(**kwargs)
+				super
+				self.y = y.to_i
+			end
+		end
+		res = @conn.exec("SELECT 1 AS x, 2 AS y")
+		expect( res.each_as(point).to_a ).to eq( [point.new(x: "1", y: "2")] )
+		expect( res.to_structs(point).first.y ).to eq( 2 )
+	end
+
+	it "builds Data objects from rows" do
+		skip "Data is not available" unless defined?(::Data) && ::Data.respond_to?(:define)
+		point = ::Data.define(:x, :y)
+		res = @conn.exec("SELECT 1 AS x, 2 AS y")
+		expect( res.to_structs(point) ).to eq( [point.new(x: "1", y: "2")] )
+	end
+
+	it "complains about classes other than Struct or Data" do
+		res = @conn.exec("SELECT 1 AS x")
+		expect{ res.to_structs(String) }.to raise_error(TypeError, /expected Struct or Data/)
+	end
+
+	describe "Arrow IPC export" do
+		def arrow_messages(ipc)
+			msgs = []
+			pos = 0
+			loop do
+				marker, len = ipc.byteslice(pos, 8).unpack("l<l<")
+				expect( marker ).to eq( -1 )
+				pos += 8
+				break if len == 0
+				meta = ipc.byteslice(pos, len)
+				# bodyLength is the only 8 byte field of the Message table
+				root = meta.unpack1("L<")
+				vtable = root - meta.byteslice(root, 4).unpack1("l<")
+				body_off = meta.byteslice(vtable + 4 + 3 * 2, 2).unpack1("S<")
+				body_len = meta.byteslice(root + body_off, 8).unpack1("q<")
+				msgs << [meta, ipc.byteslice(pos + len, body_len)]
+				pos += len + body_len
+			end
+			expect( pos ).to eq( ipc.bytesize )
+			msgs
+		end
+
+		it "writes schema and record batch" do
+			res = @conn.exec("SELECT 1::int4 AS i, 'abc'::text AS t UNION ALL SELECT NULL, 'de'")
+			ipc = res.to_arrow_ipc
+			expect( ipc.encoding ).to eq( Encoding::BINARY )
+			schema, batch = arrow_messages(ipc)
+			expect( schema[0] ).to include( "i\0" ).and include( "t\0" )
+			expect( schema[1] ).to eq( "" )
+			# validity bitmap and values of column "i"
+			expect( batch[1].byteslice(0, 1).unpack1("C") ).to eq( 0b01 )
+			expect( batch[1].byteslice(8, 8).unpack("l<l<") ).to eq( [1, 0] )
+			expect( batch[1] ).to include( "abcde" )
+		end
+
+		it "writes only the schema of an empty result" do
+			res = @conn.exec("SELECT 1 AS i WHERE false")
+			expect( arrow_messages(res.to_arrow_ipc).length ).to eq( 1 )
+		end
+
+		it "can stream results to an IO", :postgresql_92 do
+			@conn.send_query( "SELECT generate_series(1,5)::int8 AS a" )
+			@conn.set_single_row_mode
+			io = StringIO.new("".b)
+			@conn.get_result.stream_arrow_ipc( io, batch: 2 )
+			msgs = arrow_messages(io.string)
+			expect( msgs.length ).to eq( 4 )
+			expect( msgs[1][1].byteslice(8, 16).unpack("q<q<") ).to eq( [1, 2] )
+			expect( msgs[3][1].byteslice(8, 8).unpack1("q<") ).to eq( 5 )
+			expect( @conn.get_result ).to be_nil
+		end
+	end
+
+	it "writes CSV to an IO" do
+		res = @conn.exec(%q{SELECT 1 AS a, 'x,y' AS "b""c", NULL AS n, '' AS e UNION ALL SELECT 2, 'q"', 'z', 'e'})
+		io = StringIO.new
+		expect( res.write_csv(io) ).to eq( res )
+		expect( io.string ).to eq( %Q{a,"b""c",n,e\n1,"x,y",,""\n2,"q""",z,e\n} )
+
+		io = StringIO.new
+		res.write_csv(io, headers: false)
+		expect( io.string ).to eq( %Q{1,"x,y",,""\n2,"q""",z,e\n} )
+	end
+
+	it "writes JSON lines to an IO" do
+		res = @conn.exec(%q{SELECT 1 AS i, 1.5::float8 AS f, 'NaN'::float8 AS nan, true AS b, E'x"\\\\y\n' AS t, '{"a": [1]}'::jsonb AS j, NULL AS n})
+		io = StringIO.new
+		expect( res.write_jsonl(io) ).to eq( res )
+		expect( io.string ).to eq( %q[{"i":1,"f":1.5,"nan":"NaN","b":true,"t":"x\"\\\\y\n","j":{"a": [1]},"n":null}] + "\n" )
+	end
+
+	it "refuses to write binary format columns as CSV" do
+		res = @conn.exec_params("SELECT 1", [], 1)
+		expect{ res.write_csv(StringIO.new) }.to raise_error(ArgumentError, /binary format/)
+	end
+
 	context "result streaming", :postgresql_92 do
 		it "can iterate over all tuples in single row mode" do
 			@conn.send_query( "SELECT generate_series(2,4) AS a; SELECT 1 AS b, generate_series(5,6) AS c" )
@@ -72,6 +225,57 @@ describe PG::Result do
 			expect( @conn.get_result ).to be_nil
 		end
 
+		it "can iterate over all rows in chunked rows mode" do
+			@conn.send_query( "SELECT generate_series(2,6) AS a" )
+			@conn.set_chunked_rows_mode(2)
+			res = @conn.get_result
+			if PG.const_defined?(:PGRES_TUPLES_CHUNK)
+				expect( res.result_status ).to eq( PG::PGRES_TUPLES_CHUNK )
+				expect( res.ntuples ).to eq( 2 )
+			end
+			expect( res.stream_each_row.to_a ).to eq( [["2"], ["3"], ["4"], ["5"], ["6"]] )
+			expect( @conn.get_result ).to be_nil
+		end
+
+		it "can iterate over batches of tuples and rows" do
+			@conn.send_query( "SELECT generate_series(2,6) AS a; SELECT generate_series(7,8) AS b" )
+			@conn.set_chunked_rows_mode(3)
+			expect(
+				@conn.get_result.stream_each( batch: 2 ).to_a
+			).to eq(
+				[[{'a'=>"2"}, {'a'=>"3"}], [{'a'=>"4"}, {'a'=>"5"}], [{'a'=>"6"}]]
+			)
+			expect(
+				@conn.get_result.stream_each_row( batch: 2 ).to_a
+			).to eq(
+				[[["7"], ["8"]]]
+			)
+			expect( @conn.get_result ).to be_nil
+		end
+
+		it "can reuse the row Arrays of batches" do
+			@conn.send_query( "SELECT generate_series(2,6) AS a" )
+			@conn.set_single_row_mode
+			batches = []
+			row_ids = []
+			@conn.get_result.stream_each_row( batch: 2, reuse: true ) do |rows|
+				batches << rows.map(&:dup)
+				row_ids << rows.first.object_id
+			end
+			expect( batches ).to eq( [[["2"], ["3"]], [["4"], ["5"]], [["6"]]] )
+			expect( row_ids.uniq.length ).to eq( 1 )
+			expect( @conn.get_result ).to be_nil
+		end
+
+		it "complains about an invalid batch size" do
+			@conn.send_query( "SELECT 1" )
+			@conn.set_single_row_mode
+			expect{
+				@conn.get_result.stream_each_row( batch: 0 ){}
+			}.to raise_error(ArgumentError, /batch size/)
+			@conn.get_last_result
+		end
+
 		it "complains when not in single row mode" do
 			@conn.send_query( "SELECT generate_series(2,4)" )
 			expect{
@@ -242,6 +446,21 @@ describe PG::Result do
 		expect( res.values ).to eq( [ ["bar"], ["bar2"] ] )
 	end
 
+	it "reports the memory of the result" do
+		res = @conn.exec( "SELECT repeat('x', 100000)" )
+		if res.memsize == 0
+			skip "PQresultMemorySize() is not available"
+		end
+		expect( res.memsize ).to be > 100000
+		live_bytes = PG::Result.live_bytes
+		expect( live_bytes ).to be >= res.memsize
+
+		memsize = res.memsize
+		res.clear
+		expect( res.memsize ).to eq( 0 )
+		expect( PG::Result.live_bytes ).to eq( live_bytes - memsize )
+	end
+
 	# PQfmod
 	it "can return the type modifier for a result column" do
 		@conn.exec( 'CREATE TABLE fmodtest ( foo varchar(33) )' )
@@ -343,6 +562,142 @@ describe PG::Result do
 		expect{ res.field_values(:x) }.to raise_error(TypeError)
 	end
 
+	describe "field_name_type" do
+		it "uses interned String field names by default" do
+			r1 = @conn.exec( "SELECT 1 AS a" )
+			r2 = @conn.exec( "SELECT 2 AS a" )
+			expect( r1.field_name_type ).to eq( :string )
+			expect( r1.fields ).to eq( ['a'] )
+			expect( r1.fields.first ).to be_frozen
+			expect( r1.fields.first ).to equal( r2.fields.first )
+			expect( r1[0].keys.first ).to equal( r2[0].keys.first )
+		end
+
+		it "can use Symbol field names" do
+			res = @conn.exec( "SELECT 1 AS a, 2 AS b" )
+			res.field_name_type = :symbol
+			expect( res.fields ).to eq( [:a, :b] )
+			expect( res.fname(1) ).to eq( :b )
+			expect( res[0] ).to eq( {a: '1', b: '2'} )
+			expect( res.tuple(0)[:b] ).to eq( '2' )
+		end
+
+		it "can use static Symbol field names" do
+			res = @conn.exec( "SELECT 1 AS a" )
+			res.field_name_type = :static_symbol
+			expect( res.field_name_type ).to eq( :static_symbol )
+			expect( res.to_a ).to eq( [{a: '1'}] )
+		end
+
+		it "inherits the field name type from the connection" do
+			@conn.field_name_type = :symbol
+			begin
+				expect( @conn.field_name_type ).to eq( :symbol )
+				expect( @conn.exec( "SELECT 1 AS a" ).fields ).to eq( [:a] )
+			ensure
+				@conn.field_name_type = :string
+			end
+		end
+
+		it "can't be changed after field names are materialized" do
+			res = @conn.exec( "SELECT 1 AS a" )
+			res.fields
+			expect{ res.field_name_type = :symbol }.to raise_error(ArgumentError, /already materialized/)
+		end
+
+		it "raises an error on invalid types" do
+			res = @conn.exec( "SELECT 1 AS a" )
+			expect{ res.field_name_type = :sym }.to raise_error(ArgumentError)
+			expect{ @conn.field_name_type = "symbol" }.to raise_error(ArgumentError)
+		end
+	end
+
+	it "can return the values of several columns at once" do
+		res = @conn.exec( "SELECT 1 AS x, 'a' AS y, NULL AS z UNION ALL SELECT 2, 'b', 'c'" )
+		expect( res.columns ).to eq( [['1', '2'], ['a', 'b'], [nil, 'c']] )
+		expect( res.columns('z', 0, :y) ).to eq( [[nil, 'c'], ['1', '2'], ['a', 'b']] )
+		expect( res.columns_hash ).to eq( {'x' => ['1', '2'], 'y' => ['a', 'b'], 'z' => [nil, 'c']} )
+		expect( res.columns_hash(1) ).to eq( {'y' => ['a', 'b']} )
+		expect{ res.columns(3) }.to raise_error(IndexError)
+		expect{ res.columns('') }.to raise_error(IndexError)
+	end
+
+	it "can pluck the values of selected columns" do
+		res = @conn.exec( "SELECT 1 AS x, 'a' AS y, NULL AS z UNION ALL SELECT 2, 'b', 'c'" )
+		expect( res.pluck(:x) ).to eq( ['1', '2'] )
+		expect( res.pluck('z', 0) ).to eq( [[nil, '1'], ['c', '2']] )
+		expect{ res.pluck }.to raise_error(ArgumentError)
+		expect{ res.pluck(3) }.to raise_error(IndexError)
+	end
+
+	it "can aggregate the raw values of a column" do
+		res = @conn.exec( "VALUES (1::int8, 1.5::float8, 1.25::numeric, '2020-01-01 00:00:00+00'::timestamptz), " +
+			"(9223372036854775807, -2, 123456789012345678901234.5, '2019-06-01 12:00:00.5+02'), (NULL, NULL, NULL, NULL)" )
+		expect( res.aggregate(0, :sum) ).to eq( 9223372036854775808 )
+		expect( res.aggregate(0, :min) ).to eq( 1 )
+		expect( res.aggregate(0, :count_nonnull) ).to eq( 2 )
+		expect( res.aggregate(1, :max) ).to eq( 1.5 )
+		expect( res.aggregate(1, :avg) ).to eq( -0.25 )
+		expect( res.aggregate(2, :sum) ).to eq( BigDecimal('123456789012345678901235.75') )
+		expect( res.aggregate(2, :min) ).to eq( BigDecimal('1.25') )
+		expect( res.aggregate(3, :min) ).to eq( Time.utc(2019, 6, 1, 10, 0, Rational(1, 2)) )
+		expect( res.where(0, '<', 5).aggregate(0, :sum) ).to eq( 1 )
+		expect( res.where(0, 'is null').aggregate(0, :max) ).to be_nil
+		expect{ res.aggregate(3, :sum) }.to raise_error(ArgumentError, /not supported/)
+		expect{ res.aggregate(0, :median) }.to raise_error(ArgumentError, /unknown aggregate/)
+	end
+
+	it "can aggregate binary values of a column" do
+		res = @conn.exec_params( "VALUES (7::int4, 12345.678::numeric, 'NaN'::float8), (-3, -0.50, 2.5)", [], 1 )
+		expect( res.aggregate(0, :sum) ).to eq( 4 )
+		expect( res.aggregate(1, :sum) ).to eq( BigDecimal('12345.178') )
+		expect( res.aggregate(1, :min) ).to eq( BigDecimal('-0.5') )
+		expect( res.aggregate(2, :max) ).to be_nan
+		expect( res.aggregate(2, :min) ).to eq( 2.5 )
+	end
+
+	it "can be dumped and loaded" do
+		res = @conn.exec_params( "VALUES (1, 'a', '\\x0001'::bytea), (NULL, 'b', NULL)", [], 0 )
+		dumped = res.dump
+		expect( dumped.encoding ).to eq( Encoding::BINARY )
+
+		loaded = PG::Result.load( dumped )
+		expect( loaded.values ).to eq( res.values )
+		expect( loaded.fields ).to eq( res.fields )
+		expect( loaded.ftype(0) ).to eq( 23 )
+		expect( loaded.getisnull(1, 0) ).to be_truthy
+		expect( loaded.result_status ).to eq( PG::PGRES_TUPLES_OK )
+		expect( loaded.getvalue(0, 1).encoding ).to eq( res.getvalue(0, 1).encoding )
+
+		loaded.type_map = PG::TypeMapByColumn.new( [PG::TextDecoder::Integer.new, nil, PG::TextDecoder::Bytea.new] )
+		expect( loaded.values ).to eq( [[1, 'a', "\x00\x01".b], [nil, 'b', nil]] )
+	end
+
+	it "inherits the settings of the connection given to load" do
+		@conn.field_name_type = :symbol
+		loaded = PG::Result.load( @conn.exec("SELECT 1 AS x").dump, @conn )
+		expect( loaded.fields ).to eq( [:x] )
+	ensure
+		@conn.field_name_type = :string
+	end
+
+	it "can dump binary results" do
+		res = @conn.exec_params( "SELECT 5::int4, 1.5::float8", [], 1 )
+		loaded = PG::Result.load( res.dump )
+		expect( loaded.fformat(0) ).to eq( 1 )
+		expect( loaded.getvalue(0, 0) ).to eq( [5].pack('N') )
+	end
+
+	it "raises an error when loading invalid data" do
+		dumped = @conn.exec( "SELECT 1" ).dump
+		expect{ PG::Result.load( dumped[0..-2] ) }.to raise_error(ArgumentError, /unexpected end/)
+		expect{ PG::Result.load( dumped + "x" ) }.to raise_error(ArgumentError, /trailing data/)
+		expect{ PG::Result.load( "x" + dumped ) }.to raise_error(ArgumentError, /magic/)
+		huge = "PGR\x01".b + [0x7fffffff, 0, 0].pack("NNn")
+		expect{ PG::Result.load( huge ) }.to raise_error(ArgumentError, /unexpected end/)
+		expect{ @conn.exec( "SET search_path TO public" ).dump }.to raise_error(PG::InvalidResultStatus)
+	end
+
 	it "raises a proper exception for a nonexistant table" do
 		expect {
 			@conn.exec( "SELECT * FROM nonexistant_table" )
@@ -436,6 +791,21 @@ describe PG::Result do
 			expect( res.enum_for(:each).to_a ).to eq( [{'f' => 123}] )
 			expect( res.column_values(0) ).to eq( [123] )
 			expect( res.field_values('f') ).to eq( [123] )
+			expect( res.columns ).to eq( [[123]] )
+			expect( res.columns_hash ).to eq( {'f' => [123]} )
+			expect( res.pluck('f') ).to eq( [123] )
+		end
+
+		it "should decode columns in parallel threads" do
+			res = @conn.exec( "SELECT n, n * 0.5 AS f, n % 2 = 0 AS b, 'x' || n AS s, NULLIF(n % 3, 0) AS z FROM generate_series(1, 10000) AS n" )
+			res.type_map = PG::TypeMapByColumn.new [textdec_int, textdec_float, PG::TextDecoder::Boolean.new, nil, textdec_int]
+			values = res.values
+			expect( values[2] ).to eq( [3, 1.5, false, "x3", nil] )
+			expect( res.values(threads: 4) ).to eq( values )
+			expect( res.columns(threads: 4) ).to eq( values.transpose )
+			expect( res.columns('z', 0, threads: 3) ).to eq( values.transpose.values_at(4, 0) )
+			expect( res.columns_hash('f', threads: 2) ).to eq( {'f' => values.transpose[1]} )
+			expect{ res.values(threads: 0) }.to raise_error(ArgumentError)
 		end
 
 		it "should be usable for several querys" do
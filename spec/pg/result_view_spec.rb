@@ -0,0 +1,82 @@
+#!/usr/bin/env rspec
+# encoding: utf-8
+
+require_relative '../helpers'
+
+require 'pg'
+
+describe PG::Result::View do
+	let!(:result) { @conn.exec( "VALUES (1, 2.5, 'apple'), (2, NULL, 'banana'), (3, 10, 'apricot'), (10, 'NaN', 'x')" ) }
+
+	it "filters by numeric comparisons" do
+		expect( result.where('column1', '>', 1).rows ).to eq( [1, 2, 3] )
+		expect( result.where(0, '<=', 3).rows ).to eq( [0, 1, 2] )
+		expect( result.where('column2', '<', 3).rows ).to eq( [0] )
+		expect( result.where('column2', '>=', 2.5).rows ).to eq( [0, 2] )
+		expect( result.where('column2', '!=', 10).rows ).to eq( [0, 3] )
+	end
+
+	it "filters by byte comparisons of non numeric values" do
+		expect( result.where('column1', '=', '10').rows ).to eq( [3] )
+		expect( result.where('column3', '<', 'b').rows ).to eq( [0, 2] )
+		expect( result.where('column3', 'PREFIX', 'ap').rows ).to eq( [0, 2] )
+	end
+
+	it "filters by lists of values" do
+		expect( result.where('column3', 'IN', ['x', 'banana', nil]).rows ).to eq( [1, 3] )
+		expect( result.where('column1', :in, [1, 10]).rows ).to eq( [0, 3] )
+	end
+
+	it "filters NULL values" do
+		expect( result.where('column2', 'IS NULL').rows ).to eq( [1] )
+		expect( result.where('column2', :not_null).rows ).to eq( [0, 2, 3] )
+		expect( result.where('column2', '<', 100).rows ).to eq( [0, 2] )
+	end
+
+	it "filters binary format values" do
+		res = @conn.exec_params( "VALUES (5::int4, 1.5::float8), (-3, 7.0)", [], 1 )
+		expect( res.where(0, '>', 0).rows ).to eq( [0] )
+		expect( res.where(1, '>', 2).rows ).to eq( [1] )
+	end
+
+	it "raises an error for numeric comparison of unsupported binary types" do
+		res = @conn.exec_params( "SELECT 'ab'::text, 1.5::numeric", [], 1 )
+		expect{ res.where(0, '=', 1) }.to raise_error(ArgumentError, /type OID 25/)
+		expect{ res.where(1, '>', 1) }.to raise_error(ArgumentError, /type OID 1700/)
+		expect( res.where(0, '=', 'ab').rows ).to eq( [0] )
+	end
+
+	it "provides the iteration methods of the result" do
+		view = result.where('column1', '>', 1).where('column3', '!=', 'x')
+		expect( view.size ).to eq( 2 )
+		expect( view.to_a ).to eq( [{'column1' => '2', 'column2' => nil, 'column3' => 'banana'}, {'column1' => '3', 'column2' => '10', 'column3' => 'apricot'}] )
+		expect( view.values ).to eq( [['2', nil, 'banana'], ['3', '10', 'apricot']] )
+		expect( view.each_row.to_a ).to eq( view.values )
+		expect( view.each_tuple.map{|t| t['column3'] } ).to eq( ['banana', 'apricot'] )
+		expect( view.field_values('column1') ).to eq( ['2', '3'] )
+		expect( view[1]['column3'] ).to eq( 'apricot' )
+		expect( view.tuple(0)['column1'] ).to eq( '2' )
+		expect( view.result ).to equal( result )
+	end
+
+	it "decodes only the rows of the view" do
+		decoded = []
+		deco = Class.new(PG::SimpleDecoder) do
+			define_method(:decode) do |string, tuple, field|
+				decoded << tuple
+				string
+			end
+		end.new
+		result.type_map = PG::TypeMapByColumn.new( [deco, deco, deco] )
+		result.where('column1', '=', 3).values
+		expect( decoded.uniq ).to eq( [2] )
+	end
+
+	it "raises errors for invalid conditions" do
+		expect{ result.where('column3', '<', 5) }.to raise_error(ArgumentError, /non numeric/)
+		expect{ result.where('column1', '~', 1) }.to raise_error(ArgumentError, /unsupported operator/)
+		expect{ result.where('column1', '=') }.to raise_error(ArgumentError, /requires a value/)
+		expect{ result.where('column1', '=', nil) }.to raise_error(ArgumentError, /IS NULL/)
+		expect{ result.where('x', '=', 1) }.to raise_error(IndexError)
+	end
+end
@@ -0,0 +1,111 @@
+#!/usr/bin/env rspec
+# encoding: utf-8
+
+require_relative '../helpers'
+
+require 'pg'
+
+describe PG::SpooledResult do
+
+	it "can spool a regular result" do
+		res = @conn.exec( "SELECT 1 AS a, 'x' AS b, NULL AS c UNION ALL SELECT 2, 'y', 'z'" )
+		spool = PG::SpooledResult.new( res )
+		expect( spool.ntuples ).to eq( 2 )
+		expect( spool.nfields ).to eq( 3 )
+		expect( spool.fields ).to eq( ['a', 'b', 'c'] )
+		expect( spool.path ).to be_nil
+		expect( spool.values ).to eq( [['1', 'x', nil], ['2', 'y', 'z']] )
+		spool.close
+	end
+
+	context "with exec_to_spool", :postgresql_92 do
+		let!(:spool) { @conn.exec_to_spool( "SELECT n, 'v' || n AS v, NULLIF(n % 3, 0) AS z FROM generate_series(1, 100000) AS n", rows_per_chunk: 1000 ) }
+		after(:each) { spool.close }
+
+		it "stores all rows" do
+			expect( spool.ntuples ).to eq( 100000 )
+			expect( spool.fields ).to eq( ['n', 'v', 'z'] )
+			expect( @conn.get_result ).to be_nil
+		end
+
+		it "provides random access to the values" do
+			expect( spool.getvalue(0, 0) ).to eq( '1' )
+			expect( spool.getvalue(70000, 1) ).to eq( 'v70001' )
+			expect( spool.getvalue(2, 2) ).to be_nil
+			expect( spool.getisnull(2, 2) ).to be_truthy
+			expect( spool.getlength(99999, 1) ).to eq( 7 )
+			expect( spool[99999] ).to eq( {'n' => '100000', 'v' => 'v100000', 'z' => '1'} )
+			expect{ spool.getvalue(100000, 0) }.to raise_error(IndexError)
+		end
+
+		it "retrieves the values in the connection encoding" do
+			expect( spool.getvalue(0, 1).encoding ).to eq( @conn.internal_encoding )
+		end
+
+		it "can iterate over the rows" do
+			expect( spool.each.first ).to eq( {'n' => '1', 'v' => 'v1', 'z' => '1'} )
+			expect( spool.each_row.to_a.last ).to eq( ['100000', 'v100000', '1'] )
+			expect( spool.each_row.size ).to eq( 100000 )
+		end
+
+		it "can retrieve whole columns" do
+			expect( spool.column_values(0) ).to eq( (1..100000).map(&:to_s) )
+			expect( spool.field_values('z').compact.size ).to eq( 66667 )
+			expect{ spool.field_values('x') }.to raise_error(IndexError)
+			expect( spool.field_values(:n).size ).to eq( 100000 )
+			expect{ spool.field_values(:x) }.to raise_error(IndexError, /:x/)
+		end
+
+		it "decodes values per type map" do
+			spool.type_map = PG::TypeMapByColumn.new [PG::TextDecoder::Integer.new, nil, nil]
+			expect( spool.getvalue(41, 0) ).to eq( 42 )
+			expect( spool.column_values(0).last ).to eq( 100000 )
+
+			spool.type_map = PG::BasicTypeMapForResults.new( @conn )
+			expect( spool.type_map ).to be_kind_of( PG::TypeMapByColumn )
+			expect( spool[2] ).to eq( {'n' => 3, 'v' => 'v3', 'z' => nil} )
+		end
+
+		it "decodes columns without coder per default_type_map" do
+			tm = PG::TypeMapByColumn.new [nil, nil, PG::TextDecoder::Float.new]
+			tm.default_type_map = PG::BasicTypeMapForResults.new( @conn )
+			spool.type_map = tm
+			expect( spool[0] ).to eq( {'n' => 1, 'v' => 'v1', 'z' => 1.0} )
+
+			tm.default_type_map = PG::TypeMapInRuby.new
+			expect{ spool.type_map = tm }.to raise_error(TypeError)
+		end
+
+		it "raises an error after close" do
+			spool.close
+			expect( spool ).to be_closed
+			expect{ spool.values }.to raise_error(PG::Error, /closed/)
+		end
+	end
+
+	it "splits wide results into smaller segments" do
+		res = @conn.exec( "SELECT #{ (1..1600).map{|i| "#{i} AS c#{i}" }.join(",") } FROM generate_series(1, 2000)" )
+		spool = PG::SpooledResult.new( res )
+		expect( spool.ntuples ).to eq( 2000 )
+		expect( spool.getvalue(1999, 1599) ).to eq( '1600' )
+		spool.close
+	end
+
+	it "keeps the spool file at a given path", :postgresql_92 do
+		path = File.join( TEST_DIRECTORY, "spooled_result.bin" )
+		spool = @conn.exec_to_spool( "SELECT generate_series(1, 10) AS n", path: path )
+		expect( spool.path ).to eq( path )
+		expect( File.size(path) ).to be > 0
+		expect( spool.values.flatten ).to eq( ('1'..'10').to_a )
+		spool.close
+		expect( File.exist?(path) ).to be_truthy
+		File.unlink( path )
+	end
+
+	it "raises server errors and leaves the connection usable", :postgresql_92 do
+		expect{
+			@conn.exec_to_spool( "SELECT 1/(5000 - n) FROM generate_series(1, 10000) AS n" )
+		}.to raise_error(PG::DivisionByZero)
+		expect( @conn.exec("SELECT 1").values ).to eq( [['1']] )
+	end
+end
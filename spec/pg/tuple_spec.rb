@@ -0,0 +1,117 @@
+#!/usr/bin/env rspec
+# encoding: utf-8
+
+require_relative '../helpers'
+
+require 'pg'
+
+describe PG::Tuple do
+	let!(:typemap) { PG::BasicTypeMapForResults.new(@conn) }
+	let!(:result2x2) { @conn.exec( "VALUES(1, 'a'), (2, 'b')" ) }
+	let!(:tuple0) { result2x2.tuple(0) }
+	let!(:tuple1) { result2x2.tuple(1) }
+
+	describe "[]" do
+		it "returns nil for invalid keys" do
+			expect( tuple0["x"] ).to be_nil
+			expect( tuple0[2] ).to be_nil
+			expect( tuple0[-3] ).to be_nil
+		end
+
+		it "supports array like access" do
+			expect( tuple0[0] ).to eq( "1" )
+			expect( tuple0[1] ).to eq( "a" )
+			expect( tuple1[-1] ).to eq( "b" )
+		end
+
+		it "supports hash like access" do
+			expect( tuple0["column1"] ).to eq( "1" )
+			expect( tuple1["column2"] ).to eq( "b" )
+		end
+
+		it "casts lazy and caches result" do
+			a = []
+			deco = Class.new(PG::SimpleDecoder) do
+				define_method(:decode) do |*args|
+					a << args
+					args.last
+				end
+			end.new
+
+			result2x2.map_types!(PG::TypeMapByColumn.new([deco, deco]))
+			t = result2x2.tuple(1)
+
+			# cast and cache at first call to [0]
+			a.clear
+			expect( t[0] ).to eq( 0 )
+			expect( a ).to eq([["2", 1, 0]])
+
+			# use cache at second call to [0]
+			a.clear
+			expect( t[0] ).to eq( 0 )
+			expect( a ).to eq([])
+
+			# cast and cache at first call to [1]
+			a.clear
+			expect( t[1] ).to eq( 1 )
+			expect( a ).to eq([["b", 1, 1]])
+		end
+	end
+
+	describe "fetch" do
+		it "raises proper errors for invalid keys" do
+			expect{ tuple0.fetch("x") }.to raise_error(IndexError)
+			expect{ tuple0.fetch(2) }.to raise_error(IndexError)
+			expect{ tuple0.fetch(-3) }.to raise_error(IndexError)
+		end
+
+		it "supports default values and blocks" do
+			expect( tuple0.fetch("x", "d") ).to eq( "d" )
+			expect( tuple0.fetch(2){|k| [k] } ).to eq( [2] )
+		end
+
+		it "supports array and hash like access" do
+			expect( tuple0.fetch(-2) ).to eq( "1" )
+			expect( tuple1.fetch("column2") ).to eq( "b" )
+		end
+	end
+
+	it "responds to each" do
+		expect( tuple0.each.to_a ).to eq( [["column1", "1"], ["column2", "a"]] )
+		expect( tuple1.each_value.to_a ).to eq( ["2", "b"] )
+	end
+
+	it "responds to values, keys and length" do
+		expect( tuple0.values ).to eq( ["1", "a"] )
+		expect( tuple0.keys ).to eq( ["column1", "column2"] )
+		expect( tuple0.length ).to eq( 2 )
+		expect( tuple0.size ).to eq( 2 )
+	end
+
+	it "responds to index and has_key?" do
+		expect( tuple0.index("column2") ).to eq( 1 )
+		expect( tuple0.index("x") ).to be_nil
+		expect( tuple0.has_key?("column1") ).to eq( true )
+		expect( tuple0.key?("x") ).to eq( false )
+	end
+
+	it "can be inspected" do
+		expect( tuple1.inspect ).to eq( '#<PG::Tuple column1: "2", column2: "b">' )
+	end
+
+	it "is yielded by Result#each_tuple" do
+		expect( result2x2.each_tuple.to_a.map(&:values) ).to eq( [["1", "a"], ["2", "b"]] )
+		expect( result2x2.each_tuple.size ).to eq( 2 )
+	end
+
+	it "uses the type map of the result" do
+		res = @conn.exec( "SELECT 1::int AS a, 'x'::text AS b" ).map_types!(typemap)
+		expect( res.tuple(0)["a"] ).to eq( 1 )
+	end
+
+	it "raises an error when the result is cleared" do
+		t = result2x2.tuple(0)
+		result2x2.clear
+		expect{ t[0] }.to raise_error(PG::Error, /cleared/)
+	end
+end
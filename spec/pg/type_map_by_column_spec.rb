@@ -153,6 +153,20 @@ describe PG::TypeMapByColumn do
 		expect{ res.values }.to raise_error(/no type decoder defined/)
 	end
 
+	it "should memoize decoded values of columns with memo_size" do
+		textdec_string.memo_size = 2
+		res = @conn.exec( "VALUES ('a', 'a'), ('b', 'a'), ('a', NULL), ('c', 'a'), ('c', 'b')" )
+		res.type_map = PG::TypeMapByColumn.new( [textdec_string, textdec_string] )
+		values = res.values
+		expect( values ).to eq( [['a', 'a'], ['b', 'a'], ['a', nil], ['c', 'a'], ['c', 'b']] )
+		expect( values[0][0] ).to be_frozen
+		expect( values[0][0] ).to equal( values[2][0] )
+		expect( values[0][0] ).to equal( values[0][1] )
+		# memo is full, so that 'c' is not memoized
+		expect( values[3][0] ).not_to equal( values[4][0] )
+		expect( res.column_values(1)[0] ).to equal( values[0][1] )
+	end
+
 	it "should raise an error for invalid params" do
 		expect{ PG::TypeMapByColumn.new( :WrongType ) }.to raise_error(TypeError, /wrong argument type/)
 		expect{ PG::TypeMapByColumn.new( [123] ) }.to raise_error(ArgumentError, /invalid/)
@@ -2,6 +2,7 @@
 # encoding: utf-8
 
 require 'pg'
+require 'bigdecimal'
 
 
 describe "PG::Type derivations" do
@@ -121,6 +122,50 @@ describe "PG::Type derivations" do
 					expect( textdec_timestamptz.decode('1916-01-01 00:00:00-00:25:21') ).
 						to be_within(0.000001).of( Time.new(1916, 1, 1, 0, 0, 0, "-00:25:21") )
 				end
+				it 'decodes timestamps with time zone to Time with the given UTC offset' do
+					t = textdec_timestamptz.decode('2016-01-02 23:23:59.123456+02')
+					expect( t.utc_offset ).to eq( 7200 )
+					expect( t.usec ).to eq( 123456 )
+					expect( t.utc ).to eq( Time.utc(2016, 1, 2, 21, 23, 59, 123456) )
+				end
+				it 'decodes timestamps without timezone to local time' do
+					t = textdec_timestamp.decode('2016-06-01 12:34:56.5')
+					expect( t.utc_offset ).to eq( Time.local(2016, 6, 1, 12, 34, 56).utc_offset )
+					expect( t ).to eq( Time.local(2016, 6, 1, 12, 34, 56, 500000) )
+				end
+				it 'decodes BC timestamps' do
+					expect( textdec_timestamptz.decode('0044-03-15 12:00:00+00 BC') ).
+						to eq( Time.utc(-43, 3, 15, 12, 0, 0) )
+					expect( textdec_timestamp.decode('0001-01-01 00:00:00 BC').year ).to eq( 0 )
+				end
+				it 'decodes infinite timestamps to String' do
+					expect( textdec_timestamp.decode('infinity') ).to eq( 'infinity' )
+					expect( textdec_timestamptz.decode('-infinity') ).to eq( '-infinity' )
+				end
+				it 'returns timestamps in other DateStyle as String' do
+					expect( textdec_timestamp.decode('Sat Jan 02 23:23:59 2016') ).to eq( 'Sat Jan 02 23:23:59 2016' )
+					expect( textdec_timestamptz.decode('01/02/2016 23:23:59 CET') ).to eq( '01/02/2016 23:23:59 CET' )
+				end
+			end
+
+			context 'dates' do
+				let!(:textdec_date) { PG::TextDecoder::Date.new }
+
+				it 'decodes dates' do
+					expect( textdec_date.decode('2016-02-29') ).to eq( Date.new(2016, 2, 29) )
+					expect( textdec_date.decode('12345-06-07') ).to eq( Date.new(12345, 6, 7) )
+				end
+				it 'decodes dates in the proleptic Gregorian calendar' do
+					expect( textdec_date.decode('1582-10-10') ).to eq( Date.new(1582, 10, 10, Date::GREGORIAN) )
+					expect( textdec_date.decode('0001-01-01 BC') ).to eq( Date.new(0, 1, 1, Date::GREGORIAN) )
+				end
+				it 'decodes infinite dates to String' do
+					expect( textdec_date.decode('infinity') ).to eq( 'infinity' )
+					expect( textdec_date.decode('-infinity') ).to eq( '-infinity' )
+				end
+				it 'returns dates in other DateStyle as String' do
+					expect( textdec_date.decode('02/29/2016') ).to eq( '02/29/2016' )
+				end
 			end
 
 			context 'identifier quotation' do
@@ -215,6 +260,162 @@ describe "PG::Type derivations" do
 				expect( textenc_bytea.encode("\x00\x01\x02\x03\xef".b) ).to eq( "\\x00010203ef" )
 			end
 
+			context 'timestamps' do
+				it 'encodes timestamps without timezone' do
+					expect( textenc_timestamp.encode(Time.new(2016,1,2, 23, 23, Rational(59123456, 1000000), "+02:00")) ).
+						to eq( '2016-01-02 23:23:59.123456000' )
+				end
+				it 'encodes timestamps with timezone' do
+					expect( textenc_timestamptz.encode(Time.new(2016,1,2, 23, 23, Rational(59123456, 1000000), "-04:30")) ).
+						to eq( '2016-01-02 23:23:59.123456000 -04:30' )
+					expect( textenc_timestamptz.encode(Time.new(1916,1,1, 0, 0, 0, "-00:25:21")) ).
+						to eq( '1916-01-01 00:00:00.000000000 -00:25:21' )
+				end
+				it 'encodes BC timestamps' do
+					expect( textenc_timestamptz.encode(Time.utc(-43, 3, 15, 12)) ).
+						to eq( '0044-03-15 12:00:00.000000000 +00:00 BC' )
+				end
+				it 'encodes infinite timestamps' do
+					expect( textenc_timestamp.encode(Float::INFINITY) ).to eq( 'infinity' )
+					expect( textenc_timestamptz.encode(-Float::INFINITY) ).to eq( '-infinity' )
+				end
+				it 'encodes other objects per strftime or to_s' do
+					expect( textenc_timestamptz.encode(DateTime.new(2016,1,2, 23, 23, 59, "+02:00")) ).
+						to eq( '2016-01-02 23:23:59.000000000 +02:00' )
+					expect( textenc_timestamp.encode('2016-01-02 23:23:59') ).to eq( '2016-01-02 23:23:59' )
+				end
+				it 'encodes timestamps that are decoded unchanged' do
+					time = Time.at(1234567890, 123456).localtime("+05:45")
+					expect( textdec_timestamptz.decode(textenc_timestamptz.encode(time)) ).to eq( time )
+				end
+			end
+
+			context 'dates' do
+				let!(:textenc_date) { PG::TextEncoder::Date.new }
+
+				it 'encodes Date objects' do
+					expect( textenc_date.encode(Date.new(2016, 2, 29)) ).to eq( '2016-02-29' )
+					expect( textenc_date.encode(Date.new(1500, 1, 1, Date::GREGORIAN)) ).to eq( '1500-01-01' )
+					expect( textenc_date.encode(Date.new(0, 1, 1, Date::GREGORIAN)) ).to eq( '0001-01-01 BC' )
+				end
+				it 'encodes Date objects before 1582 with their year, month and day' do
+					expect( textenc_date.encode(Date.new(1500, 1, 1)) ).to eq( '1500-01-01' )
+					expect( textenc_date.encode(Date.new(1500, 1, 1, Date::JULIAN)) ).to eq( '1500-01-01' )
+				end
+				it 'encodes the date of Time objects in their UTC offset' do
+					expect( textenc_date.encode(Time.new(2016, 2, 29, 23, 0, 0, "-05:00")) ).to eq( '2016-02-29' )
+				end
+				it 'encodes infinite dates' do
+					expect( textenc_date.encode(Float::INFINITY) ).to eq( 'infinity' )
+					expect( textenc_date.encode(-Float::INFINITY) ).to eq( '-infinity' )
+				end
+			end
+
+			context 'binary date and time types' do
+				let!(:binaryenc_timestamp) { PG::BinaryEncoder::TimestampWithoutTimeZone.new }
+				let!(:binarydec_timestamp) { PG::BinaryDecoder::TimestampWithoutTimeZone.new }
+				let!(:binaryenc_timestamptz) { PG::BinaryEncoder::TimestampWithTimeZone.new }
+				let!(:binarydec_timestamptz) { PG::BinaryDecoder::TimestampWithTimeZone.new }
+				let!(:binaryenc_date) { PG::BinaryEncoder::Date.new }
+				let!(:binarydec_date) { PG::BinaryDecoder::Date.new }
+				let!(:binaryenc_interval) { PG::BinaryEncoder::Interval.new }
+				let!(:binarydec_interval) { PG::BinaryDecoder::Interval.new }
+
+				it 'encodes timestamps as microseconds since 2000-01-01' do
+					expect( binaryenc_timestamptz.encode(Time.utc(2000, 1, 1, 0, 0, 1, 500000)) ).to eq( [1500000].pack("q>") )
+					expect( binaryenc_timestamptz.encode(Time.new(2000, 1, 1, 5, 0, 0, "+05:00")) ).to eq( [0].pack("q>") )
+					expect( binaryenc_timestamp.encode(Time.new(2000, 1, 1, 5, 0, 0, "+05:00")) ).to eq( [5 * 3600000000].pack("q>") )
+					expect( binaryenc_timestamp.encode(Float::INFINITY) ).to eq( [2**63-1].pack("q>") )
+				end
+
+				it 'decodes timestamps to Time objects' do
+					expect( binarydec_timestamptz.decode([-1].pack("q>")) ).to eq( Time.utc(1999, 12, 31, 23, 59, Rational(59999999, 1000000)) )
+					expect( binarydec_timestamp.decode([86400000000 + 1].pack("q>")) ).to eq( Time.local(2000, 1, 2, 0, 0, 0, 1) )
+					expect( binarydec_timestamp.decode([-2**63].pack("q>")) ).to eq( -Float::INFINITY )
+				end
+
+				it 'encodes and decodes timestamps unchanged' do
+					time = Time.at(1234567890, 123456)
+					expect( binarydec_timestamptz.decode(binaryenc_timestamptz.encode(time)) ).to eq( time )
+					expect( binarydec_timestamp.decode(binaryenc_timestamp.encode(time)) ).to eq( time )
+				end
+
+				it 'encodes and decodes dates as days since 2000-01-01' do
+					expect( binaryenc_date.encode(Date.new(1999, 12, 31)) ).to eq( [-1].pack("l>") )
+					expect( binaryenc_date.encode(Date.new(1500, 1, 1)) ).to eq( binaryenc_date.encode(Date.new(1500, 1, 1, Date::GREGORIAN)) )
+					expect( binaryenc_date.encode(Time.new(2000, 1, 2, 1, 0, 0, "+02:00")) ).to eq( [1].pack("l>") )
+					expect( binarydec_date.decode([1].pack("l>")) ).to eq( Date.new(2000, 1, 2) )
+					expect( binarydec_date.decode([2**31-1].pack("l>")) ).to eq( Float::INFINITY )
+					expect{ binaryenc_date.encode("2000-01-01") }.to raise_error(TypeError)
+				end
+
+				it 'encodes and decodes intervals' do
+					data = [4500000, 3, 14].pack("q>l>l>")
+					expect( binaryenc_interval.encode(months: 14, days: 3, microseconds: 4500000) ).to eq( data )
+					expect( binarydec_interval.decode(data) ).to eq( months: 14, days: 3, microseconds: 4500000 )
+					expect( binaryenc_interval.encode(5) ).to eq( [5, 0, 0].pack("q>l>l>") )
+				end
+
+				it 'decodes to Integer with flag TIME_RAW' do
+					[binarydec_timestamp, binarydec_timestamptz, binarydec_date, binarydec_interval].each do |dec|
+						dec.flags = PG::Coder::TIME_RAW
+					end
+					expect( binarydec_timestamptz.decode([1500000].pack("q>")) ).to eq( 946684801500000 )
+					expect( binarydec_timestamp.decode([0].pack("q>")) ).to eq( 946684800000000 )
+					expect( binarydec_date.decode([1].pack("l>")) ).to eq( 10958 )
+					expect( binarydec_interval.decode([4500000, 3, 14].pack("q>l>l>")) ).to eq( (14 * 30 + 3) * 86400000000 + 4500000 )
+					expect( binaryenc_timestamptz.encode(946684801500000) ).to eq( [1500000].pack("q>") )
+					expect( binaryenc_date.encode(10958) ).to eq( [1].pack("l>") )
+				end
+			end
+
+			context 'numeric' do
+				let!(:textdec_numeric) { PG::TextDecoder::Numeric.new }
+				let!(:binaryenc_numeric) { PG::BinaryEncoder::Numeric.new }
+				let!(:binarydec_numeric) { PG::BinaryDecoder::Numeric.new }
+
+				it 'decodes text numeric values to BigDecimal' do
+					expect( textdec_numeric.decode('12345.678') ).to eq( BigDecimal('12345.678') )
+					expect( textdec_numeric.decode('-0.0001') ).to eq( BigDecimal('-0.0001') )
+					expect( textdec_numeric.decode('NaN') ).to be_nan
+				end
+
+				it 'encodes numeric values in base 10000 digits' do
+					expect( binaryenc_numeric.encode('12345.678') ).to eq( [3, 1, 0, 3, 1, 2345, 6780].pack("s>*") )
+					expect( binaryenc_numeric.encode(BigDecimal('-0.0001')) ).to eq( [1, -1, 0x4000, 4, 1].pack("s>*") )
+					expect( binaryenc_numeric.encode(10**20) ).to eq( [1, 5, 0, 0, 1].pack("s>*") )
+					expect( binaryenc_numeric.encode(0) ).to eq( [0, 0, 0, 0].pack("s>*") )
+					expect( binaryenc_numeric.encode(-Float::INFINITY) ).to eq( [0, 0, 0xF000, 0].pack("s>s>S>s>") )
+					expect{ binaryenc_numeric.encode('1.2.3') }.to raise_error(ArgumentError)
+				end
+
+				it 'encodes and decodes binary numeric values unchanged' do
+					%w[0 0.00 1 -1 10000 0.1000 12345.678 -99999999.9999 1e-20 123456789012345678901234567890.12345].each do |str|
+						expect( binarydec_numeric.decode(binaryenc_numeric.encode(str)) ).to eq( BigDecimal(str) )
+					end
+					expect( binarydec_numeric.decode(binaryenc_numeric.encode('NaN')) ).to be_nan
+				end
+
+				it 'decodes to Integer with flag NUMERIC_AS_INTEGER' do
+					textdec_numeric.flags = PG::Coder::NUMERIC_AS_INTEGER
+					binarydec_numeric.flags = PG::Coder::NUMERIC_AS_INTEGER
+					expect( textdec_numeric.decode('123') ).to eq( 123 )
+					expect( textdec_numeric.decode('123.0') ).to eq( BigDecimal('123') )
+					expect( binarydec_numeric.decode(binaryenc_numeric.encode(123456789012)) ).to eq( 123456789012 )
+					expect( binarydec_numeric.decode(binaryenc_numeric.encode(-10**30)) ).to eq( -10**30 )
+					expect( binarydec_numeric.decode(binaryenc_numeric.encode('1.5')) ).to eq( BigDecimal('1.5') )
+				end
+
+				it 'decodes to Float with flag NUMERIC_AS_FLOAT' do
+					textdec_numeric.flags = PG::Coder::NUMERIC_AS_FLOAT
+					binarydec_numeric.flags = PG::Coder::NUMERIC_AS_FLOAT | PG::Coder::NUMERIC_AS_INTEGER
+					expect( textdec_numeric.decode('1.25') ).to eq( 1.25 )
+					expect( textdec_numeric.decode('-Infinity') ).to eq( -Float::INFINITY )
+					expect( binarydec_numeric.decode(binaryenc_numeric.encode('1.25')) ).to eq( 1.25 )
+					expect( binarydec_numeric.decode(binaryenc_numeric.encode('10')) ).to eq( 10 )
+				end
+			end
+
 			context 'identifier quotation' do
 				it 'should quote and escape identifier' do
 					quoted_type = PG::TextEncoder::Identifier.new
@@ -272,8 +473,25 @@ describe "PG::Type derivations" do
 
 		it "should respond to to_h" do
 			expect( textenc_int.to_h ).to eq( {
-				name: 'Integer', oid: 23, format: 0
+				name: 'Integer', oid: 23, format: 0, flags: 0
+			} )
+		end
+
+		it "should respond to memo_size" do
+			expect( textdec_int.memo_size ).to eq( 0 )
+			textdec_int.memo_size = 10
+			expect( textdec_int.to_h ).to eq( {
+				name: 'Integer', oid: 23, format: 0, flags: 0, memo_size: 10
 			} )
+			expect( textdec_int.dup.memo_size ).to eq( 10 )
+			expect{ textdec_int.memo_size = -1 }.to raise_error(ArgumentError)
+		end
+
+		it "should respond to flags" do
+			expect( textdec_int.flags ).to eq( 0 )
+			textdec_int.flags = PG::Coder::TIME_RAW
+			expect( textdec_int.to_h[:flags] ).to eq( PG::Coder::TIME_RAW )
+			expect( textdec_int.dup.flags ).to eq( PG::Coder::TIME_RAW )
 		end
 
 		it "should have reasonable default values" do
@@ -548,7 +766,7 @@ describe "PG::Type derivations" do
 
 			it "should respond to to_h" do
 				expect( textenc_int_array.to_h ).to eq( {
-					name: nil, oid: 0, format: 0,
+					name: nil, oid: 0, format: 0, flags: 0,
 					elements_type: textenc_int, needs_quotation: false, delimiter: ','
 				} )
 			end
@@ -568,6 +786,71 @@ describe "PG::Type derivations" do
 			end
 		end
 
+		describe "binary Array types" do
+			let!(:binaryenc_int4_array) { PG::BinaryEncoder::Array.new elements_type: PG::BinaryEncoder::Int4.new(oid: 23) }
+			let!(:binarydec_int_array) { PG::BinaryDecoder::Array.new elements_type: binarydec_integer }
+			let!(:binaryenc_string_array) { PG::BinaryEncoder::Array.new elements_type: PG::BinaryEncoder::String.new(oid: 25) }
+			let!(:binarydec_string_array) { PG::BinaryDecoder::Array.new elements_type: PG::BinaryDecoder::String.new }
+
+			it "should encode one dimensional arrays" do
+				expect( binaryenc_int4_array.encode([1, nil, -3]) ).to eq(
+					[1, 1, 23, 3, 1, 4, 1, -1, 4, -3].pack("l>*") )
+			end
+
+			it "should encode multi dimensional arrays" do
+				expect( binaryenc_int4_array.encode([[1, 2], [3, 4]]) ).to eq(
+					[2, 0, 23, 2, 1, 2, 1, 4, 1, 4, 2, 4, 3, 4, 4].pack("l>*") )
+			end
+
+			it "should encode empty arrays without dimensions" do
+				expect( binaryenc_int4_array.encode([]) ).to eq( [0, 0, 23].pack("l>*") )
+				expect( binaryenc_int4_array.encode([[]]) ).to eq( [0, 0, 23].pack("l>*") )
+			end
+
+			it "should raise on non-rectangular arrays" do
+				expect{ binaryenc_int4_array.encode([[1], [2, 3]]) }.to raise_error(ArgumentError, /same size/)
+				expect{ binaryenc_int4_array.encode([[1], 2]) }.to raise_error(ArgumentError, /same size/)
+				expect{ binaryenc_int4_array.encode([1, [2]]) }.to raise_error(ArgumentError, /same depth/)
+				expect{ binaryenc_int4_array.encode([[[[[[[1]]]]]]]) }.to raise_error(ArgumentError, /dimensions/)
+			end
+
+			it "should pass through non Array inputs" do
+				expect( binaryenc_int4_array.encode("raw") ).to eq( "raw" )
+			end
+
+			it "should decode arrays with NULL values and lower bounds" do
+				data = [1, 1, 23, 3, 0, 4, 7, -1, 4, 9].pack("l>*")
+				expect( binarydec_int_array.decode(data) ).to eq( [7, nil, 9] )
+			end
+
+			it "should decode empty arrays" do
+				expect( binarydec_int_array.decode([0, 0, 23].pack("l>*")) ).to eq( [] )
+			end
+
+			it "should raise on invalid data" do
+				data = [1, 0, 23, 2, 1, 4, 5, 4, 6].pack("l>*")
+				expect{ binarydec_int_array.decode(data[0..-2]) }.to raise_error(TypeError, /too short/)
+				expect{ binarydec_int_array.decode(data + "x") }.to raise_error(TypeError, /trailing data/)
+			end
+
+			it "should do roundtrips" do
+				[ [], [1, 2, 3], [[1, nil], [nil, 4]], [[[5]]], [nil] ].each do |value|
+					expect( binarydec_int_array.decode(binaryenc_int4_array.encode(value)) ).to eq( value )
+				end
+				strings = ["abc", nil, "", "x" * 1000]
+				expect( binarydec_string_array.decode(binaryenc_string_array.encode(strings)) ).to eq( strings )
+			end
+
+			it "should have reasonable default values" do
+				t = PG::BinaryEncoder::Array.new
+				expect( t.format ).to eq( 1 )
+				expect( t.elements_type ).to be_nil
+				t = PG::BinaryDecoder::Array.new
+				expect( t.format ).to eq( 1 )
+				expect( t.elements_type ).to be_nil
+			end
+		end
+
 		it "should encode Strings as base64 in TextEncoder" do
 			e = PG::TextEncoder::ToBase64.new
 			expect( e.encode("") ).to eq("")